@@ -0,0 +1,1205 @@
+#include "CLI11.h"
+#include "alloc_counter.h"
+#include "arena.h"
+#include "ast.h"
+#include "calculator.h"
+#include "columnar.h"
+#include "compiled_expression.h"
+#include "csv.h"
+#include "environment.h"
+#include "functions.h"
+#include "latency_histogram.h"
+#include "npy.h"
+#include "number_stream.h"
+#include "operator_kernels.h"
+#include "perf_counters.h"
+#include "power.h"
+#include "program.h"
+#include "reduction.h"
+#include "scanner.h"
+#include "token_buffer.h"
+#include "tokenizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef ALLOC_COUNTER_ENABLED
+#error "Build the benchmarks with -DALLOC_COUNTER_ENABLED so they can count heap allocations"
+#endif
+
+namespace {
+
+// Options shared by every benchmark case.
+struct BenchmarkOptions {
+    size_t inputBytes = 64 << 20;  // Approximate size of generated inputs.
+    size_t tokenCount = 10000000;  // Approximate token count for evaluation inputs.
+    int repetitions = 5;           // Timed runs per case; the best one is reported.
+};
+
+// A named benchmark case.
+struct BenchmarkCase {
+    std::string name;
+    std::function<void(const BenchmarkOptions&)> run;
+};
+
+// Runs `body` `repetitions` times and returns the fastest wall time in seconds.
+double bestOf(int repetitions, const std::function<void()>& body) {
+    double best = 0;
+    for (int i = 0; i < repetitions; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (i == 0 || elapsed.count() < best) best = elapsed.count();
+    }
+    return best;
+}
+
+// Builds a whitespace-heavy expression of roughly `bytes` bytes by repeating
+// a short term padded with spaces, tabs and newlines.
+std::string whitespaceHeavyExpression(size_t bytes) {
+    const std::string term = "12.5 *    (3 + 4)        -   \t  7 ^ 2    /\n    ";
+    std::string expression;
+    expression.reserve(bytes + term.size());
+    while (expression.size() < bytes) expression += term;
+    expression += "1";
+    return expression;
+}
+
+// Builds a valid expression of roughly `tokens` tokens whose value stays
+// finite: a long sum of short parenthesized terms.
+std::string evaluationExpression(size_t tokens) {
+    const std::string term = "(12.5 * 2 + 3) - 7 / 4 ^ 2 + ";  // 14 tokens.
+    std::string expression;
+    expression.reserve(tokens / 14 * term.size() + 1);
+    for (size_t emitted = 0; emitted < tokens; emitted += 14) expression += term;
+    expression += "1";
+    return expression;
+}
+
+// Builds an expression of roughly `tokens` tokens like `evaluationExpression`
+// but with literals that vary from term to term, so that compilers cannot
+// fold the repetition away. Each term has its own leading literals, so no
+// two terms share a subexpression beyond the power of 4.
+std::string variedExpression(size_t tokens) {
+    std::string expression;
+    for (size_t emitted = 0, i = 0; emitted < tokens; emitted += 14, ++i) {
+        expression += "(" + std::to_string(i + 1) + ".5 * 2 + " + std::to_string(i % 13) + ") - " +
+                      std::to_string(i + 1) + " / 4 ^ " + std::to_string(i % 3) + " + ";
+    }
+    expression += "1";
+    return expression;
+}
+
+// Counts scanner callbacks without building tokens, so the figure reflects
+// classification and boundary extraction only.
+struct CountingVisitor {
+    size_t tokens = 0;
+    void number(size_t, size_t) { ++tokens; }
+    void identifier(size_t, size_t) { ++tokens; }
+    void op(size_t) { ++tokens; }
+    void leftParen(size_t) { ++tokens; }
+    void rightParen(size_t) { ++tokens; }
+    void comma(size_t) { ++tokens; }
+    void invalid(size_t) { ++tokens; }
+};
+
+void benchClassifier(const BenchmarkOptions& options) {
+    std::string expression = whitespaceHeavyExpression(options.inputBytes);
+    uint64_t invalid = 0;
+    double seconds = bestOf(options.repetitions, [&] {
+        for (size_t block = 0; block < expression.size(); block += SCAN_BLOCK_SIZE) {
+            size_t length = std::min(SCAN_BLOCK_SIZE, expression.size() - block);
+            invalid |= classifyBlock(expression.data() + block, length).invalid;
+        }
+    });
+    std::printf("  classifier: %s, %zu bytes, invalid=%d\n",
+                scannerImplementationName(), expression.size(), invalid != 0);
+    std::printf("  %.2f GB/s\n", expression.size() / seconds / 1e9);
+}
+
+void benchScanner(const BenchmarkOptions& options) {
+    std::string expression = whitespaceHeavyExpression(options.inputBytes);
+    size_t tokens = 0;
+    double seconds = bestOf(options.repetitions, [&] {
+        CountingVisitor visitor;
+        scanExpression(expression, visitor);
+        tokens = visitor.tokens;
+    });
+    std::printf("  classifier: %s, %zu bytes, %zu tokens\n",
+                scannerImplementationName(), expression.size(), tokens);
+    std::printf("  %.2f GB/s\n", expression.size() / seconds / 1e9);
+}
+
+void benchTokenizer(const BenchmarkOptions& options) {
+    std::string expression = whitespaceHeavyExpression(options.inputBytes);
+    size_t tokens = 0;
+    double seconds = bestOf(options.repetitions, [&] {
+        tokens = tokenizer(expression).size();
+    });
+    std::printf("  %zu bytes, %zu tokens\n", expression.size(), tokens);
+    std::printf("  %.2f GB/s, %.1f Mtokens/s\n",
+                expression.size() / seconds / 1e9, tokens / seconds / 1e6);
+}
+
+void benchTokenBuffer(const BenchmarkOptions& options) {
+    std::string expression = evaluationExpression(options.tokenCount);
+    double tokenResult = 0, bufferResult = 0;
+    size_t tokenBytes = 0, bufferBytes = 0, tokens = 0;
+
+    double tokenSeconds = bestOf(options.repetitions, [&] {
+        std::vector<Token> tokenized = tokenizer(expression);
+        tokenBytes = tokenized.capacity() * sizeof(Token);
+        for (const auto& token : tokenized) {
+            if (token.value.capacity() > 15) tokenBytes += token.value.capacity() + 1;
+        }
+        tokens = tokenized.size();
+        tokenResult = calculate(tokenized);
+    });
+
+    double bufferSeconds = bestOf(options.repetitions, [&] {
+        TokenBuffer buffer;
+        tokenizer(expression, buffer);
+        bufferBytes = buffer.capacityBytes();
+        bufferResult = calculate(buffer);
+    });
+
+    std::printf("  %zu tokens, results %.17g / %.17g\n", tokens, tokenResult, bufferResult);
+    std::printf("  vector<Token>: %5.1f bytes/token, %6.1f Mtokens/s\n",
+                double(tokenBytes) / tokens, tokens / tokenSeconds / 1e6);
+    std::printf("  TokenBuffer:   %5.1f bytes/token, %6.1f Mtokens/s\n",
+                double(bufferBytes) / tokens, tokens / bufferSeconds / 1e6);
+}
+
+// Evaluates a fixed mix of expressions through reusable scratch state and
+// fails if anything allocates after the warm-up pass.
+void benchZeroAllocation(const BenchmarkOptions& options) {
+    const std::vector<std::string> expressions = {
+        "2 + 3 * (4 - 1)", "10 / 2 + 5", "(5 + 3) * 2", "2 ^ 3 ^ 2",
+        "1.5 * 4 - .5", "((1 + 2) * (3 + 4)) / (5 - 6 ^ 2)",
+    };
+    const size_t iterations = options.tokenCount / 10;
+
+    EvalScratch scratch;
+    scratch.reserve(64);
+    double sum = 0;
+    for (const auto& expression : expressions) sum += calculate(expression, scratch);  // Warm-up.
+
+    std::function<void()> body = [&] {
+        for (size_t i = 0; i < iterations; ++i) {
+            sum += calculate(expressions[i % expressions.size()], scratch);
+        }
+    };
+    AllocationCounter counter;
+    double seconds = bestOf(options.repetitions, body);
+    AllocationStats scratchAllocations = counter.elapsed();
+
+    counter.reset();
+    for (const auto& expression : expressions) sum += calculate(tokenizer(expression));
+    AllocationStats tokenAllocations = counter.elapsed();
+
+    std::printf("  checksum %.6g\n", sum);
+    std::printf("  vector<Token> path: %.1f allocations/expression\n",
+                double(tokenAllocations.count) / expressions.size());
+    std::printf("  EvalScratch path:   %llu allocations in %zu expressions, %.1f ns/expression\n",
+                static_cast<unsigned long long>(scratchAllocations.count),
+                iterations * options.repetitions, seconds / iterations * 1e9);
+    if (scratchAllocations.count != 0) {
+        throw std::runtime_error("EvalScratch path allocated after warm-up");
+    }
+}
+
+// Compares fresh per-expression evaluation state from the global heap with
+// the same state carved from a per-expression monotonic arena, on short
+// literals (which fit the small-string buffer) and on long ones.
+void benchMemoryResource(const BenchmarkOptions& options) {
+    const std::vector<std::string> shortLiterals = {
+        "2 + 3 * (4 - 1)", "10 / 2 + 5", "(5 + 3) * 2", "2 ^ 3 ^ 2",
+        "1.5 * 4 - .5", "((1 + 2) * (3 + 4)) / (5 - 6 ^ 2)",
+    };
+    const std::vector<std::string> longLiterals = {
+        "3.14159265358979323846 * 2.71828182845904523536",
+        "(1.41421356237309504880 + 1.73205080756887729352) / 2.23606797749978969640",
+        "0.57721566490153286060 ^ 2 - 1.61803398874989484820",
+    };
+    const size_t iterations = options.tokenCount / 10;
+    double sum = 0;
+
+    auto run = [&](const char* label, const std::vector<std::string>& expressions,
+                   const std::function<double(const std::string&)>& evaluate) {
+        AllocationCounter counter;
+        double seconds = bestOf(options.repetitions, [&] {
+            for (size_t i = 0; i < iterations; ++i) sum += evaluate(expressions[i % expressions.size()]);
+        });
+        double allocations = double(counter.elapsed().count) / (iterations * options.repetitions);
+        std::printf("  %-36s %7.1f ns/expression, %4.1f heap allocations/expression\n",
+                    label, seconds / iterations * 1e9, allocations);
+    };
+
+    for (const auto* expressions : {&shortLiterals, &longLiterals}) {
+        std::printf("  %s literals:\n", expressions == &shortLiterals ? "short" : "long");
+        run("TokenBuffer, default allocator", *expressions, [](const std::string& expression) {
+            return calculate(expression, std::pmr::get_default_resource());
+        });
+        run("TokenBuffer, monotonic arena", *expressions, [](const std::string& expression) {
+            alignas(std::max_align_t) std::byte storage[8192];
+            std::pmr::monotonic_buffer_resource arena(storage, sizeof(storage));
+            return calculate(expression, &arena);
+        });
+        run("vector<Token>, default allocator", *expressions, [](const std::string& expression) {
+            return calculate(tokenizer(expression));
+        });
+        run("pmr::vector<Token>, monotonic arena", *expressions, [](const std::string& expression) {
+            alignas(std::max_align_t) std::byte storage[8192];
+            std::pmr::monotonic_buffer_resource arena(storage, sizeof(storage));
+            return calculate(tokenizer(expression, &arena), &arena);
+        });
+    }
+    std::printf("  checksum %.6g\n", sum);
+}
+
+// Parses one large expression into an arena-allocated tree and compares
+// evaluating it against the stack-based `calculate()`.
+void benchArenaTree(const BenchmarkOptions& options) {
+    std::string expression = evaluationExpression(options.tokenCount);
+    std::vector<Token> tokens = tokenizer(expression);
+    double stackResult = 0, treeResult = 0;
+
+    double stackSeconds = bestOf(options.repetitions, [&] { stackResult = calculate(tokens); });
+
+    for (bool hugePages : {false, true}) {
+        ArenaOptions arenaOptions;
+        arenaOptions.hugePages = hugePages;
+        Arena arena(arenaOptions);
+        ExprTree tree;
+        AllocationCounter counter;
+        double parseSeconds = bestOf(options.repetitions, [&] {
+            arena.reset();
+            tree = parseExpressionTree(tokens, arena);
+        });
+        double parseAllocations = double(counter.elapsed().count) / options.repetitions;
+        double evaluateSeconds = bestOf(options.repetitions, [&] { treeResult = evaluate(tree); });
+
+        std::printf("  arena%s: %zu nodes, %.1f MB, parse %.1f Mtokens/s (%.0f heap allocations), "
+                    "evaluate %.1f Mnodes/s\n",
+                    hugePages ? " (huge pages)" : "", tree.nodeCount, arena.bytesReserved() / 1e6,
+                    tokens.size() / parseSeconds / 1e6, parseAllocations,
+                    tree.nodeCount / evaluateSeconds / 1e6);
+    }
+
+    std::printf("  calculate(vector<Token>): %.1f Mtokens/s\n", tokens.size() / stackSeconds / 1e6);
+    std::printf("  results %.17g / %.17g\n", stackResult, treeResult);
+}
+
+// Runs the same compiled programs on the stack and register machines: a
+// large program with distinct terms, one whose repeated terms common
+// subexpression elimination collapses, then a mix of short ones like a
+// batch workload.
+void benchVirtualMachines(const BenchmarkOptions& options) {
+    // Runs one large program on both machines. With distinct terms both do
+    // the same arithmetic; with repeated terms the register machine computes
+    // the shared subexpressions once.
+    auto runLarge = [&](const char* label, const std::string& expression) {
+        PostfixProgram large = compilePostfix(tokenizer(expression));
+        RegisterProgram largeRegisters = compileRegisters(large);
+        double stackResult = 0, registerResult = 0;
+        double stackSeconds = bestOf(options.repetitions, [&] { stackResult = evaluate(large); });
+        double registerSeconds = bestOf(options.repetitions, [&] { registerResult = evaluate(largeRegisters); });
+
+        std::printf("  large program, %s, results %.17g / %.17g\n", label, stackResult, registerResult);
+        std::printf("  stack:    %8zu instructions, depth %zu, %.2f ms (%.2f ns/instruction)\n",
+                    large.code.size(), large.maxDepth, stackSeconds * 1e3, stackSeconds / large.code.size() * 1e9);
+        std::printf("  register: %8zu instructions, %zu slots, %.2f ms (%.2f ns/instruction)\n",
+                    largeRegisters.code.size(), largeRegisters.registerCount, registerSeconds * 1e3,
+                    registerSeconds / largeRegisters.code.size() * 1e9);
+        if (stackResult != registerResult) {
+            throw std::runtime_error("stack and register machines disagree");
+        }
+    };
+    runLarge("distinct terms", variedExpression(options.tokenCount));
+    runLarge("repeated terms (CSE)", evaluationExpression(options.tokenCount));
+
+    const std::vector<std::string> expressions = {
+        "2 + 3 * (4 - 1)", "10 / 2 + 5", "(5 + 3) * 2", "2 ^ 3 ^ 2",
+        "1.5 * 4 - .5", "((1 + 2) * (3 + 4)) / (5 - 6 ^ 2)",
+    };
+    std::vector<PostfixProgram> stackPrograms;
+    std::vector<RegisterProgram> registerPrograms;
+    for (const auto& expression : expressions) {
+        stackPrograms.push_back(compilePostfix(tokenizer(expression)));
+        registerPrograms.push_back(compileRegisters(stackPrograms.back()));
+    }
+    const size_t iterations = options.tokenCount / 10;
+    double stackSum = 0, registerSum = 0;
+    double stackSeconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < iterations; ++i) stackSum += evaluate(stackPrograms[i % stackPrograms.size()]);
+    });
+    double registerSeconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < iterations; ++i) registerSum += evaluate(registerPrograms[i % registerPrograms.size()]);
+    });
+    std::printf("  short programs: stack %.1f ns/expression, register %.1f ns/expression\n",
+                stackSeconds / iterations * 1e9, registerSeconds / iterations * 1e9);
+    if (stackSum != registerSum) {
+        throw std::runtime_error("stack and register machines disagree");
+    }
+}
+
+// Profiles instruction pairs over a formula mix, fuses the frequent ones
+// into superinstructions and compares the programs before and after.
+void benchPeephole(const BenchmarkOptions& options) {
+    const std::vector<std::string> expressions = {
+        "2.5 * 4 + 1", "1 + 2 * 3 + 4 * 5", "3 ^ 2 + 4 ^ 2", "(7 - 2) * 1.08 + 2",
+        "(1 + 2) / 4 - 0.5", "2 ^ 3 * 3.14 / 3", "10 / 2 + 5 * (1 - 0.25)", "(5 + 3) * 2 - 6 ^ 2",
+    };
+    std::vector<PostfixProgram> programs;
+    OpcodePairCounts pairs;
+    for (const auto& expression : expressions) {
+        programs.push_back(compilePostfix(tokenizer(expression)));
+        pairs.record(programs.back());
+    }
+    FusionPlan plan = planFusions(programs);
+    auto printIndented = [](const std::string& text) {
+        std::string line;
+        std::istringstream lines(text);
+        while (std::getline(lines, line)) std::printf("    %s\n", line.c_str());
+    };
+    std::ostringstream pairReport, planReport;
+    pairs.print(pairReport, 8);
+    plan.print(planReport);
+    std::printf("  most frequent pairs:\n");
+    printIndented(pairReport.str());
+    std::printf("  fused pairs:\n");
+    printIndented(planReport.str());
+
+    std::vector<PostfixProgram> fused;
+    size_t before = 0, after = 0;
+    for (const auto& program : programs) {
+        fused.push_back(fuseInstructions(program, plan));
+        before += program.code.size();
+        after += fused.back().code.size();
+    }
+
+    const size_t iterations = options.tokenCount / 10;
+    double plainSum = 0, fusedSum = 0;
+    double plainSeconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < iterations; ++i) plainSum += evaluate(programs[i % programs.size()]);
+    });
+    double fusedSeconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < iterations; ++i) fusedSum += evaluate(fused[i % fused.size()]);
+    });
+    std::printf("  plain: %.1f instructions/expression, %.1f ns/expression\n",
+                double(before) / programs.size(), plainSeconds / iterations * 1e9);
+    std::printf("  fused: %.1f instructions/expression, %.1f ns/expression\n",
+                double(after) / programs.size(), fusedSeconds / iterations * 1e9);
+    std::printf("  checksums %.17g / %.17g\n", plainSum, fusedSum);
+}
+
+// The if/else chain on the operator character that `calculate()` applies,
+// copied here as the baseline.
+double applyByCharacter(char op, double a, double b) {
+    if (op == '+') {
+        return a + b;
+    } else if (op == '-') {
+        return a - b;
+    } else if (op == '*') {
+        return a * b;
+    } else if (op == '/') {
+        if (b == 0) throw std::runtime_error("Math Error: Division by zero");
+        return a / b;
+    } else if (op == '^') {
+        return std::pow(a, b);
+    }
+    throw std::runtime_error("Syntax Error: Unknown operator");
+}
+
+// Measures the cost of choosing the operator for each operation: the old
+// character chain, an indirect call through the constexpr kernel table,
+// kernels instantiated through visitOperator, and one table lookup per
+// array with the kernel applied to the whole column.
+void benchOperatorKernels(const BenchmarkOptions& options) {
+    // Operators in the order a real workload applies them (the binary
+    // operators of a generated formula mix), in a cache-resident block that
+    // is processed repeatedly so memory traffic does not hide dispatch.
+    const size_t BLOCK = 4096;
+    std::vector<OpCode> opCodes;
+    for (char c : variedExpression(BLOCK * 4)) {
+        OpCode op = opCodeFromChar(c);
+        if (op != OpCode::NONE && op != OpCode::POWER && opCodes.size() < BLOCK) opCodes.push_back(op);
+    }
+    const size_t count = opCodes.size();
+    const size_t rounds = std::max<size_t>(options.tokenCount / count, 1);
+    std::vector<char> characters(count);
+    std::vector<double> left(count), right(count), out(count);
+    uint64_t state = 88172645463325252ull;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        characters[i] = opCodeToChar(opCodes[i]);
+        left[i] = double(state >> 40) / 1024;
+        right[i] = double((state >> 8) & 0xFFFF) + 1;
+    }
+
+    double checksum[4] = {};
+    auto sum = [&](int variant) {
+        for (double value : out) checksum[variant] += value;
+    };
+
+    double characterSeconds = bestOf(options.repetitions, [&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            for (size_t i = 0; i < count; ++i) out[i] = applyByCharacter(characters[i], left[i], right[i]);
+        }
+    });
+    sum(0);
+    double tableSeconds = bestOf(options.repetitions, [&] {
+        for (size_t round = 0; round < rounds; ++round) for (size_t i = 0; i < count; ++i) {
+            const KernelEntry& kernel = OPERATOR_KERNELS[static_cast<size_t>(opCodes[i])];
+            if (kernel.rejectsZeroDivisor && right[i] == 0) throw std::runtime_error("Math Error: Division by zero");
+            out[i] = kernel.apply(left[i], right[i]);
+        }
+    });
+    sum(1);
+    double visitSeconds = bestOf(options.repetitions, [&] {
+        for (size_t round = 0; round < rounds; ++round) for (size_t i = 0; i < count; ++i) {
+            out[i] = visitOperator(opCodes[i], [&](auto kernel) {
+                if (decltype(kernel)::REJECTS_ZERO_DIVISOR && right[i] == 0) {
+                    throw std::runtime_error("Math Error: Division by zero");
+                }
+                return decltype(kernel)::apply(left[i], right[i]);
+            }, []() -> double { throw std::runtime_error("Syntax Error: Unknown operator"); });
+        }
+    });
+    sum(2);
+    double arraySeconds = bestOf(options.repetitions, [&] {
+        const KernelEntry& kernel = OPERATOR_KERNELS[static_cast<size_t>(OpCode::MULTIPLY)];
+        for (size_t round = 0; round < rounds; ++round) {
+            kernel.applyToArrays(left.data(), right.data(), out.data(), count);
+        }
+    });
+    sum(3);
+
+    const size_t operations = count * rounds;
+    std::printf("  %zu operations (+ - * / from a formula mix; checksums %.6g / %.6g / %.6g)\n",
+                operations, checksum[0], checksum[1], checksum[2]);
+    std::printf("  character chain:  %.2f ns/operation\n", characterSeconds / operations * 1e9);
+    std::printf("  table per op:     %.2f ns/operation\n", tableSeconds / operations * 1e9);
+    std::printf("  visitOperator:    %.2f ns/operation\n", visitSeconds / operations * 1e9);
+    std::printf("  table per array:  %.2f ns/operation (checksum %.6g)\n", arraySeconds / operations * 1e9, checksum[3]);
+    if (checksum[0] != checksum[1] || checksum[0] != checksum[2]) {
+        throw std::runtime_error("operator dispatch variants disagree");
+    }
+}
+
+// Evaluates a formula with changing variable values three ways: by
+// substituting the numbers into the text and re-parsing it (the workaround
+// without variables), by looking names up per evaluation, and by compiling
+// once against the environment's symbol table.
+void benchVariables(const BenchmarkOptions& options) {
+    const std::string formula = "price * qty * (1 + tax_rate) - discount";
+    Environment environment({"price", "qty", "tax_rate", "discount"});
+    const uint32_t price = environment.slot("price"), qty = environment.slot("qty");
+    environment.set("tax_rate", 0.2);
+    environment.set("discount", 1.5);
+    const size_t iterations = std::max<size_t>(options.tokenCount / 20, 1);
+
+    double substitutedSum = 0;
+    double substitutedSeconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < iterations; ++i) {
+            std::string text = std::to_string(1 + i % 50) + " * " + std::to_string(i % 7) + " * (1 + 0.2) - 1.5";
+            substitutedSum += calculate(tokenizer(text));
+        }
+    });
+
+    const std::vector<Token> tokens = tokenizer(formula);
+    double lookupSum = 0;
+    double lookupSeconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < iterations; ++i) {
+            environment[price] = double(1 + i % 50);
+            environment[qty] = double(i % 7);
+            lookupSum += calculate(tokens, environment);
+        }
+    });
+
+    const PostfixProgram program = compilePostfix(tokens, &environment.symbols());
+    double compiledSum = 0;
+    double compiledSeconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < iterations; ++i) {
+            environment[price] = double(1 + i % 50);
+            environment[qty] = double(i % 7);
+            compiledSum += evaluate(program, environment.values());
+        }
+    });
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 1000; ++i) names.push_back("column_" + std::to_string(i));
+    SymbolTable symbols(names);
+    uint64_t found = 0;
+    double lookupTableSeconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < iterations; ++i) found += symbols.find(names[i % names.size()]);
+    });
+
+    std::printf("  substitute and re-parse: %8.1f ns/evaluation\n", substitutedSeconds / iterations * 1e9);
+    std::printf("  look names up:           %8.1f ns/evaluation\n", lookupSeconds / iterations * 1e9);
+    std::printf("  compiled once:           %8.1f ns/evaluation\n", compiledSeconds / iterations * 1e9);
+    std::printf("  symbol table (1000 names): %.1f ns/lookup (checksum %llu)\n",
+                lookupTableSeconds / iterations * 1e9, static_cast<unsigned long long>(found));
+    // Every timed run adds to the sums, so compare one run's worth.
+    if (lookupSum != compiledSum || std::abs(substitutedSum - compiledSum) > 1e-9 * std::abs(compiledSum)) {
+        throw std::runtime_error("variable evaluation paths disagree");
+    }
+}
+
+// Distance between two doubles in units in the last place: the number of
+// representable values from one to the other.
+double ulpDistance(double a, double b) {
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b) ? 0 : INFINITY;
+    int64_t ia, ib;
+    std::memcpy(&ia, &a, sizeof(ia));
+    std::memcpy(&ib, &b, sizeof(ib));
+    if (ia < 0) ia = INT64_MIN - ia;  // Order negative values below positive ones.
+    if (ib < 0) ib = INT64_MIN - ib;
+    uint64_t distance = ia > ib ? uint64_t(ia) - uint64_t(ib) : uint64_t(ib) - uint64_t(ia);
+    return static_cast<double>(distance);
+}
+
+// Times the scalar and batch implementations of the functions with vector
+// kernels and checks each batch against its documented ulp bound, then
+// evaluates a formula with calls per row and with the columnar evaluator.
+void benchFunctions(const BenchmarkOptions& options) {
+    struct Domain {
+        FunctionId id;
+        double low, high;
+    };
+    const Domain DOMAINS[] = {
+        {FunctionId::SQRT, 0, 1e6},     {FunctionId::EXP, -20, 20},  {FunctionId::LOG, 1e-3, 1e6},
+        {FunctionId::SIN, -100, 100},   {FunctionId::COS, -100, 100}, {FunctionId::TAN, -100, 100},
+        {FunctionId::ROUND, -1e3, 1e3}, {FunctionId::MAX, -1e3, 1e3},
+    };
+    const size_t count = 4096;  // Cache-resident inputs.
+    const size_t rounds = std::max<size_t>(options.tokenCount / count, 1);
+    std::vector<double> left(count), right(count), scalar(count), batch(count);
+
+    std::printf("  batch implementation: %s\n", functionBatchImplementationName());
+    uint64_t state = 88172645463325252ull;
+    for (const Domain& domain : DOMAINS) {
+        const FunctionInfo& function = functionInfo(static_cast<uint32_t>(domain.id));
+        for (size_t i = 0; i < count; ++i) {
+            state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+            left[i] = domain.low + (domain.high - domain.low) * double(state >> 11) / 9007199254740992.0;
+            right[i] = domain.low + (domain.high - domain.low) * double(state & 0xFFFFF) / 1048576.0;
+        }
+
+        double scalarSeconds = bestOf(options.repetitions, [&] {
+            for (size_t round = 0; round < rounds; ++round) for (size_t i = 0; i < count; ++i) {
+                scalar[i] = function.arity == 1 ? function.unary(left[i]) : function.binary(left[i], right[i]);
+            }
+        });
+        double batchSeconds = bestOf(options.repetitions, [&] {
+            for (size_t round = 0; round < rounds; ++round) {
+                if (function.arity == 1) {
+                    function.unaryBatch(left.data(), batch.data(), count);
+                } else {
+                    function.binaryBatch(left.data(), right.data(), batch.data(), count);
+                }
+            }
+        });
+
+        double worst = 0;
+        for (size_t i = 0; i < count; ++i) worst = std::max(worst, ulpDistance(scalar[i], batch[i]));
+        const double values = double(count * rounds);
+        std::printf("  %-6s scalar %6.2f ns/value, batch %6.2f ns/value (%4.1fx), max %g ulp (bound %g)\n",
+                    function.name, scalarSeconds / values * 1e9, batchSeconds / values * 1e9,
+                    scalarSeconds / batchSeconds, worst, function.batchUlps);
+        if (worst > function.batchUlps) {
+            throw std::runtime_error(std::string(function.name) + " batch exceeds its ulp bound");
+        }
+    }
+
+    // x in [-8, 8), y in [0, 16).
+    Environment environment({"x", "y"});
+    const PostfixProgram program = compilePostfix(tokenizer("sqrt(x * x + y * y) + sin(x) * exp(y / 8)"),
+                                                  &environment.symbols());
+    const size_t rows = 1 << 16;
+    const size_t passes = std::max<size_t>(options.tokenCount / rows / 4, 1);
+    std::vector<double> xs(rows), ys(rows), rowResults(rows), columnResults(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        xs[i] = double(i % 1024) / 64 - 8;
+        ys[i] = double(i / 1024) / 4;
+    }
+    const double* columns[] = {xs.data(), ys.data()};
+
+    double rowSeconds = bestOf(options.repetitions, [&] {
+        for (size_t pass = 0; pass < passes; ++pass) for (size_t i = 0; i < rows; ++i) {
+            environment[0] = xs[i];
+            environment[1] = ys[i];
+            rowResults[i] = evaluate(program, environment.values());
+        }
+    });
+    double columnSeconds = bestOf(options.repetitions, [&] {
+        for (size_t pass = 0; pass < passes; ++pass) evaluateColumns(program, columns, rows, columnResults.data());
+    });
+
+    double worst = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        worst = std::max(worst, std::fabs(rowResults[i] - columnResults[i]) / std::max(std::fabs(rowResults[i]), 1.0));
+    }
+    const double evaluations = double(rows * passes);
+    std::printf("  per row:   %6.2f ns/row\n", rowSeconds / evaluations * 1e9);
+    std::printf("  columnar:  %6.2f ns/row (%.1fx; max relative difference %.2g)\n",
+                columnSeconds / evaluations * 1e9, rowSeconds / columnSeconds, worst);
+}
+
+// Relative error of `value` against the C library's `reference`; equal
+// special values (infinities, NaN) count as exact.
+double relativeError(double value, double reference) {
+    if (value == reference || (std::isnan(value) && std::isnan(reference))) return 0;
+    if (!std::isfinite(value) || !std::isfinite(reference)) return INFINITY;
+    return std::fabs(value - reference) / std::fabs(reference);
+}
+
+// Times each fast-math level's approximations against the C library on
+// sampled domains, checking the scalar and batch results against the
+// level's relative error bound, then evaluates a formula with '^' and
+// calls per row and columnar under each level.
+void benchFastMath(const BenchmarkOptions& options) {
+    struct Domain {
+        FunctionId id;
+        double low, high;
+    };
+    const Domain DOMAINS[] = {
+        {FunctionId::EXP, -700, 700},  {FunctionId::EXP2, -1000, 1000}, {FunctionId::LOG, 1e-3, 1e6},
+        {FunctionId::LOG2, 1e-3, 1e6}, {FunctionId::LOG10, 1e-3, 1e6},  {FunctionId::SIN, -100, 100},
+        {FunctionId::COS, -100, 100},  {FunctionId::TAN, -100, 100},    {FunctionId::POW, 0, 20},
+    };
+    const MathAccuracy LEVELS[] = {MathAccuracy::RELATIVE_1E12, MathAccuracy::RELATIVE_1E7};
+    const size_t count = 4096;  // Cache-resident inputs.
+    const size_t rounds = std::max<size_t>(options.tokenCount / count, 1);
+    std::vector<double> left(count), right(count), reference(count), scalar(count), batch(count);
+
+    std::string failure;
+    uint64_t state = 88172645463325252ull;
+    for (MathAccuracy level : LEVELS) {
+        const double bound = mathAccuracyBound(level);
+        const FunctionInfo* table = functionTable(level);
+        std::printf("  relative error bound %g:\n", bound);
+        for (const Domain& domain : DOMAINS) {
+            const FunctionInfo& exact = FUNCTIONS[static_cast<size_t>(domain.id)];
+            const FunctionInfo& fast = table[static_cast<size_t>(domain.id)];
+            for (size_t i = 0; i < count; ++i) {
+                state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+                left[i] = domain.low + (domain.high - domain.low) * double(state >> 11) / 9007199254740992.0;
+                right[i] = domain.low + (domain.high - domain.low) * double(state & 0xFFFFF) / 1048576.0;
+            }
+
+            auto timeScalar = [&](const FunctionInfo& function, std::vector<double>& out) {
+                return bestOf(options.repetitions, [&] {
+                    for (size_t round = 0; round < rounds; ++round) for (size_t i = 0; i < count; ++i) {
+                        out[i] = function.arity == 1 ? function.unary(left[i]) : function.binary(left[i], right[i]);
+                    }
+                });
+            };
+            double exactSeconds = timeScalar(exact, reference);
+            double scalarSeconds = timeScalar(fast, scalar);
+            double batchSeconds = bestOf(options.repetitions, [&] {
+                for (size_t round = 0; round < rounds; ++round) {
+                    if (fast.arity == 1) {
+                        fast.unaryBatch(left.data(), batch.data(), count);
+                    } else {
+                        fast.binaryBatch(left.data(), right.data(), batch.data(), count);
+                    }
+                }
+            });
+
+            double worstScalar = 0, worstBatch = 0;
+            for (size_t i = 0; i < count; ++i) {
+                worstScalar = std::max(worstScalar, relativeError(scalar[i], reference[i]));
+                worstBatch = std::max(worstBatch, relativeError(batch[i], reference[i]));
+            }
+            const double values = double(count * rounds);
+            std::printf("    %-6s libm %6.2f ns, fast %6.2f ns (%4.1fx), fast batch %6.2f ns (%4.1fx); "
+                        "max error %.2g / %.2g\n",
+                        fast.name, exactSeconds / values * 1e9, scalarSeconds / values * 1e9,
+                        exactSeconds / scalarSeconds, batchSeconds / values * 1e9, exactSeconds / batchSeconds,
+                        worstScalar, worstBatch);
+            if (std::max(worstScalar, worstBatch) > bound && failure.empty()) {
+                failure = std::string(fast.name) + " exceeds the relative error bound " + std::to_string(bound);
+            }
+        }
+    }
+
+    // A Monte Carlo style integrand; x in [-4, 4), y in [0, 4).
+    Environment environment({"x", "y"});
+    const PostfixProgram program = compilePostfix(tokenizer("y ^ 1.5 / exp(x * x / 2) + cos(x) * log(y + 1)"),
+                                                  &environment.symbols());
+    const size_t rows = 1 << 16;
+    const size_t passes = std::max<size_t>(options.tokenCount / rows / 4, 1);
+    std::vector<double> xs(rows), ys(rows), results(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        xs[i] = double(i % 1024) / 128 - 4;
+        ys[i] = double(i / 1024) / 16;
+    }
+    const double* columns[] = {xs.data(), ys.data()};
+
+    for (MathAccuracy level : {MathAccuracy::FULL, MathAccuracy::RELATIVE_1E12, MathAccuracy::RELATIVE_1E7}) {
+        setMathAccuracy(level);
+        double rowSeconds = bestOf(options.repetitions, [&] {
+            for (size_t pass = 0; pass < passes; ++pass) for (size_t i = 0; i < rows; ++i) {
+                environment[0] = xs[i];
+                environment[1] = ys[i];
+                results[i] = evaluate(program, environment.values());
+            }
+        });
+        double columnSeconds = bestOf(options.repetitions, [&] {
+            for (size_t pass = 0; pass < passes; ++pass) evaluateColumns(program, columns, rows, results.data());
+        });
+        const double evaluations = double(rows * passes);
+        std::printf("  integrand, bound %-6g per row %6.2f ns/row, columnar %6.2f ns/row\n",
+                    mathAccuracyBound(level), rowSeconds / evaluations * 1e9, columnSeconds / evaluations * 1e9);
+    }
+    setMathAccuracy(MathAccuracy::FULL);
+
+    if (!failure.empty()) throw std::runtime_error(failure);
+}
+
+// Times '^' by integer exponents through std::pow, binary exponentiation
+// and addition chains, checking both against the documented |n| ulp bound,
+// then evaluates a polynomial through the evaluators with and without
+// strict pow.
+void benchPower(const BenchmarkOptions& options) {
+    const int EXPONENTS[] = {2, 3, 5, 7, 10, 15, 31, 64, -3};
+    const size_t count = 4096;  // Cache-resident inputs.
+    const size_t rounds = std::max<size_t>(options.tokenCount / count, 1);
+    std::vector<double> bases(count), reference(count), binary(count), chain(count);
+    uint64_t state = 88172645463325252ull;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        bases[i] = 0.5 + 1.5 * double(state >> 11) / 9007199254740992.0;  // [0.5, 2).
+    }
+
+    for (int n : EXPONENTS) {
+        volatile int exponent = n;  // Keeps the loops from specializing on n.
+        double powSeconds = bestOf(options.repetitions, [&] {
+            for (size_t round = 0; round < rounds; ++round) for (size_t i = 0; i < count; ++i) {
+                reference[i] = std::pow(bases[i], exponent);
+            }
+        });
+        double binarySeconds = bestOf(options.repetitions, [&] {
+            for (size_t round = 0; round < rounds; ++round) for (size_t i = 0; i < count; ++i) {
+                binary[i] = integerPower(bases[i], exponent);
+            }
+        });
+        double chainSeconds = bestOf(options.repetitions, [&] {
+            for (size_t round = 0; round < rounds; ++round) for (size_t i = 0; i < count; ++i) {
+                chain[i] = chainPower(bases[i], exponent);
+            }
+        });
+
+        double worstBinary = 0, worstChain = 0;
+        for (size_t i = 0; i < count; ++i) {
+            worstBinary = std::max(worstBinary, ulpDistance(binary[i], reference[i]));
+            worstChain = std::max(worstChain, ulpDistance(chain[i], reference[i]));
+        }
+        const double values = double(count * rounds);
+        std::printf("  x^%-3d pow %6.2f ns, binary %6.2f ns (%4.1fx), chain %6.2f ns (%4.1fx); max %g / %g ulp\n",
+                    n, powSeconds / values * 1e9, binarySeconds / values * 1e9, powSeconds / binarySeconds,
+                    chainSeconds / values * 1e9, powSeconds / chainSeconds, worstBinary, worstChain);
+        if (std::max(worstBinary, worstChain) > std::abs(n)) {
+            throw std::runtime_error("x^" + std::to_string(n) + " exceeds its ulp bound");
+        }
+    }
+
+    Environment environment({"x"});
+    const PostfixProgram program = compilePostfix(tokenizer("x ^ 5 / 120 - x ^ 3 / 6 + x ^ 2 * 0.5 + x ^ 7 - 3"),
+                                                  &environment.symbols());
+    const size_t passes = std::max<size_t>(options.tokenCount / count / 4, 1);
+    for (bool strict : {true, false}) {
+        setStrictPower(strict);
+        const PostfixProgram fused = fuseInstructions(program, FusionPlan::all());
+        const RegisterProgram registers = compileRegisters(program);
+        auto timeRows = [&](auto&& evaluateRow) {
+            double seconds = bestOf(options.repetitions, [&] {
+                for (size_t pass = 0; pass < passes; ++pass) for (size_t i = 0; i < count; ++i) {
+                    environment[0] = bases[i];
+                    reference[i] = evaluateRow(environment.values());
+                }
+            });
+            return seconds / double(count * passes) * 1e9;
+        };
+        double postfixNs = timeRows([&](const double* values) { return evaluate(program, values); });
+        double fusedNs = timeRows([&](const double* values) { return evaluate(fused, values); });
+        double registerNs = timeRows([&](const double* values) { return evaluate(registers, values); });
+        std::printf("  polynomial, %-7s postfix %6.2f ns, fused %6.2f ns, register %6.2f ns\n",
+                    strict ? "strict:" : "chains:", postfixNs, fusedNs, registerNs);
+    }
+    setStrictPower(false);
+}
+
+// Times the --map pipeline over generated numbers, one per line: parsing
+// alone, writing alone, and the whole map of a linear formula.
+void benchMap(const BenchmarkOptions& options) {
+    const size_t count = std::max<size_t>(options.tokenCount / 4, MAP_BLOCK_NUMBERS);
+    std::string text;
+    uint64_t state = 88172645463325252ull;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        char number[32];
+        std::snprintf(number, sizeof number, "%.6g\n", double(state >> 11) / 9007199254740992.0 * 2000 - 1000);
+        text += number;
+    }
+
+    std::vector<double> values(MAP_BLOCK_NUMBERS);
+    double readSeconds = bestOf(options.repetitions, [&] {
+        std::istringstream in(text);
+        NumberReader reader(in);
+        while (reader.read(values.data(), values.size()) != 0) {}
+    });
+    double writeSeconds = bestOf(options.repetitions, [&] {
+        std::ostringstream out;
+        NumberWriter writer(out);
+        for (size_t written = 0; written < count; written += values.size()) writer.write(values.data(), values.size());
+    });
+
+    Environment environment({"x"});
+    const PostfixProgram program = compilePostfix(tokenizer("x * 1.08 + 2"), &environment.symbols());
+    double mapSeconds = bestOf(options.repetitions, [&] {
+        std::istringstream in(text);
+        std::ostringstream out;
+        NumberReader reader(in);
+        NumberWriter writer(out);
+        mapNumbers(program, environment, 0, reader, writer);
+    });
+    const double numbers = double(count);
+    std::printf("  %zu numbers (%.1f MB): read %.1f ns, write %.1f ns, map %.1f ns per number (%.1f M/s)\n",
+                count, double(text.size()) / 1e6, readSeconds / numbers * 1e9, writeSeconds / numbers * 1e9,
+                mapSeconds / numbers * 1e9, numbers / mapSeconds / 1e6);
+}
+
+// Compares the lane-parallel block summaries of RunningStats with a
+// per-number Welford update, and times a custom fold, over numbers
+// already in memory.
+void benchReduce(const BenchmarkOptions& options) {
+    const size_t count = std::max<size_t>(options.tokenCount, MAP_BLOCK_NUMBERS);
+    std::vector<double> values(count);
+    uint64_t state = 88172645463325252ull;
+    for (double& value : values) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        value = 1e6 + double(state >> 11) / 9007199254740992.0;
+    }
+
+    RunningStats stats;
+    double blockSeconds = bestOf(options.repetitions, [&] {
+        stats = RunningStats();
+        for (size_t i = 0; i < count; i += MAP_BLOCK_NUMBERS) {
+            stats.add(values.data() + i, std::min(MAP_BLOCK_NUMBERS, count - i));
+        }
+    });
+    double mean = 0, m2 = 0;
+    double welfordSeconds = bestOf(options.repetitions, [&] {
+        mean = m2 = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const double delta = values[i] - mean;
+            mean += delta / double(i + 1);
+            m2 += delta * (values[i] - mean);
+        }
+    });
+
+    Environment environment({"x", "acc"});
+    const PostfixProgram program = compilePostfix(tokenizer("acc + (x - 1000000) ^ 2"), &environment.symbols());
+    Fold fold(program, environment, 0);
+    double foldSeconds = bestOf(1, [&] {
+        for (size_t i = 0; i < count; i += MAP_BLOCK_NUMBERS) {
+            fold.add(values.data() + i, std::min(MAP_BLOCK_NUMBERS, count - i));
+        }
+    });
+    const double numbers = double(count);
+    std::printf("  blocks %.2f ns, Welford %.2f ns, fold %.2f ns per number; var %.12g / %.12g\n",
+                blockSeconds / numbers * 1e9, welfordSeconds / numbers * 1e9, foldSeconds / numbers * 1e9,
+                stats.value(Aggregate::VAR), m2 / numbers);
+}
+
+// Times --csv over a generated file of five columns, on one thread and on
+// every CPU.
+void benchCsv(const BenchmarkOptions& options) {
+    const size_t rows = std::max<size_t>(options.tokenCount / 5, 1);
+    std::string header = "id,region,revenue,cost,qty";
+    std::string text;
+    uint64_t state = 88172645463325252ull;
+    for (size_t i = 0; i < rows; ++i) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        char line[96];
+        std::snprintf(line, sizeof line, "%zu,r%zu,%.2f,%.2f,%zu\n", i, i % 7, double(state % 1000000) / 100,
+                      double(state / 1000000 % 500000) / 100, size_t(state % 100 + 1));
+        text += line;
+    }
+
+    Environment environment({"id", "revenue", "cost", "qty"});
+    const PostfixProgram program = compilePostfix(tokenizer("revenue - cost * 1.2"), &environment.symbols());
+    const std::vector<uint32_t> fieldSlots = {0, SymbolTable::NO_SLOT, 1, 2, 3};
+    const unsigned cpus = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned threads : {1u, cpus}) {
+        CsvOptions csvOptions;
+        csvOptions.threads = threads;
+        double seconds = bestOf(options.repetitions, [&] {
+            std::istringstream in(text);
+            std::ostringstream out;
+            mapCsv(program, environment, fieldSlots, header, in, out, csvOptions);
+        });
+        std::printf("  %zu rows (%.1f MB), %u thread(s): %.1f ns per row, %.0f MB/s\n", rows, double(text.size()) / 1e6,
+                    threads, seconds / double(rows) * 1e9, double(text.size()) / seconds / 1e6);
+        if (cpus == 1) break;
+    }
+}
+
+// Evaluates a formula over .npy columns in the temporary directory, with
+// the second column stored as float64 (read in place) and as float32
+// (converted per block), writing a float64 .npy each time.
+void benchNpy(const BenchmarkOptions& options) {
+    const size_t count = std::max<size_t>(options.tokenCount, NPY_BLOCK_ROWS);
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string xPath = (directory / "calculator_bench_x.npy").string();
+    const std::string y64Path = (directory / "calculator_bench_y64.npy").string();
+    const std::string y32Path = (directory / "calculator_bench_y32.npy").string();
+    const std::string outPath = (directory / "calculator_bench_out.npy").string();
+    {
+        std::vector<double> x(count), y(count);
+        std::vector<float> y32(count);
+        uint64_t state = 88172645463325252ull;
+        for (size_t i = 0; i < count; ++i) {
+            state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+            x[i] = double(state >> 11) / 9007199254740992.0;
+            y[i] = double(state % 1000) - 500;
+            y32[i] = float(y[i]);
+        }
+        NpyWriter xFile(xPath, count), yFile(y64Path, count);
+        std::copy(x.begin(), x.end(), xFile.data());
+        std::copy(y.begin(), y.end(), yFile.data());
+        xFile.finish();
+        yFile.finish();
+        std::ofstream y32File(y32Path, std::ios::binary);
+        std::string header = npyFloat64Header(count);
+        header.replace(header.find("<f8"), 3, "<f4");
+        y32File << header;
+        y32File.write(reinterpret_cast<const char*>(y32.data()), std::streamsize(count * sizeof(float)));
+    }
+
+    Environment environment({"x", "y"});
+    const PostfixProgram program = compilePostfix(tokenizer("x * y + 2 * x - y / 4"), &environment.symbols());
+    for (const std::string& yPath : {y64Path, y32Path}) {
+        double seconds = bestOf(options.repetitions, [&] {
+            NpyArray x(xPath), y(yPath);
+            NpyWriter out(outPath, count);
+            evaluateNpy(program, environment, {&x, &y}, count, out.data());
+            out.finish();
+        });
+        std::printf("  %zu rows, y as %s: %.2f ns per row, %.0f MB/s of input\n", count,
+                    yPath == y64Path ? "float64" : "float32", seconds / double(count) * 1e9,
+                    double(count) * (yPath == y64Path ? 16 : 12) / seconds / 1e6);
+    }
+    for (const std::string& path : {xPath, y64Path, y32Path, outPath}) std::filesystem::remove(path);
+}
+
+#if __cplusplus >= 202002L
+// Compares a formula compiled with calc::compile against the same formula
+// written by hand, and against parsing and evaluating it at run time.
+void benchCompiledExpression(const BenchmarkOptions& options) {
+    const size_t count = 4096;  // Cache-resident inputs.
+    const size_t rounds = std::max<size_t>(options.tokenCount / count, 1);
+    std::vector<double> a(count), b(count), c(count), out(count);
+    uint64_t state = 88172645463325252ull;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+        a[i] = double(state >> 40) / 1024;
+        b[i] = double((state >> 8) & 0xFFFF) / 64;
+        c[i] = double(state & 0xFF) + 1;
+    }
+
+    constexpr auto formula = calc::compile<"(a + b) * c - a / (c * 2) + 0.5">;
+    double compiledSum = 0, handSum = 0;
+    double compiledSeconds = bestOf(options.repetitions, [&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            for (size_t i = 0; i < count; ++i) out[i] = formula(a[i], b[i], c[i]);
+        }
+    });
+    for (double value : out) compiledSum += value;
+    double handSeconds = bestOf(options.repetitions, [&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            for (size_t i = 0; i < count; ++i) {
+                double divisor = c[i] * 2;
+                if (divisor == 0) throw std::runtime_error("Math Error: Division by zero");
+                out[i] = (a[i] + b[i]) * c[i] - a[i] / divisor + 0.5;
+            }
+        }
+    });
+    for (double value : out) handSum += value;
+
+    // The run-time path sees the formula as text, as configuration does.
+    const std::string text = "(1.5 + 2.25) * 3 - 1.5 / (3 * 2) + 0.5";
+    const size_t parses = std::max<size_t>(options.tokenCount / 100, 1);
+    double parsedSum = 0;
+    double runtimeSeconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < parses; ++i) parsedSum += calculate(tokenizer(text));
+    });
+
+    const size_t evaluations = count * rounds;
+    std::printf("  calc::compile:      %.2f ns/evaluation (checksum %.6g)\n",
+                compiledSeconds / evaluations * 1e9, compiledSum);
+    std::printf("  hand-written:       %.2f ns/evaluation (checksum %.6g)\n",
+                handSeconds / evaluations * 1e9, handSum);
+    std::printf("  calculate(text):    %.2f ns/evaluation\n", runtimeSeconds / parses * 1e9);
+    if (compiledSum != handSum || formula(1.5, 2.25, 3) != calculate(tokenizer(text))) {
+        throw std::runtime_error("compiled formula disagrees");
+    }
+}
+#endif
+
+// Compares the throwing and non-throwing APIs on corpora where a given
+// fraction of the expressions is malformed.
+void benchErrorHeavy(const BenchmarkOptions& options) {
+    const std::vector<std::string> valid = {
+        "2 + 3 * (4 - 1)", "10 / 2 + 5", "(5 + 3) * 2", "2 ^ 3 ^ 2", "1.5 * 4 - .5",
+    };
+    const std::vector<std::string> malformed = {
+        "(2 + 3", "10 / (5 - 5)", "2 + * 3", "4 $ 2", "1 2",
+    };
+    const size_t iterations = options.tokenCount / 10;
+
+    for (int percent : {5, 50}) {
+        std::vector<const std::string*> corpus;
+        for (size_t i = 0; i < 100; ++i) {
+            corpus.push_back(i % 100 < size_t(percent) ? &malformed[i % malformed.size()]
+                                                       : &valid[i % valid.size()]);
+        }
+
+        EvalScratch scratch;
+        size_t failures = 0;
+        double throwingSeconds = bestOf(options.repetitions, [&] {
+            failures = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                try {
+                    calculate(*corpus[i % corpus.size()], scratch);
+                } catch (const std::runtime_error&) {
+                    ++failures;
+                }
+            }
+        });
+        double resultSeconds = bestOf(options.repetitions, [&] {
+            failures = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                failures += !tryCalculate(*corpus[i % corpus.size()], scratch).ok();
+            }
+        });
+
+        std::printf("  %2d%% malformed (%zu failures): throwing %.1f ns/expression, "
+                    "tryCalculate %.1f ns/expression\n", percent, failures,
+                    throwingSeconds / iterations * 1e9, resultSeconds / iterations * 1e9);
+    }
+}
+
+// Measures the cost of recording one latency sample.
+void benchLatencyHistogram(const BenchmarkOptions& options) {
+    ThreadLatencyHistograms histograms;
+    LatencyHistogram& histogram = histograms.local();
+    const size_t iterations = options.tokenCount * 10;
+
+    // Spread values over several orders of magnitude, like real latencies.
+    uint64_t value = 88172645463325252ull;
+    double seconds = bestOf(options.repetitions, [&] {
+        for (size_t i = 0; i < iterations; ++i) {
+            value ^= value << 13; value ^= value >> 7; value ^= value << 17;
+            histogram.record((value & 0xFFFFF) >> (value >> 60));
+        }
+    });
+
+    std::printf("  %.2f ns/record, ", seconds / iterations * 1e9);
+    std::ostringstream summary;
+    histograms.merged().printPercentiles(summary);
+    std::printf("%s\n", summary.str().c_str());
+}
+
+const std::vector<BenchmarkCase>& benchmarkCases() {
+    static const std::vector<BenchmarkCase> cases = {
+        {"classifier", benchClassifier},
+        {"scanner", benchScanner},
+        {"tokenizer", benchTokenizer},
+        {"token-buffer", benchTokenBuffer},
+        {"zero-alloc", benchZeroAllocation},
+        {"pmr", benchMemoryResource},
+        {"arena-tree", benchArenaTree},
+        {"vm", benchVirtualMachines},
+        {"peephole", benchPeephole},
+        {"kernels", benchOperatorKernels},
+        {"variables", benchVariables},
+        {"functions", benchFunctions},
+        {"fast-math", benchFastMath},
+        {"power", benchPower},
+        {"map", benchMap},
+        {"reduce", benchReduce},
+        {"csv", benchCsv},
+        {"npy", benchNpy},
+#if __cplusplus >= 202002L
+        {"compiled", benchCompiledExpression},
+#endif
+        {"error-heavy", benchErrorHeavy},
+        {"latency-histogram", benchLatencyHistogram},
+    };
+    return cases;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    CLI::App app{"Benchmarks for the tokenizer and evaluator"};
+
+    BenchmarkOptions options;
+    std::string filter;
+    bool perfCounters = false;
+    app.add_option("-f,--filter", filter, "Run only benchmarks whose name contains this string");
+    app.add_option("-s,--size", options.inputBytes, "Approximate input size in bytes");
+    app.add_option("-t,--tokens", options.tokenCount, "Approximate token count for evaluation benchmarks");
+    app.add_flag("--perf-counters", perfCounters, "Report hardware counters (IPC, branch-miss rate) per benchmark");
+    app.add_option("-r,--repetitions", options.repetitions, "Timed runs per benchmark")
+        ->check(CLI::PositiveNumber);
+
+    try {
+        app.parse(argc, argv);
+    } catch (const CLI::ParseError &e) {
+        return app.exit(e);
+    }
+
+    std::unique_ptr<PerfCounters> counters;
+    if (perfCounters) {
+        counters = std::make_unique<PerfCounters>();
+        if (!counters->available()) {
+            std::printf("hardware counters unavailable: %s\n", counters->unavailableReason().c_str());
+        }
+    }
+
+    int status = 0;
+    for (const auto& benchmark : benchmarkCases()) {
+        if (benchmark.name.find(filter) == std::string::npos) continue;
+        std::printf("%s\n", benchmark.name.c_str());
+        PerfSample start = counters ? counters->read() : PerfSample();
+        try {
+            benchmark.run(options);
+        } catch (const std::exception& e) {
+            std::printf("  FAILED: %s\n", e.what());
+            status = 1;
+        }
+        if (counters && counters->available()) {
+            std::ostringstream summary;
+            summary << (counters->read() - start);
+            std::printf("  perf: %s\n", summary.str().c_str());
+        }
+    }
+
+    return status;
+}
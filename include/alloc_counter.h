@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation counting replaces the global `operator new` and
+// `operator delete`, so it is only compiled in with -DALLOC_COUNTER_ENABLED
+// (the benchmarks need it). Otherwise the default allocator is used and
+// every count reads zero.
+
+// Heap allocation totals recorded by the replaced global `operator new`.
+struct AllocationStats {
+    uint64_t count = 0;  // Number of calls to operator new.
+    uint64_t bytes = 0;  // Total bytes requested.
+};
+
+// Returns true if this build counts allocations (ALLOC_COUNTER_ENABLED).
+bool allocationCountingEnabled();
+
+// Returns the allocations made by the calling thread so far. Counters are
+// thread-local, so recording an allocation costs two non-atomic increments.
+AllocationStats threadAllocationStats();
+
+// Measures the allocations made by the calling thread between construction
+// and each call to `elapsed()`. Used to check that hot loops stay
+// allocation-free once their buffers are warmed up.
+class AllocationCounter {
+public:
+    AllocationCounter() : start_(threadAllocationStats()) {}
+
+    // Returns the allocations made since construction (or the last reset).
+    AllocationStats elapsed() const {
+        AllocationStats now = threadAllocationStats();
+        return AllocationStats{now.count - start_.count, now.bytes - start_.bytes};
+    }
+
+    // Restarts the measurement from the current totals.
+    void reset() { start_ = threadAllocationStats(); }
+
+private:
+    AllocationStats start_;
+};
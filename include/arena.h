@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Options for an Arena.
+struct ArenaOptions {
+    size_t blockSize = 64 * 1024;  // Default size of each block in bytes.
+    bool hugePages = false;        // Back large blocks with huge pages when possible.
+};
+
+// A bump-pointer allocator. Allocations are carved sequentially out of large
+// blocks and are never freed individually: `reset()` releases everything in
+// O(1) (keeping the blocks for reuse) and the destructor returns the blocks
+// to the system. Objects allocated here must be trivially destructible.
+//
+// With `hugePages` set, blocks of at least 2 MiB are mapped with
+// MAP_HUGETLB on Linux, falling back to transparent huge pages
+// (madvise(MADV_HUGEPAGE)) when no huge pages are reserved. The option is
+// ignored on other platforms.
+class Arena {
+public:
+    // Minimum alignment of every allocation.
+    static constexpr size_t ALIGNMENT = 16;
+
+    Arena() : Arena(ArenaOptions()) {}
+    explicit Arena(ArenaOptions options);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Returns `size` bytes aligned to at least ALIGNMENT (or `alignment` if
+    // larger). Throws std::bad_alloc if the system is out of memory.
+    void* allocate(size_t size, size_t alignment = ALIGNMENT);
+
+    // Allocates uninitialized storage for `count` objects of type T.
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Constructs a T in the arena.
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Releases every allocation at once. Blocks are kept and reused.
+    void reset();
+
+    // Returns the number of bytes handed out since construction or `reset()`.
+    size_t bytesUsed() const { return bytesUsed_; }
+
+    // Returns the number of bytes obtained from the system.
+    size_t bytesReserved() const { return bytesReserved_; }
+
+private:
+    struct Block {
+        Block* next;     // Next block in allocation order.
+        size_t size;     // Total size including this header.
+        bool mapped;     // True if obtained with mmap rather than malloc.
+    };
+
+    // Size of the block header, rounded so the payload starts aligned.
+    static constexpr size_t HEADER_SIZE = (sizeof(Block) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    // Makes the block after `current_` (reusing one if possible) large enough
+    // for `size` bytes at `alignment`, and makes it current.
+    void advance(size_t size, size_t alignment);
+    Block* newBlock(size_t minimumSize);
+    void freeBlock(Block* block);
+
+    ArenaOptions options_;
+    Block* first_ = nullptr;    // Oldest block.
+    Block* current_ = nullptr;  // Block currently being bumped.
+    char* cursor_ = nullptr;    // Next free byte in `current_`.
+    char* limit_ = nullptr;     // End of `current_`.
+    size_t bytesUsed_ = 0;
+    size_t bytesReserved_ = 0;
+};
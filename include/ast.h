@@ -0,0 +1,58 @@
+#pragma once
+
+#include "arena.h"
+#include "environment.h"
+#include "token_buffer.h"
+#include "tokenizer.h"
+#include <cstdint>
+#include <vector>
+
+// The kind of an expression tree node.
+enum class NodeKind : uint8_t {
+    NUMBER,    // A literal value.
+    VARIABLE,  // The value in variable slot `slot`.
+    BINARY,    // An operator applied to `left` and `right`.
+    CALL,      // Function `slot` (a FunctionId) applied to `left` (and `right`).
+};
+
+// A node of an expression tree: 32 bytes, 16-byte aligned, allocated from
+// an Arena. Trivially destructible, so freeing the arena frees the tree.
+struct alignas(16) ExprNode {
+    const ExprNode* left;   // Left operand (BINARY) or first argument (CALL).
+    const ExprNode* right;  // Right operand (BINARY) or second argument (CALL).
+    double value;           // Literal value (NUMBER only).
+    NodeKind kind;          // Number, variable, operator or call.
+    OpCode op;              // Operator code (BINARY only).
+    uint32_t slot;          // Variable slot (VARIABLE) or FunctionId (CALL).
+};
+
+// An expression tree whose nodes are packed in one contiguous array in
+// post-order (operands before their operator), so the root is the last node
+// and evaluation is a single forward pass over memory.
+struct ExprTree {
+    const ExprNode* nodes = nullptr;  // All nodes, in allocation (post-)order.
+    size_t nodeCount = 0;             // Number of nodes.
+    size_t maxDepth = 0;              // Operand stack depth needed to evaluate.
+    size_t variableCount = 0;         // One more than the highest variable slot used.
+
+    // Returns the root node.
+    const ExprNode* root() const { return nodes + nodeCount - 1; }
+};
+
+// Parses a token stream from `tokenizer()` into a tree allocated from
+// `arena` with one bump allocation for all nodes. The tree stays valid
+// until the arena is reset or destroyed.
+// Throws the same syntax errors as `calculate()` (e.g., mismatched parentheses).
+// Because the whole expression is parsed before anything is evaluated, a
+// malformed expression reports its syntax error even if it also divides by zero.
+// Identifiers are resolved to slots in `symbols` here, once; without a
+// table, or for a name it lacks, parsing throws an unknown-variable error.
+// Function names are resolved to FunctionIds (functions.h) and calls are
+// checked for their number of arguments.
+ExprTree parseExpressionTree(const std::vector<Token>& tokens, Arena& arena,
+                             const SymbolTable* symbols = nullptr);
+
+// Evaluates a tree by walking its nodes in memory order. VARIABLE nodes
+// read `variables[slot]` (e.g., Environment::values()).
+// Throws a runtime error on division by zero.
+double evaluate(const ExprTree& tree, const double* variables = nullptr);
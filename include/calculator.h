@@ -1,10 +1,15 @@
 #pragma once
 
+#include "environment.h"
+#include "eval_result.h"
 #include "tokenizer.h"
+#include "token_buffer.h"
 #include <stack>
 #include <cmath>       // For mathematical operations like std::pow.
 #include <stdexcept>   // For exception handling with std::runtime_error.
+#include <memory_resource>
 #include <string>
+#include <vector>
 
 // Applies the given operator (from operatorToken) to the top elements of the operand stack.
 // Modifies the operandStack in place by popping the required operands and pushing the result.
@@ -13,6 +18,68 @@
 void applyOperation(std::stack<double>& operandStack, const Token& operatorToken);
 
 // Evaluates a mathematical expression represented as a vector of tokens.
-// Returns the computed result as a double.
+// Returns the computed result as a double. Calls to the built-in functions
+// of functions.h are evaluated here and by every other overload.
 // Throws runtime errors for syntax or evaluation issues (e.g., mismatched parentheses).
 double calculate(const std::vector<Token>& tokenized_expression);
+
+// Same as above for expressions with variables: each IDENTIFIER token is
+// looked up in `environment` by name. To evaluate one expression with many
+// values, compile it once against `environment.symbols()` instead (see
+// program.h), which resolves names to slots at parse time.
+// Throws a runtime error for names the environment does not define.
+double calculate(const std::vector<Token>& tokenized_expression, const Environment& environment);
+
+// Same as above, but the operand and operator stacks are allocated from
+// `resource` (e.g., a per-request std::pmr::monotonic_buffer_resource).
+double calculate(const std::pmr::vector<Token>& tokenized_expression, std::pmr::memory_resource* resource);
+
+// Evaluates an expression stored in a structure-of-arrays TokenBuffer.
+// Same rules and error messages as the Token-based overload, but operands
+// come from the buffer's literal pool and operators from its opcode array,
+// so the loop walks densely packed arrays instead of 48-byte tokens.
+double calculate(const TokenBuffer& tokens);
+
+// Caller-owned scratch state for repeated evaluation: a token buffer plus the
+// operand and operator stacks. Everything is cleared between expressions but
+// never freed, so once the buffers have grown to fit the largest expression
+// (or were sized up front with `reserve`) evaluation does not allocate.
+// All buffers allocate from one std::pmr::memory_resource, the default
+// resource unless one is passed to the constructor.
+struct EvalScratch {
+    TokenBuffer tokens;                       // Token storage reused by `calculate(string_view, ...)`.
+    std::pmr::vector<double> operandStack;    // Operand stack reused across calls.
+    std::pmr::vector<uint32_t> operatorStack; // Token indexes of pending operators and '('.
+
+    EvalScratch() = default;
+
+    // Creates scratch state whose buffers all allocate from `resource`.
+    explicit EvalScratch(std::pmr::memory_resource* resource);
+
+    // Reserves room for expressions of up to `tokenCount` tokens.
+    void reserve(size_t tokenCount);
+
+    // Empties all buffers without releasing their memory.
+    void clear();
+};
+
+// Evaluates a TokenBuffer using the stacks in `scratch` instead of fresh ones.
+double calculate(const TokenBuffer& tokens, EvalScratch& scratch);
+
+// Tokenizes `expression` into `scratch.tokens` and evaluates it with the
+// scratch stacks. Allocation-free after warm-up.
+double calculate(std::string_view expression, EvalScratch& scratch);
+
+// Tokenizes and evaluates `expression` with every token buffer and stack
+// allocated from `resource`. Nothing is freed individually, so a
+// std::pmr::monotonic_buffer_resource can release it all at once.
+double calculate(std::string_view expression, std::pmr::memory_resource* resource);
+
+// Non-throwing counterparts of the EvalScratch overloads. Every failure is
+// returned as an EvalError plus the source offset of the offending token;
+// no exception is thrown, nothing is written to std::cerr, and no message
+// string is built unless the caller asks for `EvalResult::message()`.
+// Invalid characters are errors here rather than skipped with a warning,
+// and identifiers fail with UNKNOWN_VARIABLE: these take no environment.
+EvalResult tryCalculate(const TokenBuffer& tokens, EvalScratch& scratch) noexcept;
+EvalResult tryCalculate(std::string_view expression, EvalScratch& scratch) noexcept;
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "program.h"
+#include <cstddef>
+
+// Rows `evaluateColumns` processes at a time. A block of 256 doubles per
+// stack entry keeps the working set of ordinary expressions in L1.
+const size_t COLUMN_BLOCK_ROWS = 256;
+
+// Evaluates `program` once per row of column-major data: row r reads
+// variable slot s from `columns[s][r]` and its result goes to `out[r]`.
+//
+// Rows are processed a block at a time and each instruction runs as one
+// loop over the block: operators through the array kernels of
+// OPERATOR_KERNELS, calls and '^' by non-integer exponents through the
+// functions' batch implementations (functions.h). Dispatch is paid once per block instead
+// of once per row and the loops vectorize. The results are those of
+// `evaluate` on each row, except that batch functions may differ from
+// their scalar versions by up to `FunctionInfo::batchUlps`.
+//
+// Accepts programs without superinstructions. Throws a runtime error if
+// any row divides by zero; rows of earlier blocks have been written by then.
+void evaluateColumns(const PostfixProgram& program, const double* const* columns, size_t rows, double* out);
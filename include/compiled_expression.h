@@ -0,0 +1,201 @@
+#pragma once
+
+#include "constexpr_eval.h"
+
+#if __cplusplus >= 202002L
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+
+// Formulas compiled into C++ at build time (C++20):
+//
+//     constexpr auto area = calc::compile<"w * h + 2 * margin">;
+//     double a = area(2.0, 3.0, 0.5);  // Arguments in name order: h, margin, w.
+//
+// The formula is parsed by the constexpr shunting-yard of constexpr_eval.h,
+// so it follows the precedence and associativity of tokenizer.h and a
+// malformed formula is a compile error. Identifiers (a letter or '_'
+// followed by letters, digits and '_') are parameters, ordered by name;
+// `VARIABLES` lists them. Each tree node becomes one instantiation of a
+// small always-inlined function, so a call compiles to the arithmetic a
+// hand-written expression would, plus a zero test for every division by a
+// computed divisor; dividing by a literal zero is a compile error. `^` by
+// an integer literal of magnitude up to 64 unrolls its addition chain into
+// multiplications; other exponents call `power` (power.h). Either way,
+// formulas using `^` are not constant expressions.
+#if defined(__GNUC__)
+#define CALC_ALWAYS_INLINE [[gnu::always_inline]] inline
+#else
+#define CALC_ALWAYS_INLINE inline
+#endif
+
+namespace calc {
+
+// A string literal usable as a template argument.
+template <size_t N>
+struct FixedString {
+    char chars[N] = {};
+
+    constexpr FixedString(const char (&text)[N]) { std::copy_n(text, N, chars); }
+    constexpr std::string_view view() const { return {chars, N - 1}; }
+};
+
+namespace detail {
+
+enum class CompiledKind : uint8_t { NUMBER, VARIABLE, BINARY };
+
+// One node of a compiled formula. Children precede their parent.
+struct CompiledNode {
+    CompiledKind kind = CompiledKind::NUMBER;
+    OpCode op = OpCode::NONE;
+    double value = 0;     // NUMBER.
+    size_t variable = 0;  // VARIABLE: index into the sorted parameter list.
+    size_t left = 0;      // BINARY: node indexes.
+    size_t right = 0;
+};
+
+// A parsed formula in post-order; the root is the last node. A formula of
+// `Capacity` characters never has more nodes or variables than that.
+template <size_t Capacity>
+struct CompiledTree {
+    std::array<CompiledNode, Capacity> nodes{};
+    size_t nodeCount = 0;
+    std::array<std::string_view, Capacity> variables{};
+    size_t variableCount = 0;
+};
+
+// Builder for `parseConstantExpression` that records tree nodes.
+template <size_t Capacity>
+struct TreeBuilder {
+    static constexpr bool ACCEPTS_IDENTIFIERS = true;
+    CompiledTree<Capacity> tree;
+    ConstantStack<size_t> operands;
+
+    constexpr void number(double value) {
+        CompiledNode node;
+        node.value = value;
+        push(node);
+    }
+
+    constexpr void identifier(std::string_view name) {
+        CompiledNode node;
+        node.kind = CompiledKind::VARIABLE;
+        while (node.variable < tree.variableCount && tree.variables[node.variable] != name) ++node.variable;
+        if (node.variable == tree.variableCount) tree.variables[tree.variableCount++] = name;
+        push(node);
+    }
+
+    constexpr void apply(char op) {
+        CompiledNode node;
+        node.kind = CompiledKind::BINARY;
+        node.op = opCodeFromChar(op);
+        node.right = operands.pop();
+        node.left = operands.pop();
+        const CompiledNode& divisor = tree.nodes[node.right];
+        if (node.op == OpCode::DIVIDE && divisor.kind == CompiledKind::NUMBER && divisor.value == 0) {
+            throw std::runtime_error("Math Error: Division by zero");
+        }
+        push(node);
+    }
+
+    constexpr void push(const CompiledNode& node) {
+        tree.nodes[tree.nodeCount] = node;
+        operands.push(tree.nodeCount++);
+    }
+};
+
+// True for a literal exponent that '^' raises by its addition chain:
+// a nonzero integer within MAX_INTEGER_EXPONENT (power.h).
+constexpr bool hasChainExponent(const CompiledNode& exponent) {
+    return exponent.kind == CompiledKind::NUMBER && exponent.value != 0 &&
+           exponent.value >= -MAX_INTEGER_EXPONENT && exponent.value <= MAX_INTEGER_EXPONENT &&
+           exponent.value == static_cast<int>(exponent.value);
+}
+
+// Parses `expression` and renumbers its variables in name order.
+template <size_t Capacity>
+constexpr CompiledTree<Capacity> compileTree(std::string_view expression) {
+    TreeBuilder<Capacity> builder;
+    parseConstantExpression(expression, builder);
+    CompiledTree<Capacity> tree = builder.tree;
+
+    std::array<size_t, Capacity> rank{};
+    for (size_t i = 0; i < tree.variableCount; ++i) {
+        for (size_t j = 0; j < tree.variableCount; ++j) {
+            if (tree.variables[j] < tree.variables[i]) ++rank[i];
+        }
+    }
+    for (size_t i = 0; i < tree.nodeCount; ++i) {
+        if (tree.nodes[i].kind == CompiledKind::VARIABLE) tree.nodes[i].variable = rank[tree.nodes[i].variable];
+    }
+    std::sort(tree.variables.begin(), tree.variables.begin() + tree.variableCount);
+    return tree;
+}
+
+}  // namespace detail
+
+// The callable produced by `compile<Source>`; see the top of this file.
+template <FixedString Source>
+class CompiledExpression {
+    static constexpr auto TREE = detail::compileTree<sizeof(Source.chars)>(Source.view());
+
+public:
+    // Number of parameters, and their names in the order calls take them.
+    static constexpr size_t VARIABLE_COUNT = TREE.variableCount;
+    static constexpr std::array<std::string_view, VARIABLE_COUNT> VARIABLES = [] {
+        std::array<std::string_view, VARIABLE_COUNT> names{};
+        std::copy_n(TREE.variables.begin(), VARIABLE_COUNT, names.begin());
+        return names;
+    }();
+
+    // Evaluates the formula with one argument per variable, in name order.
+    template <std::convertible_to<double>... Args>
+        requires(sizeof...(Args) == VARIABLE_COUNT)
+    CALC_ALWAYS_INLINE constexpr double operator()(Args... args) const {
+        const std::array<double, VARIABLE_COUNT> values = {static_cast<double>(args)...};
+        return node<TREE.nodeCount - 1>(values.data());
+    }
+
+    // Evaluates the formula with variable values read from `values`.
+    CALC_ALWAYS_INLINE constexpr double evaluate(const double* values) const {
+        return node<TREE.nodeCount - 1>(values);
+    }
+
+private:
+    template <size_t Index>
+    CALC_ALWAYS_INLINE static constexpr double node(const double* values) {
+        constexpr detail::CompiledNode NODE = TREE.nodes[Index];
+        if constexpr (NODE.kind == detail::CompiledKind::NUMBER) {
+            return NODE.value;
+        } else if constexpr (NODE.kind == detail::CompiledKind::VARIABLE) {
+            return values[NODE.variable];
+        } else if constexpr (NODE.op == OpCode::POWER && detail::hasChainExponent(TREE.nodes[NODE.right])) {
+            constexpr double EXPONENT = TREE.nodes[NODE.right].value;
+            constexpr AdditionChain CHAIN = shortestAdditionChain(static_cast<int>(EXPONENT < 0 ? -EXPONENT : EXPONENT));
+            double base = node<NODE.left>(values);
+            if (strictPowerEnabled) return power(base, EXPONENT);
+            double result = chainPower(base, CHAIN);
+            return EXPONENT < 0 ? 1 / result : result;
+        } else {
+            using Kernel = OperatorKernel<NODE.op>;
+            double left = node<NODE.left>(values);
+            double right = node<NODE.right>(values);
+            if (Kernel::REJECTS_ZERO_DIVISOR && right == 0) {
+                throw std::runtime_error("Math Error: Division by zero");
+            }
+            return Kernel::apply(left, right);
+        }
+    }
+};
+
+// `calc::compile<"x * y + z">` is a callable computing x * y + z.
+template <FixedString Source>
+inline constexpr CompiledExpression<Source> compile{};
+
+}  // namespace calc
+
+#endif  // __cplusplus >= 202002L
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "operator_kernels.h"
+#include "tokenizer.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+// Compile-time evaluation of fixed formulas:
+//
+//     constexpr double area = calc::eval("2 * (3 + 4) ^ 2");  // 98, no runtime cost
+//
+// `calc::eval` tokenizes and runs the shunting-yard algorithm in one pass
+// over the string with fixed-size stacks, following the rules of
+// `tokenizer()` and `calculate()` (same precedence, associativity, number
+// syntax and error messages). In a constant expression every error is a
+// compile error pointing at the throw that reports it. It can also be called
+// at run time, where it throws std::runtime_error and never allocates.
+//
+// Differences from `calculate(tokenizer(...))`:
+//   - invalid characters are errors instead of being skipped with a warning;
+//   - a number must be exactly representable by one correctly rounded
+//     division (at most 2^53 as an integer, at most 22 significant fraction
+//     digits), which covers ordinary literals and gives the same double as
+//     std::stod;
+//   - `^` needs an integer exponent with magnitude up to 2^31. It is
+//     computed by squaring in long double and rounded once, so it may differ
+//     from std::pow in the last bit for results that are not exactly
+//     representable;
+//   - expressions may nest operands and operators at most
+//     CONSTANT_EVAL_CAPACITY deep.
+namespace calc {
+
+// Capacity of the operand and operator stacks used by `eval`.
+const size_t CONSTANT_EVAL_CAPACITY = 64;
+
+namespace detail {
+
+constexpr bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// The whitespace the scanner skips: ' ' and '\t' .. '\r'.
+constexpr bool isSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Parses a run of digits and '.' the way the tokenizer and std::stod do: a
+// leading '.' reads as "0." and anything after a second '.' is ignored.
+// Uses Clinger's fast path, an exact integer divided by an exact power of
+// ten, so the result is correctly rounded; other literals are rejected.
+constexpr double parseLiteral(std::string_view text) {
+    const uint64_t MAX_EXACT = uint64_t{1} << 53;
+    uint64_t mantissa = 0;
+    int fractionDigits = 0;
+    int pendingZeros = 0;  // Trailing fraction zeros, applied only if a digit follows.
+    bool seenDot = false;
+
+    for (char c : text) {
+        if (c == '.') {
+            if (seenDot) break;
+            seenDot = true;
+            continue;
+        }
+        if (seenDot && c == '0') {
+            ++pendingZeros;
+            continue;
+        }
+        for (int i = 0; i <= pendingZeros; ++i) {
+            if (mantissa > MAX_EXACT / 10) {
+                throw std::runtime_error("Constant Evaluation Error: Number has too many digits to evaluate exactly");
+            }
+            mantissa *= 10;
+        }
+        fractionDigits += seenDot ? pendingZeros + 1 : 0;
+        pendingZeros = 0;
+        mantissa += static_cast<uint64_t>(c - '0');
+        if (mantissa > MAX_EXACT) {
+            throw std::runtime_error("Constant Evaluation Error: Number has too many digits to evaluate exactly");
+        }
+    }
+
+    const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    if (fractionDigits > 22) {
+        throw std::runtime_error("Constant Evaluation Error: Number has too many digits to evaluate exactly");
+    }
+    return static_cast<double>(mantissa) / POWERS_OF_TEN[fractionDigits];
+}
+
+// Raises `base` to an integer `exponent` by binary exponentiation in long
+// double, rounding to double once at the end.
+constexpr double power(double base, double exponent) {
+    const double LIMIT = 2147483648.0;  // 2^31.
+    if (!(exponent >= -LIMIT && exponent <= LIMIT) ||
+        exponent != static_cast<double>(static_cast<int64_t>(exponent))) {
+        throw std::runtime_error("Constant Evaluation Error: Exponent must be an integer");
+    }
+    int64_t count = static_cast<int64_t>(exponent);
+    bool negative = count < 0;
+    if (negative) {
+        if (base == 0) {
+            throw std::runtime_error("Constant Evaluation Error: Zero raised to a negative power");
+        }
+        count = -count;
+    }
+
+    long double result = 1;
+    long double factor = base;
+    while (count != 0) {
+        if (count & 1) result *= factor;
+        factor *= factor;
+        count >>= 1;
+    }
+    return static_cast<double>(negative ? 1 / result : result);
+}
+
+// The message `applyOperation()` uses for an operator without operands.
+constexpr const char* insufficientOperandsMessage(char op) {
+    switch (op) {
+        case '+': return "Syntax Error: Insufficient operands for operator +";
+        case '-': return "Syntax Error: Insufficient operands for operator -";
+        case '*': return "Syntax Error: Insufficient operands for operator *";
+        case '/': return "Syntax Error: Insufficient operands for operator /";
+        default:  return "Syntax Error: Insufficient operands for operator ^";
+    }
+}
+
+// Fixed-capacity stack usable in constant expressions.
+template <typename T>
+struct ConstantStack {
+    std::array<T, CONSTANT_EVAL_CAPACITY> items{};
+    size_t size = 0;
+
+    constexpr void push(T value) {
+        if (size == CONSTANT_EVAL_CAPACITY) {
+            throw std::runtime_error("Constant Evaluation Error: Expression is nested too deeply");
+        }
+        items[size++] = value;
+    }
+
+    constexpr T pop() { return items[--size]; }
+    constexpr T& top() { return items[size - 1]; }
+    constexpr bool empty() const { return size == 0; }
+};
+
+// Applies `op` to two values, as `applyOperation()` does.
+constexpr double applyOperator(char op, double op1, double op2) {
+    switch (op) {
+        case '+': return OperatorKernel<OpCode::ADD>::apply(op1, op2);
+        case '-': return OperatorKernel<OpCode::SUBTRACT>::apply(op1, op2);
+        case '*': return OperatorKernel<OpCode::MULTIPLY>::apply(op1, op2);
+        case '/':
+            if (op2 == 0) {
+                throw std::runtime_error("Math Error: Division by zero");
+            }
+            return OperatorKernel<OpCode::DIVIDE>::apply(op1, op2);
+        default:  return power(op1, op2);
+    }
+}
+
+constexpr bool isIdentifierStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+constexpr bool isIdentifierChar(char c) {
+    return isIdentifierStart(c) || isDigit(c);
+}
+
+// Runs the shunting-yard algorithm over `expression` at compile time,
+// reporting operands and operators to `builder` in evaluation order:
+// `number(double)`, `identifier(std::string_view)` and `apply(char)`, which
+// always finds at least two operands. Identifiers are invalid characters
+// unless `Builder::ACCEPTS_IDENTIFIERS`. Checks the syntax like `calculate()`.
+template <typename Builder>
+constexpr void parseConstantExpression(std::string_view expression, Builder& builder) {
+    ConstantStack<char> operators;  // Operator characters and '('.
+    size_t operandCount = 0;
+    bool anyToken = false;
+
+    auto apply = [&](char op) {
+        if (operandCount < 2) {
+            throw std::runtime_error(insufficientOperandsMessage(op));
+        }
+        --operandCount;
+        builder.apply(op);
+    };
+
+    size_t i = 0;
+    while (i < expression.size()) {
+        char c = expression[i];
+        if (isSpace(c)) {
+            ++i;
+            continue;
+        }
+        anyToken = true;
+
+        if (isDigit(c) || c == '.' || (Builder::ACCEPTS_IDENTIFIERS && isIdentifierStart(c))) {
+            bool number = !isIdentifierStart(c);
+            size_t end = i;
+            while (end < expression.size() &&
+                   (number ? isDigit(expression[end]) || expression[end] == '.' : isIdentifierChar(expression[end]))) {
+                ++end;
+            }
+            if (number) {
+                builder.number(parseLiteral(expression.substr(i, end - i)));
+            } else if constexpr (Builder::ACCEPTS_IDENTIFIERS) {
+                builder.identifier(expression.substr(i, end - i));
+            }
+            ++operandCount;
+            i = end;
+            continue;
+        }
+
+        if (c == '(') {
+            operators.push(c);
+        } else if (c == ')') {
+            while (!operators.empty() && operators.top() != '(') apply(operators.pop());
+            if (operators.empty()) {
+                throw std::runtime_error("Syntax Error: Mismatched parentheses (missing '(').");
+            }
+            operators.pop();
+        } else if (isOperatorChar(c)) {
+            while (!operators.empty() && operators.top() != '(' &&
+                   (getPrecedence(operators.top()) > getPrecedence(c) ||
+                    (getPrecedence(operators.top()) == getPrecedence(c) && isBinaryOperatorLeftAssociative(c)))) {
+                apply(operators.pop());
+            }
+            operators.push(c);
+        } else {
+            throw std::runtime_error("Syntax Error: Invalid character in expression");
+        }
+        ++i;
+    }
+
+    if (!anyToken) {
+        throw std::runtime_error("Evaluation Error: Empty expression");
+    }
+
+    while (!operators.empty()) {
+        if (operators.top() == '(') {
+            throw std::runtime_error("Syntax Error: Mismatched parentheses at end of expression.");
+        }
+        apply(operators.pop());
+    }
+
+    if (operandCount != 1) {
+        throw std::runtime_error("Evaluation Error: Operand stack malformed at end of calculation.");
+    }
+}
+
+// Builder for `eval`: computes values as the parser reports them.
+struct ValueBuilder {
+    static constexpr bool ACCEPTS_IDENTIFIERS = false;
+    ConstantStack<double> operands;
+
+    constexpr void number(double value) { operands.push(value); }
+
+    constexpr void apply(char op) {
+        double op2 = operands.pop();
+        double op1 = operands.pop();
+        operands.push(applyOperator(op, op1, op2));
+    }
+};
+
+}  // namespace detail
+
+// Evaluates `expression` with the rules of `calculate(tokenizer(expression))`.
+// Usable in constant expressions; see the notes at the top of this file.
+constexpr double eval(std::string_view expression) {
+    detail::ValueBuilder builder;
+    detail::parseConstantExpression(expression, builder);
+    return builder.operands.top();
+}
+
+}  // namespace calc
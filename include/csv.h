@@ -0,0 +1,57 @@
+#pragma once
+
+#include "environment.h"
+#include "number_stream.h"
+#include "program.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Bytes `mapCsv` reads and evaluates as one chunk, and the longest row it
+// accepts. Memory use is a few times this (the chunk, its row offsets and
+// its output), however large the input.
+const size_t CSV_CHUNK_BYTES = 4 << 20;
+
+// How `mapCsv` reads, evaluates and writes.
+struct CsvOptions {
+    char delimiter = ',';
+    std::string resultName = "result";    // Header of the appended column.
+    unsigned threads = 1;                 // Workers sharing each chunk's rows.
+    size_t chunkBytes = CSV_CHUNK_BYTES;
+};
+
+// Splits one line of delimited text into its fields. Quoted fields lose
+// their quotes, and a doubled quote inside them reads as one.
+std::vector<std::string> splitCsvLine(std::string_view line, char delimiter);
+
+// Returns the column names of a header line: its fields without the spaces
+// or quotes around them, trimmed the way `mapCsv` trims data fields. Bind
+// variables by these names so field i of a row feeds name i.
+std::vector<std::string> csvColumnNames(std::string_view header, char delimiter);
+
+// Evaluates `program` once per data row of delimited text read from `in`,
+// whose header line the caller has already read into `header`. Field i of
+// a row is bound to variable slot `fieldSlots[i]` (SymbolTable::NO_SLOT
+// for fields the program does not read); other slots keep their values in
+// `environment`. Each row is written to `out` unchanged with the result
+// appended as a last field, after the header with `options.resultName`
+// appended. Empty lines are skipped.
+//
+// The input is read a chunk at a time. One SIMD pass (classifyCsvBlock)
+// finds the rows of a chunk, honoring quoted fields that contain
+// delimiters or line breaks. A quote opens a quoted field only as its first
+// byte; elsewhere it is an ordinary byte. The rows are then shared among
+// `options.threads` workers. Each worker parses the fields the program
+// reads with parseNumber, evaluates MAP_BLOCK_NUMBERS rows at a time with
+// `evaluateColumns`, and formats its rows; the main thread writes the
+// parts in order. A field that is missing or not a number reads as NaN,
+// and a row whose evaluation fails (e.g. by division by zero) gets "nan".
+// Returns those problems, indexed by data row. Throws a runtime error for
+// a row of `options.chunkBytes` or more, such as one with an unclosed quote.
+StreamErrors mapCsv(const PostfixProgram& program, const Environment& environment,
+                    const std::vector<uint32_t>& fieldSlots, std::string_view header, std::istream& in,
+                    std::ostream& out, const CsvOptions& options);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Returns true if `name` is an identifier as the scanner reads them: a
+// letter or '_', then letters, digits and '_'.
+bool isIdentifier(std::string_view name);
+
+// Maps a fixed set of variable names to dense slots 0 .. size()-1 (in the
+// order the names were given) with a perfect hash: one string hash picks a
+// bucket, the bucket's displacement picks the table entry, and a single
+// comparison confirms the name. Built once; parsers look names up so
+// evaluation only ever indexes slots.
+class SymbolTable {
+public:
+    // Returned by `find` for names not in the table.
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    SymbolTable() = default;
+
+    // Builds the table. Throws a runtime error for a duplicate name or one
+    // that is not an identifier (a letter or '_', then letters, digits, '_').
+    explicit SymbolTable(std::vector<std::string> names);
+
+    // Returns the slot of `name`, or NO_SLOT.
+    uint32_t find(std::string_view name) const;
+
+    // Returns the name bound to `slot`.
+    const std::string& name(uint32_t slot) const { return names_[slot]; }
+
+    // Returns the number of names.
+    size_t size() const { return names_.size(); }
+
+private:
+    std::vector<std::string> names_;       // Indexed by slot.
+    std::vector<uint32_t> displacements_;  // Indexed by bucket.
+    std::vector<uint32_t> entries_;        // Slots (or NO_SLOT), power-of-two size.
+};
+
+// Variable values for expressions with named variables: a symbol table
+// plus one value per slot, all zero initially. Parse an expression against
+// `symbols()` once, then set values by slot and evaluate as often as needed.
+class Environment {
+public:
+    Environment() = default;
+
+    // Creates an environment with the given variables, all set to zero.
+    // Throws like the SymbolTable constructor.
+    explicit Environment(std::vector<std::string> names);
+
+    // Returns the table that resolves names to slots.
+    const SymbolTable& symbols() const { return symbols_; }
+
+    // Returns the slot of `name`. Throws a runtime error if it is unknown.
+    uint32_t slot(std::string_view name) const;
+
+    // Sets a variable by name (a hash lookup; prefer slots in loops).
+    void set(std::string_view name, double value) { values_[slot(name)] = value; }
+
+    // Accesses a variable by slot.
+    double& operator[](uint32_t slot) { return values_[slot]; }
+    double operator[](uint32_t slot) const { return values_[slot]; }
+
+    // Returns the values indexed by slot, as the evaluators take them.
+    const double* values() const { return values_.data(); }
+
+    // Returns the number of variables.
+    size_t size() const { return values_.size(); }
+
+private:
+    SymbolTable symbols_;
+    std::vector<double> values_;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Reasons an expression can fail to evaluate, reported by the non-throwing
+// `tryCalculate` API instead of a std::runtime_error.
+enum class EvalError : uint8_t {
+    NONE,                   // Success.
+    EMPTY_EXPRESSION,       // No tokens at all.
+    INVALID_CHARACTER,      // A byte that is not part of the grammar.
+    INSUFFICIENT_OPERANDS,  // An operator without two operands.
+    UNKNOWN_OPERATOR,       // An operator code the evaluator does not know.
+    MISSING_LEFT_PAREN,     // A ')' without a matching '('.
+    MISSING_RIGHT_PAREN,    // A '(' that is never closed.
+    MALFORMED_EXPRESSION,   // Operands left over (e.g., "2 3").
+    DIVISION_BY_ZERO,       // Division by zero.
+    UNKNOWN_VARIABLE,       // An identifier with no value bound to it.
+    UNKNOWN_FUNCTION,       // A call to a name that is not a function.
+    UNEXPECTED_COMMA,       // A ',' outside a function call.
+    EMPTY_ARGUMENT,         // A function argument with nothing in it.
+    WRONG_ARGUMENT_COUNT,   // A call with more or fewer arguments than the function takes.
+    OUT_OF_MEMORY,          // A buffer could not grow.
+};
+
+// Returns the name of an error code (e.g., "DIVISION_BY_ZERO").
+const char* evalErrorToString(EvalError error);
+
+// The outcome of a non-throwing evaluation: either a value or an error code
+// plus the source offset of the token that caused it. The human-readable
+// message is only built when `message()` is called.
+struct EvalResult {
+    double value = 0;                   // The result when `ok()`.
+    EvalError error = EvalError::NONE;  // Why evaluation failed.
+    uint32_t offset = 0;                // Byte offset of the offending token.
+    char symbol = 0;                    // Offending operator or character, if known.
+
+    // Returns true if evaluation succeeded.
+    bool ok() const noexcept { return error == EvalError::NONE; }
+
+    // Builds the message the throwing API would have used
+    // (e.g., "Math Error: Division by zero").
+    std::string message() const;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Built-in math functions, called as `name(arguments)`: an identifier
+// directly followed by '(' (whitespace allowed) is a call. Names are
+// resolved to a FunctionId when an expression is parsed, so evaluators only
+// index FUNCTIONS. Every function takes one or two arguments and follows the
+// C library: an argument outside the domain gives NaN or an infinity, never
+// an error.
+//
+//   one argument:   sqrt cbrt exp exp2 log log2 log10 sin cos tan asin acos
+//                   atan sinh cosh tanh abs floor ceil trunc round
+//   two arguments:  min max pow atan2 hypot fmod
+//
+// `min` and `max` ignore a NaN argument, like std::fmin and std::fmax.
+enum class FunctionId : uint8_t {
+    SQRT, CBRT, EXP, EXP2, LOG, LOG2, LOG10,
+    SIN, COS, TAN, ASIN, ACOS, ATAN, SINH, COSH, TANH,
+    ABS, FLOOR, CEIL, TRUNC, ROUND,
+    MIN, MAX, POW, ATAN2, HYPOT, FMOD,
+    COUNT,
+};
+
+// Number of built-in functions.
+const size_t FUNCTION_COUNT = static_cast<size_t>(FunctionId::COUNT);
+
+// Returned by `findFunction` for names that are not functions.
+const uint32_t NO_FUNCTION = UINT32_MAX;
+
+using UnaryFunction = double (*)(double);
+using BinaryFunction = double (*)(double, double);
+using UnaryBatch = void (*)(const double* in, double* out, size_t count);
+using BinaryBatch = void (*)(const double* left, const double* right, double* out, size_t count);
+
+// One entry of the function table. A function has either the unary or the
+// binary pair of implementations, matching its arity.
+//
+// The batch implementations compute `count` results at once. The exact
+// functions (sqrt, abs, floor, ceil, trunc, round, min, max) use AVX
+// instructions and return exactly the scalar results. exp, log, sin, cos and
+// tan use AVX2/FMA polynomial kernels, within `batchUlps` units in the last
+// place of the scalar (C library) result; their scalar fallback handles
+// arguments the kernels do not cover (see functions.cpp). The remaining
+// functions call the scalar implementation per element. Without AVX2 and
+// FMA every batch is a scalar loop.
+struct FunctionInfo {
+    const char* name;
+    uint8_t arity;            // 1 or 2.
+    UnaryFunction unary;      // Scalar implementation, arity 1.
+    BinaryFunction binary;    // Scalar implementation, arity 2.
+    UnaryBatch unaryBatch;    // Batch implementation, arity 1.
+    BinaryBatch binaryBatch;  // Batch implementation, arity 2.
+    double batchUlps;         // Bound on |batch - scalar| in ulps of the scalar result.
+};
+
+// The function table, indexed by FunctionId: the C library functions.
+extern const FunctionInfo FUNCTIONS[FUNCTION_COUNT];
+
+// Accuracy levels for the math functions and the '^' operator. FULL is
+// the C library (the default). The fast levels replace exp, exp2, log,
+// log2, log10, sin, cos, tan and pow, '^' included, with table-driven
+// polynomial approximations whose relative error against the C library
+// stays below 1e-12 or 1e-7. Arguments the approximations do not cover
+// (non-finite, subnormal, overflowing, or trigonometric arguments beyond
+// 2^14) still go to the C library, so special values are unchanged.
+enum class MathAccuracy : uint8_t {
+    FULL,
+    RELATIVE_1E12,
+    RELATIVE_1E7,
+};
+
+// Returns the bound on the relative error of `accuracy` (0 for FULL).
+double mathAccuracyBound(MathAccuracy accuracy);
+
+// Returns the fastest level whose bound is at most `tolerance`. Throws a
+// runtime error if `tolerance` is below 1e-12.
+MathAccuracy mathAccuracyFor(double tolerance);
+
+// Returns the function table of `accuracy`, indexed by FunctionId. The
+// batch implementations of the fast tables stay within `batchUlps` of
+// their scalar ones.
+const FunctionInfo* functionTable(MathAccuracy accuracy);
+
+// Selects the table every evaluator uses from now on. The setting is
+// process-wide and not synchronized: set it at startup, before any
+// evaluation starts.
+void setMathAccuracy(MathAccuracy accuracy);
+
+// Returns the level selected by setMathAccuracy.
+MathAccuracy mathAccuracy();
+
+// The table `functionInfo` reads; use setMathAccuracy to change it.
+extern const FunctionInfo* activeFunctionTable;
+
+// Returns the entry for `id` in the selected function table.
+inline const FunctionInfo& functionInfo(uint32_t id) {
+    return activeFunctionTable[id];
+}
+
+// Returns the id of the function called `name`, or NO_FUNCTION.
+uint32_t findFunction(std::string_view name);
+
+// Returns the name of the batch implementation selected for this CPU
+// ("avx2" or "scalar").
+const char* functionBatchImplementationName();
+
+// The message the throwing parsers use when a call to function `id` has
+// `given` arguments (e.g., "Syntax Error: max expects 2 arguments, got 1").
+std::string argumentCountMessage(uint32_t id, size_t given);
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// An HDR-style latency histogram with log-linear buckets: values below
+// 2^SUB_BUCKET_BITS are counted exactly, and every power of two above that
+// is split into 2^SUB_BUCKET_BITS linear sub-buckets, so any recorded value
+// is reproduced within 1/32 (about 3%) relative error across the full
+// 64-bit range.
+//
+// Recording is a bit scan, a shift and a relaxed atomic increment. Each
+// histogram is meant to have a single writing thread; readers may merge or
+// query it concurrently and see a slightly stale but consistent-enough view.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKETS = uint64_t{1} << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    LatencyHistogram() = default;
+    LatencyHistogram(const LatencyHistogram& other) { merge(other); }
+    LatencyHistogram& operator=(const LatencyHistogram& other);
+
+    // Records one value (typically nanoseconds). Must only be called by the
+    // histogram's owning thread.
+    void record(uint64_t value) noexcept {
+        size_t index = bucketIndex(value);
+        counts_[index].store(counts_[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    // Adds every count from `other` into this histogram.
+    void merge(const LatencyHistogram& other);
+
+    // Clears all counts.
+    void reset();
+
+    // Returns the number of recorded values.
+    uint64_t count() const;
+
+    // Returns the largest recorded value (exact).
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    // Returns the value at `percentile` (0-100), reported as the upper end of
+    // the bucket that contains it (capped at `max()`). Returns 0 if empty.
+    uint64_t percentile(double percentile) const;
+
+    // Writes "count=... p50=... p90=... p99=... p99.9=... max=..." in `unit`.
+    void printPercentiles(std::ostream& os, const char* unit = "ns") const;
+
+    // Maps a value to its bucket.
+    static size_t bucketIndex(uint64_t value) {
+        if (value < SUB_BUCKETS) return static_cast<size_t>(value);
+        int exponent = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS + 1;
+        uint64_t subBucket = (value >> (exponent - 1)) - SUB_BUCKETS;
+        return static_cast<size_t>(exponent * SUB_BUCKETS + subBucket);
+    }
+
+    // Returns the smallest value that maps to bucket `index`.
+    static uint64_t bucketLowerBound(size_t index);
+
+    // Returns the largest value that maps to bucket `index`.
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+    std::atomic<uint64_t> max_{0};
+};
+
+// A set of per-thread LatencyHistograms. Each thread records into its own
+// histogram without contention (registration takes a lock once per thread);
+// `merged()` sums them on demand, e.g. for a periodic report.
+class ThreadLatencyHistograms {
+public:
+    ThreadLatencyHistograms();
+
+    // Returns the calling thread's histogram, creating it on first use.
+    LatencyHistogram& local();
+
+    // Returns the sum of every thread's histogram.
+    LatencyHistogram merged() const;
+
+private:
+    uint64_t id_;  // Unique per set, so thread caches never confuse two sets.
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<LatencyHistogram>> histograms_;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "environment.h"
+#include "number_stream.h"
+#include "program.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Rows `evaluateNpy` converts and evaluates as one block.
+const size_t NPY_BLOCK_ROWS = 4096;
+
+// Element types of the .npy arrays the calculator reads.
+enum class NpyType : uint8_t { FLOAT64, FLOAT32, INT64 };
+
+// What a .npy header says about the array after it.
+struct NpyHeader {
+    NpyType type = NpyType::FLOAT64;
+    size_t count = 0;       // Elements: the product of the shape.
+    size_t dataOffset = 0;  // Bytes from the start of the file to the data.
+};
+
+// Parses the header at the start of a .npy file of `size` bytes: the magic
+// "\x93NUMPY", a version (1.0, 2.0 or 3.0), the header length and a Python
+// dict literal with 'descr', 'fortran_order' and 'shape'. Accepts
+// little-endian float64, float32 and int64 ('<f8', '<f4', '<i8') of any
+// shape with at most one dimension above 1, so that the array is one
+// column in either order. Throws a runtime error naming `path` otherwise,
+// or if the file is shorter than its data.
+NpyHeader parseNpyHeader(const char* data, size_t size, const std::string& path);
+
+// A .npy file opened read-only as one column of numbers. On POSIX systems
+// the file is mapped into memory, so opening it reads nothing and float64
+// data is used in place; elsewhere it is read into memory.
+class NpyArray {
+public:
+    // Opens and maps `path`. Throws a runtime error if it cannot be read or
+    // is not an array parseNpyHeader accepts.
+    explicit NpyArray(const std::string& path);
+    ~NpyArray();
+
+    NpyArray(const NpyArray&) = delete;
+    NpyArray& operator=(const NpyArray&) = delete;
+
+    // Returns the element type.
+    NpyType type() const { return header_.type; }
+
+    // Returns the number of elements.
+    size_t size() const { return header_.count; }
+
+    // Returns the elements if they are float64 and aligned for direct
+    // use, or nullptr.
+    const double* float64() const;
+
+    // Converts elements [begin, begin + count) to double into `out`.
+    // int64 values beyond 2^53 round to the nearest double.
+    void read(size_t begin, size_t count, double* out) const;
+
+private:
+    void* map_ = nullptr;     // The mapping, or nullptr if the file was read.
+    size_t mapBytes_ = 0;
+    std::vector<char> copy_;  // The file contents where it is not mapped.
+    const char* file_ = nullptr;
+    NpyHeader header_;
+};
+
+// A float64 .npy file of one dimension, created with its final size so
+// results can be written straight into it. The data goes to a temporary
+// file in the same directory, which `finish` renames over the target, so
+// the target can also be one of the inputs. On POSIX systems the temporary
+// file is mapped into memory; elsewhere the data is buffered and written by
+// `finish`.
+class NpyWriter {
+public:
+    // Prepares `path` for `count` elements. Throws a runtime error if the
+    // temporary file cannot be created.
+    NpyWriter(const std::string& path, size_t count);
+    ~NpyWriter();
+
+    NpyWriter(const NpyWriter&) = delete;
+    NpyWriter& operator=(const NpyWriter&) = delete;
+
+    // Returns the `count` elements to fill in.
+    double* data() { return data_; }
+
+    // Completes the file and replaces `path` with it. Throws a runtime
+    // error if writing fails. Without this, destruction discards the data.
+    void finish();
+
+private:
+    std::string path_;
+    std::string tempPath_;  // Where the data is written until `finish`.
+    void* map_ = nullptr;
+    size_t mapBytes_ = 0;
+    std::vector<char> buffer_;  // Header and data where the file is not mapped.
+    double* data_ = nullptr;
+    bool finished_ = false;
+};
+
+// Returns the header of a version 1.0 .npy file holding `count` float64
+// elements, padded so the data starts at a multiple of 64 bytes.
+std::string npyFloat64Header(size_t count);
+
+// Evaluates `program` for each of `count` rows, binding slot s of row r to
+// element r of `arrays[s]` or, where `arrays[s]` is null, to
+// `environment[s]`, and writes result r to `out[r]`. Every array must have
+// `count` elements. Float64 arrays are read in place, others are converted
+// NPY_BLOCK_ROWS at a time, and each block is evaluated with
+// `evaluateColumns`. A block that fails is redone row by row, and rows
+// that fail (e.g. by division by zero) get NaN. Returns those failures.
+StreamErrors evaluateNpy(const PostfixProgram& program, const Environment& environment,
+                         const std::vector<const NpyArray*>& arrays, size_t count, double* out);
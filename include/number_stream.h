@@ -0,0 +1,112 @@
+#pragma once
+
+#include "environment.h"
+#include "program.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Bytes `NumberReader` reads from its stream at a time.
+const size_t NUMBER_CHUNK_BYTES = 1 << 20;
+
+// Numbers `mapNumbers` parses, evaluates and writes as one block.
+const size_t MAP_BLOCK_NUMBERS = 4096;
+
+// The first of a run of problems (malformed numbers, failed evaluations)
+// and how many there were, so a stream of millions of numbers reports one
+// line instead of one per problem.
+struct StreamErrors {
+    uint64_t count = 0;
+    uint64_t firstIndex = 0;  // Zero-based position of the first problem in the stream.
+    std::string first;        // Its message.
+
+    // Counts one problem at `index`, keeping the message if no earlier
+    // index has been recorded.
+    void record(uint64_t index, const std::string& message);
+
+    // Adds the problems of another part of the stream.
+    void merge(const StreamErrors& other);
+};
+
+// Parses all of [first, last) as one number: what std::from_chars accepts
+// in general format ("12", "-0.5", "1e-3", "inf", "nan") plus a leading
+// '+'. Out-of-range values become infinities or zeros, as std::strtod
+// gives. Returns false if the text is not a number.
+bool parseNumber(const char* first, const char* last, double& value);
+
+// Reads whitespace-separated numbers (one per line, or several per line)
+// from a stream in large chunks and parses them with std::from_chars, so
+// no per-number allocation or locale lookup happens. Accepts what
+// from_chars accepts in general format ("12", "-0.5", "1e-3", "inf",
+// "nan") plus a leading '+'. A field that is not a number reads as NaN
+// and is recorded in `errors()`.
+class NumberReader {
+public:
+    explicit NumberReader(std::istream& in, size_t chunkBytes = NUMBER_CHUNK_BYTES);
+
+    // Parses up to `capacity` numbers into `out` and returns how many were
+    // read; 0 only at the end of the input.
+    size_t read(double* out, size_t capacity);
+
+    // Numbers read so far, malformed ones included.
+    uint64_t count() const { return count_; }
+
+    // The malformed fields.
+    const StreamErrors& errors() const { return errors_; }
+
+private:
+    // Moves the unparsed bytes to the front of the buffer and reads more,
+    // growing the buffer if one field fills it. Returns false at the end
+    // of the input.
+    bool refill();
+
+    std::istream& in_;
+    std::vector<char> buffer_;
+    size_t begin_ = 0;  // Next unparsed byte.
+    size_t end_ = 0;    // One past the last byte read.
+    bool eof_ = false;
+    uint64_t count_ = 0;
+    StreamErrors errors_;
+};
+
+// Writes numbers one per line in their shortest round-trip form
+// (std::to_chars), through a buffer flushed to the stream when full.
+class NumberWriter {
+public:
+    explicit NumberWriter(std::ostream& out, size_t bufferBytes = NUMBER_CHUNK_BYTES);
+    ~NumberWriter() { flush(); }
+
+    NumberWriter(const NumberWriter&) = delete;
+    NumberWriter& operator=(const NumberWriter&) = delete;
+
+    // Appends `count` values, one per line.
+    void write(const double* values, size_t count);
+
+    // Writes the buffered text to the stream.
+    void flush();
+
+private:
+    std::ostream& out_;
+    std::vector<char> buffer_;
+    size_t size_ = 0;
+};
+
+// Evaluates `program` once per number read from `reader`, binding the
+// number to variable slot `inputSlot` and every other slot to its value in
+// `environment`, and passes the results to `consume` in order, a block at
+// a time. Numbers are evaluated MAP_BLOCK_NUMBERS at a time with
+// `evaluateColumns`; a block that fails is redone row by row, and rows
+// that fail (e.g. by division by zero) give NaN so results stay aligned
+// with the input. Returns the problems with evaluation; malformed input
+// numbers are in `reader.errors()`.
+StreamErrors mapBlocks(const PostfixProgram& program, const Environment& environment, uint32_t inputSlot,
+                       NumberReader& reader, const std::function<void(const double*, size_t)>& consume);
+
+// `mapBlocks` writing one result per line to `writer` ("nan" for rows that
+// fail).
+StreamErrors mapNumbers(const PostfixProgram& program, const Environment& environment, uint32_t inputSlot,
+                        NumberReader& reader, NumberWriter& writer);
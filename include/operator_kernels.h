@@ -0,0 +1,122 @@
+#pragma once
+
+#include "power.h"
+#include "token_buffer.h"
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+// Binary operators as compile-time tags. Each operator is a specialization
+// of OperatorKernel with a static `apply`; code that knows the operator at
+// compile time calls it directly so the compiler can inline (and, in loops,
+// vectorize) it. `apply` never checks the divisor: evaluators that must
+// report division by zero test `REJECTS_ZERO_DIVISOR` and the right operand
+// first, which compiles away for every other operator.
+template <OpCode Op>
+struct OperatorKernel;  // Not defined for OpCode::NONE.
+
+template <>
+struct OperatorKernel<OpCode::ADD> {
+    static constexpr char SYMBOL = '+';
+    static constexpr bool REJECTS_ZERO_DIVISOR = false;
+    static constexpr double apply(double a, double b) { return a + b; }
+};
+
+template <>
+struct OperatorKernel<OpCode::SUBTRACT> {
+    static constexpr char SYMBOL = '-';
+    static constexpr bool REJECTS_ZERO_DIVISOR = false;
+    static constexpr double apply(double a, double b) { return a - b; }
+};
+
+template <>
+struct OperatorKernel<OpCode::MULTIPLY> {
+    static constexpr char SYMBOL = '*';
+    static constexpr bool REJECTS_ZERO_DIVISOR = false;
+    static constexpr double apply(double a, double b) { return a * b; }
+};
+
+template <>
+struct OperatorKernel<OpCode::DIVIDE> {
+    static constexpr char SYMBOL = '/';
+    static constexpr bool REJECTS_ZERO_DIVISOR = true;
+    static constexpr double apply(double a, double b) { return a / b; }
+};
+
+// '^' multiplies for small integer exponents and otherwise calls the
+// selected function table's pow (see power.h).
+template <>
+struct OperatorKernel<OpCode::POWER> {
+    static constexpr char SYMBOL = '^';
+    static constexpr bool REJECTS_ZERO_DIVISOR = false;
+    static double apply(double a, double b) { return power(a, b); }
+};
+
+// Number of OpCode values, OpCode::NONE included.
+const size_t OPCODE_COUNT = static_cast<size_t>(OpCode::POWER) + 1;
+
+// Applies one kernel element-wise over arrays: out[i] = left[i] op right[i].
+// The kernel is a template argument, so the loop body has no dispatch and
+// vectorizes for the arithmetic operators. Does not check divisors.
+template <OpCode Op>
+void applyKernelToArrays(const double* __restrict left, const double* __restrict right,
+                         double* __restrict out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = OperatorKernel<Op>::apply(left[i], right[i]);
+    }
+}
+
+// Run-time view of one kernel, for code that only learns the operator while
+// evaluating. The function pointers are null for OpCode::NONE.
+struct KernelEntry {
+    double (*apply)(double, double);                                     // One operation.
+    void (*applyToArrays)(const double*, const double*, double*, size_t);  // A whole column.
+    bool rejectsZeroDivisor;
+    char symbol;
+};
+
+namespace detail {
+
+template <size_t Index>
+constexpr KernelEntry kernelEntry() {
+    if constexpr (Index == 0) {
+        return KernelEntry{nullptr, nullptr, false, '?'};
+    } else {
+        constexpr OpCode OP = static_cast<OpCode>(Index);
+        using Kernel = OperatorKernel<OP>;
+        return KernelEntry{&Kernel::apply, &applyKernelToArrays<OP>, Kernel::REJECTS_ZERO_DIVISOR, Kernel::SYMBOL};
+    }
+}
+
+template <size_t... Indexes>
+constexpr std::array<KernelEntry, sizeof...(Indexes)> makeKernelTable(std::index_sequence<Indexes...>) {
+    return {{kernelEntry<Indexes>()...}};
+}
+
+}  // namespace detail
+
+// Kernel table indexed by OpCode, built at compile time from the
+// OperatorKernel specializations. It is for dispatching once per array,
+// where the call is amortized over the whole column: an indirect call per
+// operation costs more than the evaluators' chains on the operator (see the
+// `kernels` benchmark).
+inline constexpr std::array<KernelEntry, OPCODE_COUNT> OPERATOR_KERNELS =
+    detail::makeKernelTable(std::make_index_sequence<OPCODE_COUNT>{});
+
+// Calls `visitor(OperatorKernel<Op>{})` for the run-time operator `op`, so a
+// generic lambda is instantiated once per operator with its kernel inlined;
+// calls `unknown()` for OpCode::NONE. Both must return the same type. The
+// jump table this compiles to still measures slower per operation than the
+// character chain in `calculate()`, which therefore keeps it.
+template <typename Visitor, typename Unknown>
+decltype(auto) visitOperator(OpCode op, Visitor&& visitor, Unknown&& unknown) {
+    switch (op) {
+        case OpCode::ADD:      return visitor(OperatorKernel<OpCode::ADD>{});
+        case OpCode::SUBTRACT: return visitor(OperatorKernel<OpCode::SUBTRACT>{});
+        case OpCode::MULTIPLY: return visitor(OperatorKernel<OpCode::MULTIPLY>{});
+        case OpCode::DIVIDE:   return visitor(OperatorKernel<OpCode::DIVIDE>{});
+        case OpCode::POWER:    return visitor(OperatorKernel<OpCode::POWER>{});
+        default:               return unknown();
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Hardware events counted by PerfCounters.
+enum class PerfEvent : uint8_t {
+    CYCLES,
+    INSTRUCTIONS,
+    BRANCHES,
+    BRANCH_MISSES,
+    L1D_MISSES,   // L1 data cache read misses.
+    LLC_MISSES,   // Last-level cache misses.
+    COUNT         // Number of events (not an event).
+};
+
+// Returns the display name of an event (e.g., "branch-misses").
+const char* perfEventName(PerfEvent event);
+
+// Counter values for one measured region. Events the CPU or kernel could not
+// count are marked missing and read as zero. The values are raw counts; when
+// the PMU is shared (multiplexed) the group only counts while it is
+// scheduled, so `timeRunning` falls below `timeEnabled`, and when it is never
+// scheduled (common in VMs) `timeRunning` stays zero.
+struct PerfSample {
+    std::array<uint64_t, static_cast<size_t>(PerfEvent::COUNT)> values{};
+    std::array<bool, static_cast<size_t>(PerfEvent::COUNT)> present{};
+    uint64_t timeEnabled = 0;  // Nanoseconds the group was enabled.
+    uint64_t timeRunning = 0;  // Nanoseconds it was actually counting.
+
+    // Returns true if the group counted for any of the region.
+    bool counted() const { return timeRunning > 0; }
+
+    // Returns true if the group counted for only part of the region.
+    bool multiplexed() const { return timeRunning > 0 && timeRunning < timeEnabled; }
+
+    // Returns the count of `event` scaled from the running to the enabled
+    // time (the estimate perf(1) prints for multiplexed counters), or 0 if
+    // the group never counted.
+    uint64_t estimate(PerfEvent event) const;
+
+    uint64_t operator[](PerfEvent event) const { return values[static_cast<size_t>(event)]; }
+    bool has(PerfEvent event) const { return present[static_cast<size_t>(event)]; }
+
+    // Instructions per cycle, or 0 if either counter is missing.
+    double ipc() const;
+
+    // Branch misses as a fraction of branches, or 0 if either is missing.
+    double branchMissRate() const;
+
+    // Adds another sample's counts (e.g., to aggregate over expressions).
+    PerfSample& operator+=(const PerfSample& other);
+};
+
+// Returns `end - start` for every event present in both samples.
+PerfSample operator-(const PerfSample& end, const PerfSample& start);
+
+// Writes a one-line summary: counts, IPC and branch-miss rate. Counts of a
+// multiplexed sample are scaled estimates and marked as such; a sample that
+// was never counted prints "not counted" instead of zeros.
+std::ostream& operator<<(std::ostream& os, const PerfSample& sample);
+
+// A group of hardware counters for the calling thread, opened with
+// perf_event_open(2) and counting user-space events only. Counting starts on
+// construction; take `read()` snapshots around a region and subtract them.
+//
+// Degrades gracefully: if perf events are unsupported (non-Linux, missing
+// PMU in a VM, or a restrictive perf_event_paranoid), `available()` is false,
+// `unavailableReason()` says why, and `read()` returns an empty sample.
+// Individual events the CPU lacks (often the cache events) are just missing.
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Returns true if at least the cycle counter could be opened.
+    bool available() const { return leaderFd_ >= 0; }
+
+    // Returns why the counters are unavailable (empty if they are available).
+    const std::string& unavailableReason() const { return unavailableReason_; }
+
+    // Reads the current cumulative counts with a single system call.
+    PerfSample read() const;
+
+private:
+    int leaderFd_ = -1;
+    std::array<int, static_cast<size_t>(PerfEvent::COUNT)> fds_;
+    std::string unavailableReason_;
+};
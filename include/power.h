@@ -0,0 +1,138 @@
+#pragma once
+
+#include "functions.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// The '^' operator. An integer exponent n with |n| <= MAX_INTEGER_EXPONENT
+// is computed by multiplication instead of pow:
+//   - constant exponents (fused postfix programs, register programs,
+//     calc::compile) by a shortest addition chain, e.g. x^15 as
+//     x2 = x*x, x4 = x2*x2, x5 = x4*x, x10 = x5*x5, x15 = x10*x5;
+//   - exponents only known while evaluating by binary exponentiation.
+// Negative exponents divide 1 by the positive power and n = 0 gives 1, as
+// pow does for every base. Other exponents call pow from the selected
+// function table (functions.h).
+//
+// Every rounding of the multiplications adds to the error, so the result
+// is within about |n| units in the last place of the exact power where
+// std::pow is within one, and the two methods may differ from each other
+// in the last bits. Negative exponents can also overflow to 0 or infinity
+// where pow still returns a subnormal. `setStrictPower(true)` sends every
+// '^' to pow.
+const int MAX_INTEGER_EXPONENT = 64;
+
+// Longest shortest addition chain of an exponent up to MAX_INTEGER_EXPONENT.
+const size_t MAX_CHAIN_LENGTH = 8;
+
+// A star addition chain: a sequence of multiplications computing x^n from
+// x where value 0 is x and step i computes value i + 1 as value i times an
+// earlier value. Star chains are as short as general addition chains for
+// every exponent below 12509, and keep the running product in a register.
+struct AdditionChain {
+    uint8_t length = 0;                      // Multiplications; x^n is value `length`.
+    uint8_t factors[MAX_CHAIN_LENGTH] = {};  // Index of the second factor of each step.
+};
+
+namespace detail {
+
+// Depth-first search for a star chain of `values` (value[0] = 1) ending in
+// `target` with at most `limit` steps. Larger factors are tried first,
+// which finds doubling-heavy chains quickly.
+constexpr bool extendChain(int* values, AdditionChain& chain, int limit, int target) {
+    const int length = chain.length;
+    const int last = values[length];
+    if (last == target) return true;
+    if (length == limit || (last << (limit - length)) < target) return false;
+
+    for (int j = length; j >= 0; --j) {
+        const int next = last + values[j];
+        if (next > target) continue;
+        values[length + 1] = next;
+        chain.factors[length] = static_cast<uint8_t>(j);
+        chain.length = static_cast<uint8_t>(length + 1);
+        if (extendChain(values, chain, limit, target)) return true;
+        chain.length = static_cast<uint8_t>(length);
+    }
+    return false;
+}
+
+}  // namespace detail
+
+// Returns a shortest star chain for 1 <= n <= MAX_INTEGER_EXPONENT by
+// iterative deepening.
+constexpr AdditionChain shortestAdditionChain(int n) {
+    for (int limit = 0;; ++limit) {
+        AdditionChain chain;
+        int values[MAX_CHAIN_LENGTH + 1] = {1};
+        if (detail::extendChain(values, chain, limit, n)) return chain;
+    }
+}
+
+// The chain of every exponent up to MAX_INTEGER_EXPONENT, indexed by the
+// exponent (entry 0 is unused). Built at compile time.
+extern const std::array<AdditionChain, MAX_INTEGER_EXPONENT + 1> ADDITION_CHAINS;
+
+// Returns the chain of 1 <= n <= MAX_INTEGER_EXPONENT.
+inline const AdditionChain& additionChain(int n) {
+    return ADDITION_CHAINS[n];
+}
+
+// Raises `base` to the exponent of `chain`.
+inline double chainPower(double base, const AdditionChain& chain) {
+    double values[MAX_CHAIN_LENGTH + 1];
+    double product = values[0] = base;
+    for (size_t i = 0; i < chain.length; ++i) {
+        product *= chain.factors[i] == i ? product : values[chain.factors[i]];
+        values[i + 1] = product;
+    }
+    return product;
+}
+
+// x^n for a constant |n| <= MAX_INTEGER_EXPONENT, by its addition chain.
+inline double chainPower(double base, int n) {
+    if (n == 0) return 1;
+    double result = chainPower(base, additionChain(n < 0 ? -n : n));
+    return n < 0 ? 1 / result : result;
+}
+
+// x^n for |n| <= MAX_INTEGER_EXPONENT by binary exponentiation.
+inline double integerPower(double base, int n) {
+    unsigned count = static_cast<unsigned>(n < 0 ? -n : n);
+    double result = 1;
+    while (count != 0) {
+        if (count & 1) result *= base;
+        count >>= 1;
+        if (count != 0) base *= base;
+    }
+    return n < 0 ? 1 / result : result;
+}
+
+// Selects whether '^' always calls pow. The setting is process-wide and not
+// synchronized, and programs fused before a change keep their addition
+// chains: set it at startup, like setMathAccuracy.
+void setStrictPower(bool strict);
+
+// Returns the setting of setStrictPower.
+bool strictPower();
+
+// The flag `integerExponent` reads; use setStrictPower to change it.
+extern bool strictPowerEnabled;
+
+// Stores `exponent` in `n` and returns true if '^' multiplies for it: an
+// integer within MAX_INTEGER_EXPONENT, unless strict pow is selected.
+inline bool integerExponent(double exponent, int& n) {
+    if (strictPowerEnabled || !(exponent >= -MAX_INTEGER_EXPONENT && exponent <= MAX_INTEGER_EXPONENT)) {
+        return false;
+    }
+    n = static_cast<int>(exponent);
+    return n == exponent;
+}
+
+// Evaluates `base ^ exponent` for an exponent known only at run time.
+inline double power(double base, double exponent) {
+    int n;
+    if (integerExponent(exponent, n)) return integerPower(base, n);
+    return functionInfo(static_cast<uint32_t>(FunctionId::POW)).binary(base, exponent);
+}
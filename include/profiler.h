@@ -0,0 +1,86 @@
+#pragma once
+
+#include "alloc_counter.h"
+#include "latency_histogram.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+// The phases of a command-line evaluation, timed separately by `--profile`.
+enum class Phase : uint8_t {
+    CLI_PARSE,  // Command-line parsing.
+    TOKENIZE,   // tokenizer().
+    CALCULATE,  // calculate().
+    OUTPUT,     // Formatting and writing the result.
+    COUNT       // Number of phases (not a phase).
+};
+
+// Returns the display name of a phase (e.g., "tokenize").
+const char* phaseName(Phase phase);
+
+// Returns a steady-clock timestamp in nanoseconds.
+inline uint64_t nowNanoseconds() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Aggregate wall time and heap allocations for one phase, plus a latency
+// histogram of per-sample wall times.
+struct PhaseStats {
+    uint64_t samples = 0;
+    uint64_t totalNanoseconds = 0;
+    uint64_t minNanoseconds = UINT64_MAX;
+    uint64_t maxNanoseconds = 0;
+    AllocationStats allocations;
+    LatencyHistogram histogram;
+
+    // Adds one measurement.
+    void record(uint64_t nanoseconds, AllocationStats allocated);
+};
+
+// Collects per-phase timings and allocation counts. Disabled profilers
+// ignore every call, so the evaluation loop can call them unconditionally.
+class PhaseProfiler {
+public:
+    explicit PhaseProfiler(bool enabled) : enabled_(enabled) {}
+
+    // Measures one phase from construction to destruction.
+    class Scope {
+    public:
+        Scope(PhaseProfiler& profiler, Phase phase)
+            : profiler_(profiler), phase_(phase),
+              start_(profiler.enabled_ ? nowNanoseconds() : 0) {}
+        ~Scope() {
+            if (profiler_.enabled_) {
+                profiler_.record(phase_, start_, nowNanoseconds(), allocations_.elapsed());
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        PhaseProfiler& profiler_;
+        Phase phase_;
+        uint64_t start_;
+        AllocationCounter allocations_;
+    };
+
+    // Returns true if the profiler records anything.
+    bool enabled() const { return enabled_; }
+
+    // Records a phase that ran from `start` to `end` (nanosecond timestamps).
+    void record(Phase phase, uint64_t start, uint64_t end, AllocationStats allocated);
+
+    // Returns the aggregate for a phase.
+    const PhaseStats& stats(Phase phase) const { return phases_[static_cast<size_t>(phase)]; }
+
+    // Writes a per-phase table. With `histograms`, also writes each
+    // phase's latency percentiles (used in batch mode).
+    void report(std::ostream& os, bool histograms) const;
+
+private:
+    bool enabled_;
+    std::array<PhaseStats, static_cast<size_t>(Phase::COUNT)> phases_;
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "ast.h"
+#include "tokenizer.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Instructions of a postfix (stack) program.
+enum class StackOp : uint8_t {
+    PUSH,      // Push constants[operand].
+    LOAD,      // Push variables[operand].
+    ADD,       // Pop b, pop a, push a + b.
+    SUBTRACT,  // Pop b, pop a, push a - b.
+    MULTIPLY,  // Pop b, pop a, push a * b.
+    DIVIDE,    // Pop b, pop a, push a / b; division by zero throws.
+    POWER,     // Pop b, pop a, push a ^ b (power.h).
+    CALL_UNARY,   // x = f(x), f the function with id `operand` (functions.h).
+    CALL_BINARY,  // Pop b, pop a, push f(a, b).
+    HALT,      // End of program; the result is the only stack entry.
+
+    // Superinstructions produced by `fuseInstructions`. "c" is
+    // constants[operand] and "x" the top of the stack.
+    ADD_CONST,           // x = x + c.
+    SUBTRACT_CONST,      // x = x - c.
+    MULTIPLY_CONST,      // x = x * c.
+    DIVIDE_CONST,        // x = x / c, for a nonzero constant.
+    POWER_CONST,         // x = x ^ c.
+    SQUARE,              // x = x * x (from "^ 2").
+    CUBE,                // x = x * x * x (from "^ 3").
+    POWER_CHAIN,         // x = x ^ c by the addition chain of c (power.h).
+    MULTIPLY_ADD,        // Pop b, pop a, pop c, push c + a * b.
+    MULTIPLY_ADD_CONST,  // Pop b, pop a, push a * b + c.
+
+    COUNT,  // Number of instructions; not an instruction.
+};
+
+const size_t STACK_OP_COUNT = static_cast<size_t>(StackOp::COUNT);
+
+// Returns the mnemonic of an instruction (e.g., "MULTIPLY_ADD").
+const char* stackOpName(StackOp op);
+
+// One postfix instruction. `operand` is a constant index for PUSH and the
+// *_CONST superinstructions, a variable slot for LOAD, a FunctionId for the
+// calls and unused otherwise.
+struct StackInstruction {
+    StackOp op;
+    uint32_t operand;
+};
+
+// An expression compiled to postfix order, the form `calculate()` evaluates
+// implicitly. `code` always ends with HALT.
+struct PostfixProgram {
+    std::vector<StackInstruction> code;  // Instructions, ending with HALT.
+    std::vector<double> constants;       // Literal pool indexed by PUSH.
+    size_t maxDepth = 0;                 // Operand stack depth needed to run.
+    size_t variableCount = 0;            // One more than the highest slot LOADed.
+};
+
+// Compiles a parsed tree; its post-order nodes map one-to-one onto
+// instructions.
+PostfixProgram compilePostfix(const ExprTree& tree);
+
+// Parses and compiles a token stream from `tokenizer()`, resolving
+// identifiers to slots in `symbols`.
+// Throws the same syntax errors as `parseExpressionTree()`.
+PostfixProgram compilePostfix(const std::vector<Token>& tokens, const SymbolTable* symbols = nullptr);
+
+// Runs a postfix program on an operand stack. LOAD reads `variables[slot]`
+// (e.g., Environment::values()).
+// Throws a runtime error on division by zero.
+double evaluate(const PostfixProgram& program, const double* variables = nullptr);
+
+// How often each instruction is directly followed by each other one,
+// summed over a workload. Programs are straight-line code, so the static
+// pairs of a program are also the pairs it executes.
+struct OpcodePairCounts {
+    uint64_t counts[STACK_OP_COUNT][STACK_OP_COUNT] = {};  // [first][second].
+    uint64_t total = 0;                                    // Sum of all counts.
+
+    // Adds the adjacent pairs of one program (the final HALT included).
+    void record(const PostfixProgram& program);
+
+    // Writes the `limit` most frequent pairs with their share of the total.
+    void print(std::ostream& os, size_t limit) const;
+};
+
+// The instruction pairs `fuseInstructions` may replace with a
+// superinstruction. Each enabled pair has a fusion rule:
+//   PUSH, ADD/SUBTRACT/MULTIPLY/DIVIDE/POWER  -> the *_CONST variant
+//                                              (POWER by an integer constant ->
+//                                              SQUARE, CUBE or POWER_CHAIN;
+//                                              division by a zero constant stays
+//                                              unfused so it still throws)
+//   MULTIPLY, ADD                             -> MULTIPLY_ADD
+//   MULTIPLY, ADD_CONST                       -> MULTIPLY_ADD_CONST
+// MULTIPLY_ADD rounds the product before adding, as the separate
+// instructions do: it saves dispatches, not roundings. Integer powers follow
+// their shortest addition chain where POWER uses binary exponentiation, so
+// they may differ from the unfused program in the last bits (see power.h);
+// with strict pow every constant power is a POWER_CONST.
+struct FusionPlan {
+    bool enabled[STACK_OP_COUNT][STACK_OP_COUNT] = {};  // [first][second].
+
+    // Returns a plan with every fusion rule enabled.
+    static FusionPlan all();
+
+    // Writes the enabled pairs, one "FIRST,SECOND" per line.
+    void print(std::ostream& os) const;
+};
+
+// Picks superinstructions for a workload greedily: count the instruction
+// pairs of every program as fused under the current plan, enable the most
+// frequent pair that has a fusion rule, and repeat while the best candidate
+// still accounts for at least `minShare` of all pairs. Re-counting after
+// each step lets fusions build on each other (MULTIPLY, ADD_CONST).
+FusionPlan planFusions(const std::vector<PostfixProgram>& workload, double minShare = 0.02);
+
+// Rewrites a program with the superinstructions enabled in `plan` in a
+// single peephole pass. The result computes the same value.
+PostfixProgram fuseInstructions(const PostfixProgram& program, const FusionPlan& plan);
+
+// Instructions of a register program.
+enum class RegisterOp : uint8_t {
+    ADD,       // dest = left + right.
+    SUBTRACT,  // dest = left - right.
+    MULTIPLY,  // dest = left * right.
+    DIVIDE,    // dest = left / right; division by zero throws.
+    POWER,     // dest = left ^ right (power.h).
+    CALL_UNARY,   // dest = f(left), f the function with id `function`.
+    CALL_BINARY,  // dest = f(left, right).
+    HALT,      // End of program.
+};
+
+// One three-address instruction; every field but `op` and `function` is a
+// register slot.
+struct RegisterInstruction {
+    RegisterOp op;
+    uint8_t function;  // FunctionId of the calls.
+    uint32_t dest;
+    uint32_t left;
+    uint32_t right;
+};
+
+// An expression compiled for a register machine. Slots [0, variableCount)
+// hold the variables and the next constants.size() slots the constants;
+// both are loaded before the program runs, so operands cost no
+// instructions. The remaining slots hold intermediate results.
+struct RegisterProgram {
+    std::vector<RegisterInstruction> code;  // Instructions, ending with HALT.
+    std::vector<double> constants;          // Distinct literals, one slot each.
+    size_t variableCount = 0;               // Variable slots, copied in first.
+    size_t registerCount = 0;               // Variable, constant and temporary slots.
+    uint32_t result = 0;                    // Slot holding the final value.
+};
+
+// Compiles a postfix program (without superinstructions) to register form.
+// Equal literals share a slot and repeated subexpressions are computed once,
+// turning the tree into a DAG; a power by a positive integer constant
+// becomes the multiplications of its addition chain (power.h) first, so
+// they are shared too. Temporaries are then assigned by a linear scan over
+// that DAG, which frees a register after the last instruction that reads
+// it.
+RegisterProgram compileRegisters(const PostfixProgram& program);
+
+// Runs a register program, reading variables from `variables[slot]`.
+// Throws a runtime error on division by zero.
+double evaluate(const RegisterProgram& program, const double* variables = nullptr);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "environment.h"
+#include "program.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// The built-in aggregates of --reduce.
+enum class Aggregate : uint8_t { SUM, MIN, MAX, MEAN, VAR };
+
+// Stores the aggregate called `name` ("sum", "min", "max", "mean", "var")
+// in `aggregate`. Returns false for any other name.
+bool findAggregate(std::string_view name, Aggregate& aggregate);
+
+// Independent accumulators `RunningStats::add` keeps within a block, so
+// consecutive additions do not wait on each other.
+const size_t REDUCTION_LANES = 4;
+
+// A constant-size summary of a stream of numbers from which every
+// Aggregate is read. Each block passed to `add` is summarized on its own
+// (sums and extremes in REDUCTION_LANES partial accumulators; mean and
+// squared deviations from the block mean in a second pass over the
+// block) and then merged into the running state with Chan's update of
+// Welford's algorithm, which also merges summaries of separate streams.
+// A NaN anywhere makes every aggregate NaN.
+struct RunningStats {
+    uint64_t count = 0;
+    double sum = 0;
+    double min = INFINITY;
+    double max = -INFINITY;
+    double mean = 0;
+    double m2 = 0;  // Sum of squared deviations from `mean`.
+
+    // Adds `count` values.
+    void add(const double* values, size_t count);
+
+    // Adds the numbers summarized by `other`.
+    void merge(const RunningStats& other);
+
+    // Returns `aggregate` of the numbers added: their sum (0 when there
+    // are none), minimum, maximum, mean or population variance (NaN when
+    // there are none).
+    double value(Aggregate aggregate) const;
+};
+
+// A custom reduction acc = f(acc, x): `program` reads the accumulator from
+// variable slot "acc" and the next number from slot "x", and its result is
+// the new accumulator. Other slots keep their values in the environment.
+// Numbers are folded in order, one `evaluate` of the fused program each.
+class Fold {
+public:
+    // Starts from acc = `initial`. Throws a runtime error if `environment`
+    // lacks acc or x.
+    Fold(const PostfixProgram& program, const Environment& environment, double initial);
+
+    // Folds `count` values into the accumulator. Throws a runtime error
+    // naming the position in the stream if an evaluation fails.
+    void add(const double* values, size_t count);
+
+    // Returns the accumulator.
+    double value() const { return row_[accSlot_]; }
+
+private:
+    PostfixProgram program_;
+    std::vector<double> row_;  // Variable values, indexed by slot.
+    uint32_t accSlot_;
+    uint32_t xSlot_;
+    uint64_t count_ = 0;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Number of bytes classified per step by `classifyBlock`.
+const size_t SCAN_BLOCK_SIZE = 64;
+
+// Per-byte character classes for one block of an expression. Bit i of each
+// mask describes byte i of the block. Bytes past the end of the input are
+// reported as whitespace so they never produce tokens.
+struct CharClassMasks {
+    uint64_t whitespace;   // ' ', '\t', '\n', '\v', '\f', '\r'.
+    uint64_t numeric;      // Digits and '.'.
+    uint64_t digit;        // '0' .. '9' (also set in `numeric`).
+    uint64_t letter;       // 'A' .. 'Z', 'a' .. 'z' and '_'.
+    uint64_t op;           // '+', '-', '*', '/', '^'.
+    uint64_t leftParen;    // '('.
+    uint64_t rightParen;   // ')'.
+    uint64_t comma;        // ','.
+    uint64_t invalid;      // Every other byte.
+};
+
+// Classifies up to SCAN_BLOCK_SIZE bytes starting at `data`. Uses AVX2 or
+// SSE4.2 when the CPU supports them and a scalar table lookup otherwise.
+CharClassMasks classifyBlock(const char* data, size_t length);
+
+// Structural bytes of one block of delimited text such as CSV. Bit i of
+// each mask describes byte i of the block; bytes past the end of the input
+// are in none.
+struct CsvMasks {
+    uint64_t delimiter;  // The field delimiter.
+    uint64_t newline;    // '\n'.
+    uint64_t quote;      // '"'.
+};
+
+// Classifies up to SCAN_BLOCK_SIZE bytes of delimited text starting at
+// `data`, with the same CPU dispatch as `classifyBlock`.
+CsvMasks classifyCsvBlock(const char* data, size_t length, char delimiter);
+
+// Returns the name of the classifier selected for this CPU ("avx2",
+// "sse4.2" or "scalar"). Useful for benchmarks and debugging.
+const char* scannerImplementationName();
+
+// Walks `expression` block by block and reports token boundaries to
+// `visitor`, which must provide:
+//   number(size_t begin, size_t end)  // A run of digits and '.'.
+//   identifier(size_t begin, size_t end)  // A letter or '_', then letters,
+//                                         // digits and '_'.
+//   op(size_t pos)                    // An operator character.
+//   leftParen(size_t pos)
+//   rightParen(size_t pos)
+//   comma(size_t pos)
+//   invalid(size_t pos)               // An unrecognized character.
+// Callbacks are made in source order. Whitespace is skipped a whole block
+// at a time, so only bytes that start or end a token are visited.
+template <typename Visitor>
+void scanExpression(std::string_view expression, Visitor&& visitor) {
+    const char* data = expression.data();
+    const size_t length = expression.length();
+    size_t numberBegin = 0;
+    size_t identifierBegin = 0;
+    uint64_t carry = 0;  // 1 if the previous block ended inside a number.
+    uint64_t identifierCarry = 0;     // ... inside an identifier.
+    uint64_t wordCarry = 0;           // ... on a letter, digit or '_'.
+    uint64_t leadingDigitCarry = 0;   // ... on digits that start a word.
+
+    for (size_t block = 0; block < length; block += SCAN_BLOCK_SIZE) {
+        size_t blockLength = length - block < SCAN_BLOCK_SIZE ? length - block : SCAN_BLOCK_SIZE;
+        CharClassMasks masks = classifyBlock(data + block, blockLength);
+
+        // An identifier is a run of letters, digits and '_' from its first
+        // letter on, so "2x" is the number 2 followed by the identifier x.
+        // Adding the first digit of each word to the digit mask carries
+        // through (and clears) the digits that lead the word.
+        uint64_t word = masks.letter | masks.digit;
+        uint64_t wordStarts = word & ~((word << 1) | wordCarry);
+        uint64_t leadingDigits = masks.digit & ~(masks.digit + ((wordStarts | leadingDigitCarry) & masks.digit));
+        uint64_t identifier = word & ~leadingDigits;
+        uint64_t identifierBefore = (identifier << 1) | identifierCarry;
+        uint64_t identifierStarts = identifier & ~identifierBefore;
+        uint64_t identifierEnds = ~identifier & identifierBefore;
+
+        // A number starts where a numeric byte follows a non-numeric one and
+        // ends at the first non-numeric byte after it.
+        uint64_t numeric = masks.numeric & ~identifier;
+        uint64_t numericBefore = (numeric << 1) | carry;
+        uint64_t numberStarts = numeric & ~numericBefore;
+        uint64_t numberEnds = ~numeric & numericBefore;
+        uint64_t events = numberStarts | numberEnds | identifierStarts | identifierEnds | masks.op |
+                          masks.leftParen | masks.rightParen | masks.comma | masks.invalid;
+
+        while (events != 0) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctzll(events));
+            uint64_t flag = uint64_t{1} << bit;
+            size_t pos = block + bit;
+            events &= events - 1;
+
+            if (numberEnds & flag) {
+                visitor.number(numberBegin, pos);
+            }
+            if (identifierEnds & flag) {
+                visitor.identifier(identifierBegin, pos);
+            }
+            if (numberStarts & flag) {
+                numberBegin = pos;
+            } else if (identifierStarts & flag) {
+                identifierBegin = pos;
+            } else if (masks.op & flag) {
+                visitor.op(pos);
+            } else if (masks.leftParen & flag) {
+                visitor.leftParen(pos);
+            } else if (masks.rightParen & flag) {
+                visitor.rightParen(pos);
+            } else if (masks.comma & flag) {
+                visitor.comma(pos);
+            } else if (masks.invalid & flag) {
+                visitor.invalid(pos);
+            }
+        }
+
+        carry = numeric >> (SCAN_BLOCK_SIZE - 1);
+        identifierCarry = identifier >> (SCAN_BLOCK_SIZE - 1);
+        wordCarry = word >> (SCAN_BLOCK_SIZE - 1);
+        leadingDigitCarry = leadingDigits >> (SCAN_BLOCK_SIZE - 1);
+    }
+
+    // Flush a token that runs up to the end of a full final block.
+    if (carry) {
+        visitor.number(numberBegin, length);
+    }
+    if (identifierCarry) {
+        visitor.identifier(identifierBegin, length);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "tokenizer.h"
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// Compact operator codes used by the structure-of-arrays token buffer.
+enum class OpCode : uint8_t {
+    NONE,       // Not an operator (numbers, parentheses, unknown tokens).
+    ADD,        // '+'
+    SUBTRACT,   // '-'
+    MULTIPLY,   // '*'
+    DIVIDE,     // '/'
+    POWER,      // '^'
+};
+
+// Returns the operator code for a character, or OpCode::NONE if the
+// character is not a recognized operator.
+constexpr OpCode opCodeFromChar(char op) {
+    switch (op) {
+        case '+': return OpCode::ADD;
+        case '-': return OpCode::SUBTRACT;
+        case '*': return OpCode::MULTIPLY;
+        case '/': return OpCode::DIVIDE;
+        case '^': return OpCode::POWER;
+        default:  return OpCode::NONE;
+    }
+}
+
+// Returns the source character for an operator code (e.g., '+' for ADD).
+constexpr char opCodeToChar(OpCode op) {
+    switch (op) {
+        case OpCode::ADD:      return '+';
+        case OpCode::SUBTRACT: return '-';
+        case OpCode::MULTIPLY: return '*';
+        case OpCode::DIVIDE:   return '/';
+        case OpCode::POWER:    return '^';
+        default:               return '?';
+    }
+}
+
+// Returns the precedence of an operator code, using the same levels as
+// `getPrecedence` (0 for OpCode::NONE). Inline table lookup for hot loops.
+inline int opCodePrecedence(OpCode op) {
+    static constexpr int PRECEDENCE[] = {
+        0, PREC_ADD_SUB, PREC_ADD_SUB, PREC_MUL_DIV, PREC_MUL_DIV, PREC_POWER,
+    };
+    return PRECEDENCE[static_cast<uint8_t>(op)];
+}
+
+// Returns true if the operator code is left-associative (only POWER is not).
+inline bool isOpCodeLeftAssociative(OpCode op) {
+    return op != OpCode::POWER;
+}
+
+// A token stream stored as parallel arrays instead of a vector of `Token`.
+// Each token costs one kind byte, one operator byte, a 32-bit source offset
+// and a 32-bit literal index; number values live in a separate pool of
+// doubles. Expressions must be shorter than 4 GiB. All arrays allocate from
+// the same std::pmr::memory_resource.
+struct TokenBuffer {
+    std::pmr::vector<TokenType> kinds;          // The type of each token.
+    std::pmr::vector<OpCode> opCodes;           // Operator code (NONE for non-operators).
+    std::pmr::vector<uint32_t> offsets;         // Byte offset of the token in the source.
+    std::pmr::vector<uint32_t> literalIndexes;  // Index into `literals` for NUMBER tokens;
+                                                // name length for IDENTIFIER tokens;
+                                                // FunctionId (or NO_FUNCTION) for FUNCTION.
+    std::pmr::vector<double> literals;          // Parsed values of NUMBER tokens.
+
+    TokenBuffer() = default;
+
+    // Creates an empty buffer whose arrays allocate from `resource`.
+    explicit TokenBuffer(std::pmr::memory_resource* resource)
+        : kinds(resource), opCodes(resource), offsets(resource),
+          literalIndexes(resource), literals(resource) {}
+
+    // Returns the number of tokens in the buffer.
+    size_t size() const { return kinds.size(); }
+
+    // Returns true if the buffer holds no tokens.
+    bool empty() const { return kinds.empty(); }
+
+    // Removes all tokens but keeps the allocated capacity.
+    void clear();
+
+    // Reserves room for `tokens` tokens (and as many literals).
+    void reserve(size_t tokens);
+
+    // Returns the number of heap bytes currently reserved by the buffer.
+    size_t capacityBytes() const;
+};
+
+// Tokenizes `expression` into `tokens`, replacing its previous contents.
+// Numbers are parsed once here, so evaluation never touches the source text.
+// Invalid characters are kept as UNKNOWN tokens (rather than reported on
+// std::cerr) so evaluation can reject the expression.
+void tokenizer(std::string_view expression, TokenBuffer& tokens);
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
+#include <memory_resource>
+#include <string>
 #include <vector>
 #include <string_view>
 
@@ -11,12 +14,16 @@ const int PREC_ADD_SUB = 1;  // Precedence for addition (+) and subtraction (-).
 const int PREC_MUL_DIV = 2;  // Precedence for multiplication (*) and division (/).
 const int PREC_POWER = 3;    // Precedence for exponentiation (^).
 
-// Represents the type of a token in a mathematical expression.
-enum class TokenType {
+// Represents the type of a token in a mathematical expression. Stored as a
+// single byte so token kinds pack densely (see TokenBuffer).
+enum class TokenType : uint8_t {
     NUMBER,        // Numeric values (e.g., "3.14", "42").
     OPERATOR,      // Mathematical operators (e.g., '+', '-', '*', '/').
     LEFT_PAREN,    // Left parenthesis '('.
     RIGHT_PAREN,   // Right parenthesis ')'.
+    IDENTIFIER,    // Variable names (e.g., "price", "x1").
+    FUNCTION,      // A function name and the '(' after it (e.g., "sqrt(").
+    COMMA,         // Argument separator ','.
     UNKNOWN        // Unrecognized or invalid tokens.
 };
 
@@ -26,42 +33,91 @@ std::string tokenTypeToString(TokenType type);
 
 // Represents a token in a mathematical expression, such as a number,
 // operator, or parenthesis. Includes metadata for operators like precedence
-// and associativity.
+// and associativity. The value is allocated with the allocator of the
+// container holding the token, so the tokens in a std::pmr::vector keep
+// even long literals in the vector's memory resource.
 struct Token {
-    std::string value;  // The string value of the token (e.g., "3.14", "+").
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    std::pmr::string value;  // The string value of the token (e.g., "3.14", "+").
     TokenType type;     // The type of the token.
     int precedence;     // Operator precedence (0 for non-operators).
     bool isLeftAssociative;  // True if the operator is left-associative.
 
     // Constructs a token for a number or non-operator symbol.
-    Token(std::string val_str, TokenType t)
-        : value(std::move(val_str)), type(t), precedence(0), isLeftAssociative(true) {}
+    Token(std::string_view val_str, TokenType t, const allocator_type& allocator = {})
+        : value(val_str, allocator), type(t), precedence(0), isLeftAssociative(true) {}
 
     // Constructs a token for a single character (e.g., a parenthesis).
-    Token(char val_char, TokenType t)
-        : value(1, val_char), type(t), precedence(0), isLeftAssociative(true) {}
+    Token(char val_char, TokenType t, const allocator_type& allocator = {})
+        : value(1, val_char, allocator), type(t), precedence(0), isLeftAssociative(true) {}
 
     // Constructs a token for an operator with specified precedence and associativity.
-    Token(char val_char, TokenType t, int prec, bool is_left_assoc)
-        : value(1, val_char), type(t), precedence(prec), isLeftAssociative(is_left_assoc) {}
+    Token(char val_char, TokenType t, int prec, bool is_left_assoc, const allocator_type& allocator = {})
+        : value(1, val_char, allocator), type(t), precedence(prec), isLeftAssociative(is_left_assoc) {}
+
+    Token(const Token&) = default;
+    Token(Token&&) = default;
+    Token& operator=(const Token&) = default;
+    Token& operator=(Token&&) = default;
+
+    // Copies or moves a token into storage from `allocator`.
+    Token(const Token& other, const allocator_type& allocator)
+        : value(other.value, allocator), type(other.type), precedence(other.precedence),
+          isLeftAssociative(other.isLeftAssociative) {}
+    Token(Token&& other, const allocator_type& allocator)
+        : value(std::move(other.value), allocator), type(other.type), precedence(other.precedence),
+          isLeftAssociative(other.isLeftAssociative) {}
 };
 
+// Returns the value of a NUMBER token, parsed like std::stod (which only
+// takes a std::string). Throws std::invalid_argument if it is not a number
+// and std::out_of_range if it overflows.
+double tokenNumber(const Token& token);
+
 // Outputs a human-readable representation of the token to the stream.
 // Example: "Token(value='+', type=OPERATOR, precedence=1, isLeftAssociative=true)"
 std::ostream& operator<<(std::ostream& os, const Token& token);
 
 // Returns the precedence level for a given operator character (e.g., '+' or '*').
 // Returns 0 if the character is not a recognized operator.
-int getPrecedence(char op);
+// Constexpr so compile-time evaluation (constexpr_eval.h) shares the table.
+constexpr int getPrecedence(char op) {
+    if (op == '+' || op == '-') return PREC_ADD_SUB; // Addition and subtraction
+    if (op == '*' || op == '/') return PREC_MUL_DIV; // Multiplication and division
+    if (op == '^') return PREC_POWER;               // Exponentiation
+    return 0; // Non-operator characters have no precedence.
+}
 
 // Returns true if the given character is a recognized mathematical operator
 // (e.g., '+', '-', '*', '/', '^').
-bool isOperatorChar(char c);
+constexpr bool isOperatorChar(char c) {
+    return c == '+' || c == '-' || c == '*' || c == '/' || c == '^';
+}
 
 // Determines if a binary operator is left-associative (e.g., '+' is left-associative).
-// Returns false for right-associative operators (e.g., '^') or unrecognized operators.
-bool isBinaryOperatorLeftAssociative(char op);
+// Returns false for right-associative operators (e.g., '^'); unrecognized
+// operators default to left-associative.
+constexpr bool isBinaryOperatorLeftAssociative(char op) {
+    if (op == '+' || op == '-' || op == '*' || op == '/') {
+        return true; // Standard arithmetic operators are left-associative.
+    }
+    if (op == '^') {
+        return false; // Exponentiation is right-associative.
+    }
+    return true; // Default to left-associative for unknown operators.
+}
 
 // Tokenizes a mathematical expression string into a vector of tokens.
 // Example: "3 + 4 * (2 - 1)" -> [NUMBER(3), OPERATOR(+), NUMBER(4), OPERATOR(*), LEFT_PAREN, NUMBER(2), OPERATOR(-), NUMBER(1), RIGHT_PAREN]
 std::vector<Token> tokenizer(const std::string_view expression);
+
+// Tokenizes `expression` into a caller-owned vector, replacing its contents.
+// The vector keeps its capacity, so repeated calls on expressions of similar
+// size do not allocate (number strings fit in the small-string buffer).
+void tokenizer(const std::string_view expression, std::vector<Token>& tokens);
+
+// Tokenizes `expression` into a vector allocated from `resource`. Token
+// strings are allocated from `resource` too, so the tokens live entirely in
+// it, however long the literals.
+std::pmr::vector<Token> tokenizer(const std::string_view expression, std::pmr::memory_resource* resource);
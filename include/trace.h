@@ -0,0 +1,65 @@
+#pragma once
+
+#include "profiler.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Records timed spans into per-thread ring buffers and writes them out as
+// Chrome/Perfetto trace-event JSON (load it in chrome://tracing or
+// ui.perfetto.dev). Span names must be string literals or otherwise outlive
+// the trace.
+
+// One completed span.
+struct TraceEvent {
+    const char* name;
+    uint64_t startNanoseconds;
+    uint64_t endNanoseconds;
+};
+
+// Number of events each thread keeps; older events are overwritten.
+const size_t TRACE_RING_CAPACITY = 1 << 16;
+
+extern std::atomic<bool> traceEnabledFlag;
+
+// Returns true if tracing is on.
+inline bool traceEnabled() {
+    return traceEnabledFlag.load(std::memory_order_relaxed);
+}
+
+// Turns tracing on. Call before starting the threads being traced.
+void enableTracing();
+
+// Appends a completed span to the calling thread's ring buffer.
+void recordTraceEvent(const char* name, uint64_t startNanoseconds, uint64_t endNanoseconds);
+
+// Writes every thread's events as trace-event JSON to `path`. Call once the
+// traced threads are done. Returns false if the file cannot be written.
+bool writeChromeTrace(const std::string& path);
+
+// Records a span from construction to destruction. Only construct one when
+// tracing is enabled; `traced()` does that check for you.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name_(name), start_(nowNanoseconds()) {}
+    ~TraceSpan() { recordTraceEvent(name_, start_, nowNanoseconds()); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+// Runs `body` and returns its result, recording it as span `name` when
+// tracing is enabled. When tracing is disabled the only cost is one
+// predictable branch.
+template <typename Body>
+decltype(auto) traced(const char* name, Body&& body) {
+    if (__builtin_expect(!traceEnabled(), 1)) {
+        return body();
+    }
+    TraceSpan span(name);
+    return body();
+}
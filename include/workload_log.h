@@ -0,0 +1,74 @@
+#pragma once
+
+#include "functions.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// One evaluated expression in a workload log.
+struct WorkloadRecord {
+    uint64_t timestampNanoseconds = 0;  // Time since the capture started.
+    std::string expression;             // The expression exactly as evaluated.
+    bool ok = false;                    // False if evaluation threw.
+    double value = 0;                   // The result when `ok`.
+};
+
+// What a capture was evaluated with, so a replay can reproduce its results.
+struct WorkloadSettings {
+    std::vector<std::pair<std::string, double>> variables;  // --var bindings.
+    MathAccuracy accuracy = MathAccuracy::FULL;              // --fast-math level.
+    bool strictPower = false;                                // --strict-pow.
+};
+
+// Writes a compact binary workload log. The file starts with the 8-byte
+// magic "CALCLOG1" and the settings:
+//   varint  number of variables, then for each
+//           varint name length, followed by the name bytes
+//           f64    its value
+//   u8      the MathAccuracy level
+//   u8      1 if '^' was strict (setStrictPower), 0 otherwise
+// Each record is then
+//   varint  timestamp delta from the previous record (ns)
+//   varint  expression length, followed by the expression bytes
+//   u8      1 if evaluation succeeded, 0 if it failed
+//   f64     the result (little-endian IEEE 754), only when it succeeded
+class WorkloadWriter {
+public:
+    // Opens `path` for writing, truncating it, and writes `settings`.
+    // Throws a runtime error if the file cannot be created.
+    WorkloadWriter(const std::string& path, const WorkloadSettings& settings);
+
+    // Appends one record. Timestamps must not decrease.
+    void append(uint64_t timestampNanoseconds, std::string_view expression, bool ok, double value);
+
+    // Flushes buffered records to disk.
+    void flush() { out_.flush(); }
+
+private:
+    std::ofstream out_;
+    uint64_t lastTimestamp_ = 0;
+};
+
+// Reads a log written by WorkloadWriter.
+class WorkloadReader {
+public:
+    // Opens `path`, checks the magic and reads the settings. Throws a
+    // runtime error if the file cannot be opened or is not a workload log.
+    explicit WorkloadReader(const std::string& path);
+
+    // Returns the settings the log was captured with.
+    const WorkloadSettings& settings() const { return settings_; }
+
+    // Reads the next record into `record`. Returns false at the end of the
+    // log; throws a runtime error if the log is truncated or corrupt.
+    bool next(WorkloadRecord& record);
+
+private:
+    std::ifstream in_;
+    uint64_t fileSize_ = 0;  // Bounds lengths read from the log.
+    WorkloadSettings settings_;
+    uint64_t lastTimestamp_ = 0;
+};
@@ -1,27 +1,504 @@
 #include "CLI11.h"
 #include "tokenizer.h"
 #include "calculator.h"
+#include "csv.h"
+#include "functions.h"
+#include "latency_histogram.h"
+#include "npy.h"
+#include "number_stream.h"
+#include "perf_counters.h"
+#include "power.h"
+#include "profiler.h"
+#include "reduction.h"
+#include "trace.h"
+#include "workload_log.h"
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+// Hardware counter totals for the tokenizer() and calculate() phases,
+// collected when --perf-counters is given.
+struct PerfReport {
+    PerfCounters counters;
+    PerfSample tokenize;
+    PerfSample calculate;
+    size_t expressions = 0;
+
+    // Writes the aggregate over every expression.
+    void report(std::ostream& os) const {
+        if (!counters.available()) {
+            os << "perf: hardware counters unavailable (" << counters.unavailableReason() << ")\n";
+            return;
+        }
+        os << "perf: total over " << expressions << " expression(s)\n"
+           << "perf:   tokenize:  " << tokenize << '\n'
+           << "perf:   calculate: " << calculate << '\n';
+    }
+};
+
+// Instrumentation shared by every evaluated expression.
+struct EvaluationHooks {
+    PhaseProfiler& profiler;            // Per-phase timing (--profile).
+    PerfReport* perf = nullptr;         // Hardware counters (--perf-counters).
+    WorkloadWriter* capture = nullptr;  // Workload capture (--capture).
+    uint64_t captureStart = 0;          // Time origin of the capture.
+    bool flush = false;                 // Flush stdout after each result.
+    const Environment* environment = nullptr;  // Variables (--var).
+};
+
+// Tokenizes, evaluates and prints one expression, timing each phase and,
+// if enabled, counting hardware events for tokenizer() and calculate() and
+// capturing the expression and its result.
+// Throws runtime errors for syntax or evaluation issues.
+void evaluateExpression(std::string_view expression, EvaluationHooks& hooks) {
+    PhaseProfiler& profiler = hooks.profiler;
+    PerfReport* perf = hooks.perf;
+    bool counting = perf && perf->counters.available();
+    uint64_t received = hooks.capture ? nowNanoseconds() : 0;
+    PerfSample start, tokenized, calculated;
+
+    std::vector<Token> tokenized_exp;
+    {
+        PhaseProfiler::Scope scope(profiler, Phase::TOKENIZE);
+        if (counting) start = perf->counters.read();
+        tokenized_exp = traced("tokenize", [&] {
+            return tokenizer(expression); // Call the tokenizer function with the expression
+        });
+        if (counting) tokenized = perf->counters.read();
+    }
+
+    double answer;
+    try {
+        PhaseProfiler::Scope scope(profiler, Phase::CALCULATE);
+        answer = traced("calculate", [&] {
+            // Call the shunting yard algorithm with the tokenized expression
+            return hooks.environment ? calculate(tokenized_exp, *hooks.environment) : calculate(tokenized_exp);
+        });
+        if (counting) calculated = perf->counters.read();
+    } catch (const std::runtime_error&) {
+        if (hooks.capture) hooks.capture->append(received - hooks.captureStart, expression, false, 0);
+        throw;
+    }
+    if (hooks.capture) hooks.capture->append(received - hooks.captureStart, expression, true, answer);
+
+    if (counting) {
+        PerfSample tokenizeSample = tokenized - start;
+        PerfSample calculateSample = calculated - tokenized;
+        perf->tokenize += tokenizeSample;
+        perf->calculate += calculateSample;
+        ++perf->expressions;
+        std::cerr << "perf: " << expression << '\n'
+                  << "perf:   tokenize:  " << tokenizeSample << '\n'
+                  << "perf:   calculate: " << calculateSample << '\n';
+    }
+
+    PhaseProfiler::Scope scope(profiler, Phase::OUTPUT);
+    traced("output", [&] {
+        std::cout << expression << " = " << answer << '\n';
+        if (hooks.flush) std::cout.flush();
+    });
+}
+
+// Builds the environment for --var definitions of the form name=value,
+// after the variables in `boundNames` (set by the mode, such as --map's x).
+// Throws a runtime error for a malformed or duplicate definition.
+Environment parseVariables(const std::vector<std::string>& definitions,
+                           const std::vector<std::string>& boundNames = {}) {
+    std::vector<std::string> names = boundNames;
+    std::vector<double> values(boundNames.size(), 0.0);
+    for (const auto& definition : definitions) {
+        size_t equals = definition.find('=');
+        size_t parsed = 0;
+        try {
+            if (equals != std::string::npos) values.push_back(std::stod(definition.substr(equals + 1), &parsed));
+        } catch (const std::logic_error&) {
+            parsed = 0;
+        }
+        if (equals == std::string::npos || parsed == 0 || parsed != definition.size() - equals - 1) {
+            throw std::runtime_error("Invalid variable definition '" + definition + "' (expected name=value)");
+        }
+        names.push_back(definition.substr(0, equals));
+    }
+
+    Environment environment(std::move(names));
+    for (uint32_t slot = 0; slot < values.size(); ++slot) environment[slot] = values[slot];
+    return environment;
+}
+
+// Reports a StreamErrors summary on stderr. Returns false if there were
+// any problems.
+bool reportStreamErrors(const char* what, const StreamErrors& errors, const char* unit = "number") {
+    if (errors.count == 0) return true;
+    std::cerr << errors.count << ' ' << what << "; the first, at " << unit << ' ' << errors.firstIndex + 1 << ": "
+              << errors.first << std::endl;
+    return false;
+}
+
+// --map: compiles `expression` once against `environment` and evaluates
+// it for every number on stdin, bound to x. Returns the exit status.
+int mapStdin(std::string_view expression, const Environment& environment) {
+    PostfixProgram program;
+    try {
+        program = compilePostfix(tokenizer(expression), &environment.symbols());
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    NumberReader reader(std::cin);
+    StreamErrors failures;
+    {
+        NumberWriter writer(std::cout);
+        failures = mapNumbers(program, environment, environment.slot("x"), reader, writer);
+    }
+    std::cout.flush();
+    bool ok = reportStreamErrors("invalid number(s)", reader.errors());
+    ok = reportStreamErrors("failed evaluation(s)", failures) && ok;
+    return ok ? 0 : 1;
+}
+
+// --reduce: reduces every number on stdin, or with --map (`mapExpression`
+// not null) every mapped result, by a built-in aggregate or by a fold over
+// acc and x starting from `initial`, and prints the result. Returns the
+// exit status.
+int reduceStdin(std::string_view reduction, const std::string_view* mapExpression, double initial,
+                const Environment& environment) {
+    Aggregate aggregate = Aggregate::SUM;
+    const bool builtIn = findAggregate(reduction, aggregate);
+    RunningStats stats;
+    std::unique_ptr<Fold> fold;
+    PostfixProgram mapProgram;
+    try {
+        if (!builtIn) {
+            fold = std::make_unique<Fold>(compilePostfix(tokenizer(reduction), &environment.symbols()), environment,
+                                          initial);
+        }
+        if (mapExpression) mapProgram = compilePostfix(tokenizer(*mapExpression), &environment.symbols());
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    auto consume = [&](const double* values, size_t count) {
+        if (fold) {
+            fold->add(values, count);
+        } else {
+            stats.add(values, count);
+        }
+    };
+    NumberReader reader(std::cin);
+    StreamErrors failures;
+    try {
+        if (mapExpression) {
+            failures = mapBlocks(mapProgram, environment, environment.slot("x"), reader, consume);
+        } else {
+            std::vector<double> values(MAP_BLOCK_NUMBERS);
+            while (size_t count = reader.read(values.data(), values.size())) consume(values.data(), count);
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    const double result = fold ? fold->value() : stats.value(aggregate);
+    {
+        NumberWriter writer(std::cout);
+        writer.write(&result, 1);
+    }
+    std::cout.flush();
+    bool ok = reportStreamErrors("invalid number(s)", reader.errors());
+    ok = reportStreamErrors("failed evaluation(s)", failures) && ok;
+    return ok ? 0 : 1;
+}
+
+// --csv: evaluates `expression` for every row of the CSV file open in `in`
+// (past its header line `header`), with columns bound by name, and writes
+// the rows with a result column to stdout. Returns the exit status.
+int mapCsvFile(std::string_view expression, const Environment& environment, const std::string& header,
+               std::istream& in, unsigned threads) {
+    PostfixProgram program;
+    try {
+        program = compilePostfix(tokenizer(expression), &environment.symbols());
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    CsvOptions options;
+    options.threads = threads != 0 ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> fieldSlots;
+    for (const std::string& name : csvColumnNames(header, options.delimiter)) {
+        fieldSlots.push_back(environment.symbols().find(name));
+    }
+    StreamErrors problems;
+    try {
+        problems = mapCsv(program, environment, fieldSlots, header, in, std::cout, options);
+    } catch (const std::runtime_error& e) {
+        std::cout.flush();
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout.flush();
+    return reportStreamErrors("problem(s)", problems, "row") ? 0 : 1;
+}
+
+// Splits a --npy binding of the form name=path. Throws a runtime error if
+// it is malformed.
+std::pair<std::string, std::string> splitNpyBinding(const std::string& binding) {
+    size_t equals = binding.find('=');
+    if (equals == std::string::npos || equals == 0 || equals + 1 == binding.size()) {
+        throw std::runtime_error("Invalid .npy binding '" + binding + "' (expected name=path)");
+    }
+    return {binding.substr(0, equals), binding.substr(equals + 1)};
+}
+
+// --npy-out: evaluates `expression` over the --npy columns and writes the
+// results to `outputPath`. Returns the exit status.
+int evaluateNpyFiles(std::string_view expression, const Environment& environment,
+                     const std::vector<std::string>& bindings, const std::string& outputPath) {
+    try {
+        const PostfixProgram program = compilePostfix(tokenizer(expression), &environment.symbols());
+        std::vector<std::unique_ptr<NpyArray>> files;
+        std::vector<const NpyArray*> arrays(environment.size(), nullptr);
+        std::string firstPath;
+        for (const std::string& binding : bindings) {
+            auto [name, path] = splitNpyBinding(binding);
+            files.push_back(std::make_unique<NpyArray>(path));
+            if (files.size() == 1) firstPath = path;
+            if (files.back()->size() != files.front()->size()) {
+                throw std::runtime_error("Length mismatch: " + path + " has " + std::to_string(files.back()->size()) +
+                                         " elements, " + firstPath + " has " + std::to_string(files.front()->size()));
+            }
+            arrays[environment.slot(name)] = files.back().get();
+        }
+
+        const size_t count = files.front()->size();
+        NpyWriter writer(outputPath, count);
+        StreamErrors failures = evaluateNpy(program, environment, arrays, count, writer.data());
+        writer.finish();
+        return reportStreamErrors("failed evaluation(s)", failures, "element") ? 0 : 1;
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// Writes the trace file if --trace was given. Returns false on failure.
+bool writeTrace(const std::string& path) {
+    if (path.empty()) return true;
+    if (!writeChromeTrace(path)) {
+        std::cerr << "Could not write trace file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
 
 int main(int argc, char **argv) { // Standard main function
+    uint64_t startNanoseconds = nowNanoseconds();
+    AllocationCounter cliAllocations;
+
     CLI::App app{"Mathematical expression parser and evaluator"};
 
     std::string_view expression; // Variable to hold the expression
-    app.add_option("-e,--expression", expression, "Mathematical Expression to evaluate")
-        ->required();
+    std::string_view mapExpression;
+    std::string csvPath;
+    std::vector<std::string> npyBindings;
+    std::string npyOutputPath;
+    unsigned threads = 0;
+    std::string_view reduction;
+    double reduceInitial = 0;
+    bool batch = false;
+    bool profile = false;
+    bool perfCounters = false;
+    bool latency = false;
+    double latencyInterval = 0;
+    std::string tracePath;
+    std::string capturePath;
+    std::vector<std::string> variableDefinitions;
+    double fastMath = 0;
+    bool strictPow = false;
+    auto expressionOption = app.add_option("-e,--expression,--expr", expression, "Mathematical Expression to evaluate");
+    auto batchOption = app.add_flag("-b,--batch", batch, "Evaluate one expression per line from stdin");
+    auto mapOption = app.add_option("--map", mapExpression,
+                                    "Evaluate this expression for every number on stdin, bound to x, one result per line");
+    auto csvOption = app.add_option("--csv", csvPath,
+                                    "Evaluate the expression for every row of this CSV file, with columns as "
+                                    "variables, and write the rows with a result column");
+    app.add_option("--threads", threads, "Worker threads for --csv (default: one per CPU)")->needs(csvOption);
+    auto npyOption = app.add_option("--npy", npyBindings,
+                                    "Bind a variable to a column stored in a .npy file, as name=path (repeatable)");
+    auto npyOutOption = app.add_option("--npy-out", npyOutputPath,
+                                       "Evaluate the expression over the --npy columns into this .npy file");
+    auto reduceOption = app.add_option("--reduce", reduction,
+                                       "Reduce every number on stdin (or --map result) by sum, min, max, mean or var, "
+                                       "or by an expression over acc and x");
+    app.add_option("--reduce-init", reduceInitial, "Initial acc of a --reduce expression (default 0)")
+        ->needs(reduceOption);
+    app.add_flag("--profile", profile, "Report per-phase wall time and allocations on stderr");
+    app.add_flag("--latency", latency, "In batch mode, report per-expression latency percentiles on stderr");
+    app.add_option("--latency-interval", latencyInterval,
+                   "In batch mode, also report latency percentiles every this many seconds")
+        ->check(CLI::PositiveNumber);
+    app.add_option("--trace", tracePath, "Write a Chrome/Perfetto trace-event JSON file of every phase");
+    app.add_option("--capture", capturePath, "Record every expression, its timestamp and result to a binary workload log");
+    app.add_flag("--perf-counters", perfCounters, "Report hardware counters (IPC, branch and cache misses) on stderr");
+    app.add_option("--var", variableDefinitions, "Define a variable for the expressions, as name=value (repeatable)");
+    app.add_option("--fast-math", fastMath,
+                   "Approximate exp, log, sin, cos, tan and pow ('^') within this relative error (1e-7 or 1e-12)")
+        ->check(CLI::PositiveNumber);
+    app.add_flag("--strict-pow", strictPow, "Compute every '^' with pow, also for small integer exponents");
+    expressionOption->excludes(batchOption);
+    mapOption->excludes(expressionOption)->excludes(batchOption);
+    reduceOption->excludes(expressionOption)->excludes(batchOption);
+    csvOption->needs(expressionOption)->excludes(batchOption)->excludes(mapOption)->excludes(reduceOption);
+    npyOption->needs(npyOutOption);
+    npyOutOption->needs(npyOption)->needs(expressionOption)->excludes(batchOption)->excludes(mapOption);
+    npyOutOption->excludes(reduceOption)->excludes(csvOption);
 
     try {
         app.parse(argc, argv); // Explicitly call parse
+        if (!batch && expressionOption->count() == 0 && mapOption->count() == 0 && reduceOption->count() == 0) {
+            throw CLI::RequiredError("--expression");
+        }
     } catch (const CLI::ParseError &e) {
         // Handle errors explicitly
         return app.exit(e);
     }
 
-    // Use parsed value
-    std::vector<Token> tokenized_exp = tokenizer(expression); // Call the tokenizer function with the expression
+    if (!tracePath.empty()) {
+        enableTracing();
+    }
+
+    PhaseProfiler profiler(profile);
+    profiler.record(Phase::CLI_PARSE, startNanoseconds, nowNanoseconds(), cliAllocations.elapsed());
 
-    double answer = calculate(tokenized_exp); // Call the shunting yard algorithm with the tokenized expression
-    std::cout << expression << " = " << answer << std::endl;
+    std::unique_ptr<PerfReport> perf;
+    if (perfCounters) {
+        perf = std::make_unique<PerfReport>();
+    }
+
+    std::ifstream csvFile;
+    std::string csvHeader;
+    if (csvOption->count()) {
+        csvFile.open(csvPath, std::ios::binary);
+        if (!csvFile || !std::getline(csvFile, csvHeader)) {
+            std::cerr << "Could not read CSV file: " << csvPath << std::endl;
+            return 1;
+        }
+        if (!csvHeader.empty() && csvHeader.back() == '\r') csvHeader.pop_back();
+    }
+
+    Environment environment;
+    try {
+        if (fastMath > 0) setMathAccuracy(mathAccuracyFor(fastMath));
+        setStrictPower(strictPow);
+        std::vector<std::string> boundNames;
+        Aggregate aggregate;
+        const bool fold = reduceOption->count() && !findAggregate(reduction, aggregate);
+        if (mapOption->count() || fold) boundNames.push_back("x");
+        if (fold) boundNames.push_back("acc");
+        for (const std::string& binding : npyBindings) boundNames.push_back(splitNpyBinding(binding).first);
+        if (csvOption->count()) {
+            for (const std::string& name : csvColumnNames(csvHeader, CsvOptions().delimiter)) {
+                if (isIdentifier(name)) boundNames.push_back(name);
+            }
+        }
+        environment = parseVariables(variableDefinitions, boundNames);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // The log records the variables, math accuracy and power mode so a
+    // replay evaluates like this run.
+    std::unique_ptr<WorkloadWriter> capture;
+    if (!capturePath.empty()) {
+        WorkloadSettings settings;
+        for (uint32_t slot = 0; slot < environment.size(); ++slot) {
+            settings.variables.emplace_back(environment.symbols().name(slot), environment[slot]);
+        }
+        settings.accuracy = mathAccuracy();
+        settings.strictPower = strictPowerEnabled;
+        try {
+            capture = std::make_unique<WorkloadWriter>(capturePath, settings);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (npyOutOption->count()) {
+        int status = evaluateNpyFiles(expression, environment, npyBindings, npyOutputPath);
+        profiler.report(std::cerr, false);
+        return writeTrace(tracePath) ? status : 1;
+    }
+
+    if (csvOption->count()) {
+        int status = mapCsvFile(expression, environment, csvHeader, csvFile, threads);
+        profiler.report(std::cerr, false);
+        return writeTrace(tracePath) ? status : 1;
+    }
+
+    if (reduceOption->count() || mapOption->count()) {
+        int status = reduceOption->count()
+                         ? reduceStdin(reduction, mapOption->count() ? &mapExpression : nullptr, reduceInitial,
+                                       environment)
+                         : mapStdin(mapExpression, environment);
+        profiler.report(std::cerr, false);
+        return writeTrace(tracePath) ? status : 1;
+    }
+
+    EvaluationHooks hooks{profiler, perf.get(), capture.get(), nowNanoseconds(), !batch, &environment};
+
+    if (!batch) {
+        // Use parsed value
+        evaluateExpression(expression, hooks);
+        profiler.report(std::cerr, false);
+        if (perf) perf->report(std::cerr);
+        return writeTrace(tracePath) ? 0 : 1;
+    }
+
+    // Batch mode: report errors per line and keep going. End-to-end latency
+    // (tokenize, calculate and output) is always recorded; it is cheap.
+    ThreadLatencyHistograms latencies;
+    LatencyHistogram& latencyHistogram = latencies.local();
+    const uint64_t intervalNanoseconds = static_cast<uint64_t>(latencyInterval * 1e9);
+    uint64_t nextReport = nowNanoseconds() + intervalNanoseconds;
+
+    int status = 0;
+    std::string line;
+    while (traced("read", [&] { return static_cast<bool>(std::getline(std::cin, line)); })) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        uint64_t start = nowNanoseconds();
+        try {
+            evaluateExpression(line, hooks);
+        } catch (const std::exception& e) {
+            traced("output", [&] { std::cout << line << " = error: " << e.what() << '\n'; });
+            status = 1;
+        }
+        uint64_t end = nowNanoseconds();
+        latencyHistogram.record(end - start);
+
+        if (intervalNanoseconds && end >= nextReport) {
+            std::cerr << "latency: ";
+            latencies.merged().printPercentiles(std::cerr);
+            std::cerr << std::endl;
+            nextReport = end + intervalNanoseconds;
+        }
+    }
+    std::cout.flush();
+    if (capture) capture->flush();
+    if (latency || intervalNanoseconds) {
+        std::cerr << "latency: ";
+        latencies.merged().printPercentiles(std::cerr);
+        std::cerr << '\n';
+    }
+    profiler.report(std::cerr, true);
+    if (perf) perf->report(std::cerr);
+    if (!writeTrace(tracePath)) status = 1;
 
-    return 0;
+    return status;
 }
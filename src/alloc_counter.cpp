@@ -0,0 +1,96 @@
+#include "alloc_counter.h"
+#include <cstdlib>
+#include <new>
+
+// With ALLOC_COUNTER_ENABLED, replaces the global allocation functions so
+// every heap allocation in the process is counted. Counting is per thread
+// and needs no synchronization.
+
+#ifdef ALLOC_COUNTER_ENABLED
+
+namespace {
+
+thread_local AllocationStats threadStats;
+
+void* allocate(std::size_t size) {
+    ++threadStats.count;
+    threadStats.bytes += size;
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* ptr = std::malloc(size)) return ptr;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* allocateAligned(std::size_t size, std::align_val_t alignment) {
+    ++threadStats.count;
+    threadStats.bytes += size;
+    std::size_t align = static_cast<std::size_t>(alignment);
+    if (align < sizeof(void*)) align = sizeof(void*);
+    // aligned_alloc wants a size that is a multiple of the alignment.
+    std::size_t rounded = (size + align - 1) / align * align;
+    if (rounded == 0) rounded = align;
+    while (true) {
+        if (void* ptr = std::aligned_alloc(align, rounded)) return ptr;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+}  // namespace
+
+bool allocationCountingEnabled() {
+    return true;
+}
+
+// Returns the allocations made by the calling thread so far.
+AllocationStats threadAllocationStats() {
+    return threadStats;
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try { return allocateAligned(size, alignment); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try { return allocateAligned(size, alignment); } catch (...) { return nullptr; }
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+
+#else
+
+bool allocationCountingEnabled() {
+    return false;
+}
+
+// Nothing is counted without the replaced allocation functions.
+AllocationStats threadAllocationStats() {
+    return AllocationStats{};
+}
+
+#endif
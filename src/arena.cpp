@@ -0,0 +1,135 @@
+#include "arena.h"
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+char* alignPointer(char* ptr, size_t alignment) {
+    return reinterpret_cast<char*>(alignUp(reinterpret_cast<uintptr_t>(ptr), alignment));
+}
+
+}  // namespace
+
+// Creates an empty arena. No memory is reserved until the first allocation.
+Arena::Arena(ArenaOptions options) : options_(options) {
+    if (options_.blockSize < HEADER_SIZE + ALIGNMENT) {
+        options_.blockSize = HEADER_SIZE + ALIGNMENT;
+    }
+}
+
+// Returns every block to the system.
+Arena::~Arena() {
+    Block* block = first_;
+    while (block) {
+        Block* next = block->next;
+        freeBlock(block);
+        block = next;
+    }
+}
+
+// Bumps the cursor, moving to a new block when the current one is full.
+void* Arena::allocate(size_t size, size_t alignment) {
+    if (alignment < ALIGNMENT) alignment = ALIGNMENT;
+    char* start = alignPointer(cursor_, alignment);
+    if (!cursor_ || start + size > limit_) {
+        advance(size, alignment);
+        start = alignPointer(cursor_, alignment);
+    }
+    cursor_ = start + size;
+    bytesUsed_ += size;
+    return start;
+}
+
+// Rewinds to the first block; all earlier allocations become invalid.
+void Arena::reset() {
+    current_ = first_;
+    cursor_ = first_ ? reinterpret_cast<char*>(first_) + HEADER_SIZE : nullptr;
+    limit_ = first_ ? reinterpret_cast<char*>(first_) + first_->size : nullptr;
+    bytesUsed_ = 0;
+}
+
+// Moves to the next block that can hold the request, allocating one if the
+// retained blocks are all too small.
+void Arena::advance(size_t size, size_t alignment) {
+    size_t needed = HEADER_SIZE + size + alignment;
+    Block* previous = current_;
+    Block* candidate = current_ ? current_->next : first_;
+
+    if (!candidate || candidate->size < needed) {
+        Block* block = newBlock(needed);
+        // Splice the new block in after the current one so reused blocks
+        // further down the chain are still found after a reset.
+        if (previous) {
+            block->next = previous->next;
+            previous->next = block;
+        } else {
+            block->next = first_;
+            first_ = block;
+        }
+        candidate = block;
+    }
+
+    current_ = candidate;
+    cursor_ = reinterpret_cast<char*>(candidate) + HEADER_SIZE;
+    limit_ = reinterpret_cast<char*>(candidate) + candidate->size;
+}
+
+// Obtains a block of at least `minimumSize` bytes from the system.
+Arena::Block* Arena::newBlock(size_t minimumSize) {
+    size_t size = minimumSize > options_.blockSize ? minimumSize : options_.blockSize;
+    void* memory = nullptr;
+    bool mapped = false;
+
+#ifdef __linux__
+    if (options_.hugePages && size >= HUGE_PAGE_SIZE) {
+        size = alignUp(size, HUGE_PAGE_SIZE);
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED) {
+            // No reserved huge pages: ask for transparent huge pages instead.
+            memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory != MAP_FAILED) {
+                madvise(memory, size, MADV_HUGEPAGE);
+            }
+        }
+        if (memory == MAP_FAILED) {
+            memory = nullptr;
+        } else {
+            mapped = true;
+        }
+    }
+#endif
+
+    if (!memory) {
+        memory = std::aligned_alloc(ALIGNMENT, alignUp(size, ALIGNMENT));
+        if (!memory) throw std::bad_alloc();
+    }
+
+    Block* block = static_cast<Block*>(memory);
+    block->next = nullptr;
+    block->size = size;
+    block->mapped = mapped;
+    bytesReserved_ += size;
+    return block;
+}
+
+// Returns a block to the system.
+void Arena::freeBlock(Block* block) {
+#ifdef __linux__
+    if (block->mapped) {
+        munmap(block, block->size);
+        return;
+    }
+#endif
+    std::free(block);
+}
@@ -0,0 +1,238 @@
+#include "ast.h"
+#include "functions.h"
+#include "power.h"
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Applies a binary operator to two values.
+double applyBinary(OpCode op, double op1, double op2) {
+    switch (op) {
+        case OpCode::ADD:      return op1 + op2;
+        case OpCode::SUBTRACT: return op1 - op2;
+        case OpCode::MULTIPLY: return op1 * op2;
+        case OpCode::DIVIDE:
+            if (op2 == 0) {
+                throw std::runtime_error("Math Error: Division by zero");
+            }
+            return op1 / op2;
+        case OpCode::POWER:    return power(op1, op2);
+        default:
+            throw std::runtime_error(std::string("Syntax Error: Unknown operator ") + opCodeToChar(op));
+    }
+}
+
+// Builds tree nodes into a preallocated array, in post-order.
+class TreeBuilder {
+public:
+    explicit TreeBuilder(ExprNode* nodes) : nodes_(nodes) {}
+
+    void pushNumber(double value) {
+        ExprNode* node = nodes_ + count_++;
+        *node = ExprNode{nullptr, nullptr, value, NodeKind::NUMBER, OpCode::NONE, 0};
+        push(node);
+    }
+
+    void pushVariable(uint32_t slot) {
+        ExprNode* node = nodes_ + count_++;
+        *node = ExprNode{nullptr, nullptr, 0, NodeKind::VARIABLE, OpCode::NONE, slot};
+        if (slot >= variableCount_) variableCount_ = slot + 1;
+        push(node);
+    }
+
+    void applyOperator(const Token& operatorToken) {
+        if (operands_.size() < 2) {
+            throw std::runtime_error("Syntax Error: Insufficient operands for operator " +
+                                     std::string(operatorToken.value));
+        }
+        const ExprNode* right = operands_.back(); operands_.pop_back();
+        const ExprNode* left = operands_.back(); operands_.pop_back();
+        ExprNode* node = nodes_ + count_++;
+        *node = ExprNode{left, right, 0, NodeKind::BINARY, opCodeFromChar(operatorToken.value[0]), 0};
+        push(node);
+    }
+
+    void applyCall(uint32_t function, size_t arguments) {
+        if (arguments != functionInfo(function).arity || operands_.size() < arguments) {
+            throw std::runtime_error(argumentCountMessage(function, arguments));
+        }
+        const ExprNode* right = nullptr;
+        if (arguments == 2) {
+            right = operands_.back(); operands_.pop_back();
+        }
+        const ExprNode* left = operands_.back(); operands_.pop_back();
+        ExprNode* node = nodes_ + count_++;
+        *node = ExprNode{left, right, 0, NodeKind::CALL, OpCode::NONE, function};
+        push(node);
+    }
+
+    size_t operandCount() const { return operands_.size(); }
+    size_t nodeCount() const { return count_; }
+    size_t maxDepth() const { return maxDepth_; }
+    size_t variableCount() const { return variableCount_; }
+
+private:
+    void push(const ExprNode* node) {
+        operands_.push_back(node);
+        if (operands_.size() > maxDepth_) maxDepth_ = operands_.size();
+    }
+
+    ExprNode* nodes_;
+    size_t count_ = 0;
+    size_t maxDepth_ = 0;
+    size_t variableCount_ = 0;
+    std::vector<const ExprNode*> operands_;
+};
+
+}  // namespace
+
+// Parses tokens into a contiguous post-order tree using the shunting-yard
+// algorithm: nodes are emitted exactly when `calculate()` would evaluate them.
+// Calls and their commas sit on the operator stack as in `calculate()`.
+ExprTree parseExpressionTree(const std::vector<Token>& tokens, Arena& arena, const SymbolTable* symbols) {
+    if (tokens.empty()) {
+        throw std::runtime_error("Evaluation Error: Empty expression");
+    }
+
+    // A tree never has more nodes than there are tokens.
+    ExprNode* nodes = arena.allocateArray<ExprNode>(tokens.size());
+    TreeBuilder builder(nodes);
+    std::vector<const Token*> operatorStack;
+    std::vector<uint32_t> callStack;  // FunctionIds of the open calls.
+
+    TokenType previous = TokenType::UNKNOWN;
+    for (const auto& token : tokens) {
+        if (token.type == TokenType::NUMBER) {
+            builder.pushNumber(tokenNumber(token));
+        } else if (token.type == TokenType::IDENTIFIER) {
+            uint32_t slot = symbols ? symbols->find(token.value) : SymbolTable::NO_SLOT;
+            if (slot == SymbolTable::NO_SLOT) {
+                throw std::runtime_error("Evaluation Error: Unknown variable " + std::string(token.value));
+            }
+            builder.pushVariable(slot);
+        } else if (token.type == TokenType::LEFT_PAREN) {
+            operatorStack.push_back(&token);
+        } else if (token.type == TokenType::FUNCTION) {
+            uint32_t function = findFunction(token.value);
+            if (function == NO_FUNCTION) {
+                throw std::runtime_error("Syntax Error: Unknown function " + std::string(token.value));
+            }
+            callStack.push_back(function);
+            operatorStack.push_back(&token);
+        } else if (token.type == TokenType::COMMA) {
+            if (previous == TokenType::FUNCTION || previous == TokenType::COMMA) {
+                throw std::runtime_error("Syntax Error: Empty function argument");
+            }
+            while (!operatorStack.empty() && operatorStack.back()->type == TokenType::OPERATOR) {
+                builder.applyOperator(*operatorStack.back());
+                operatorStack.pop_back();
+            }
+            if (operatorStack.empty() || (operatorStack.back()->type != TokenType::FUNCTION &&
+                                          operatorStack.back()->type != TokenType::COMMA)) {
+                throw std::runtime_error("Syntax Error: Unexpected ',' outside a function call");
+            }
+            operatorStack.push_back(&token);
+        } else if (token.type == TokenType::RIGHT_PAREN) {
+            if (previous == TokenType::COMMA) {
+                throw std::runtime_error("Syntax Error: Empty function argument");
+            }
+
+            size_t commas = 0;
+            while (!operatorStack.empty() && (operatorStack.back()->type == TokenType::OPERATOR ||
+                                              operatorStack.back()->type == TokenType::COMMA)) {
+                if (operatorStack.back()->type == TokenType::COMMA) {
+                    ++commas;
+                } else {
+                    builder.applyOperator(*operatorStack.back());
+                }
+                operatorStack.pop_back();
+            }
+
+            if (operatorStack.empty()) {
+                throw std::runtime_error("Syntax Error: Mismatched parentheses (missing '(').");
+            }
+
+            if (operatorStack.back()->type == TokenType::FUNCTION) {
+                builder.applyCall(callStack.back(), previous == TokenType::FUNCTION ? 0 : commas + 1);
+                callStack.pop_back();
+            }
+            operatorStack.pop_back();
+        } else if (token.type == TokenType::OPERATOR) {
+            while (!operatorStack.empty() &&
+                   operatorStack.back()->type == TokenType::OPERATOR &&
+                   ((operatorStack.back()->precedence > token.precedence) ||
+                    (operatorStack.back()->precedence == token.precedence && token.isLeftAssociative))) {
+                builder.applyOperator(*operatorStack.back());
+                operatorStack.pop_back();
+            }
+
+            operatorStack.push_back(&token);
+        } else {
+            throw std::runtime_error("Syntax Error: Unknown token type encountered.");
+        }
+        previous = token.type;
+    }
+
+    while (!operatorStack.empty()) {
+        if (operatorStack.back()->type != TokenType::OPERATOR) {
+            throw std::runtime_error("Syntax Error: Mismatched parentheses at end of expression.");
+        }
+        builder.applyOperator(*operatorStack.back());
+        operatorStack.pop_back();
+    }
+
+    if (builder.operandCount() != 1) {
+        throw std::runtime_error("Evaluation Error: Operand stack malformed at end of calculation.");
+    }
+
+    ExprTree tree;
+    tree.nodes = nodes;
+    tree.nodeCount = builder.nodeCount();
+    tree.maxDepth = builder.maxDepth();
+    tree.variableCount = builder.variableCount();
+    return tree;
+}
+
+// Evaluates a tree with one forward pass over its post-ordered nodes; the
+// operand stack lives on the C++ stack unless the tree is unusually deep.
+double evaluate(const ExprTree& tree, const double* variables) {
+    if (tree.nodeCount == 0) {
+        throw std::runtime_error("Evaluation Error: Empty expression");
+    }
+    if (tree.variableCount > 0 && variables == nullptr) {
+        throw std::runtime_error("Evaluation Error: No values given for the expression's variables");
+    }
+
+    const size_t INLINE_DEPTH = 64;
+    double inlineStack[INLINE_DEPTH] = {};
+    std::vector<double> deepStack;
+    double* stack = inlineStack;
+    if (tree.maxDepth > INLINE_DEPTH) {
+        deepStack.resize(tree.maxDepth);
+        stack = deepStack.data();
+    }
+
+    size_t top = 0;
+    const ExprNode* end = tree.nodes + tree.nodeCount;
+    for (const ExprNode* node = tree.nodes; node != end; ++node) {
+        if (node->kind == NodeKind::NUMBER) {
+            stack[top++] = node->value;
+        } else if (node->kind == NodeKind::VARIABLE) {
+            stack[top++] = variables[node->slot];
+        } else if (node->kind == NodeKind::CALL) {
+            const FunctionInfo& function = functionInfo(node->slot);
+            if (function.arity == 1) {
+                stack[top - 1] = function.unary(stack[top - 1]);
+            } else {
+                --top;
+                stack[top - 1] = function.binary(stack[top - 1], stack[top]);
+            }
+        } else {
+            --top;
+            stack[top - 1] = applyBinary(node->op, stack[top - 1], stack[top]);
+        }
+    }
+
+    return stack[0];
+}
@@ -1,18 +1,28 @@
 #include "calculator.h"
+#include "functions.h"
+#include "power.h"
+#include <deque>
 
-// Applies an operator to the top two operands on the stack.
+namespace {
+
+// Applies an operator to the top two operands on the stack. Templated on the
+// stack type so the std::pmr overloads share the implementation.
 // Throws a runtime error if there are insufficient operands for an operator
 // or if the operator is invalid.
-void applyOperation(std::stack<double>& operandStack, const Token& operatorToken) {
+template <typename OperandStack>
+void applyOperationTo(OperandStack& operandStack, const Token& operatorToken) {
     if (operandStack.size() < 2) {
-        throw std::runtime_error("Syntax Error: Insufficient operands for operator " + operatorToken.value);
+        throw std::runtime_error("Syntax Error: Insufficient operands for operator " +
+                                 std::string(operatorToken.value));
     }
 
     // Pop the top two operands.
     double op2 = operandStack.top(); operandStack.pop();
     double op1 = operandStack.top(); operandStack.pop();
 
-    // Perform the operation based on the operator.
+    // Perform the operation based on the operator. A chain on the character
+    // measures faster here than dispatching to the operator kernels (see the
+    // `kernels` benchmark).
     char op_char = operatorToken.value[0];
     if (op_char == '+') {
         operandStack.push(op1 + op2);
@@ -26,51 +36,118 @@ void applyOperation(std::stack<double>& operandStack, const Token& operatorToken
         }
         operandStack.push(op1 / op2);
     } else if (op_char == '^') {
-        operandStack.push(std::pow(op1, op2));
+        operandStack.push(power(op1, op2));
     } else {
-        throw std::runtime_error("Syntax Error: Unknown operator " + operatorToken.value);
+        throw std::runtime_error("Syntax Error: Unknown operator " + std::string(operatorToken.value));
     }
 }
 
-// Evaluates a mathematical expression represented as a vector of tokens.
-// Returns the computed result as a double.
-// Throws runtime errors for syntax or evaluation issues (e.g., mismatched parentheses).
-double calculate(const std::vector<Token>& tokenized_expression) {
-    std::stack<double> operandStack;  // Stack for operands (numbers).
-    std::stack<Token> operatorStack; // Stack for operators and parentheses.
+// Applies the function opened by `callToken` to the top `arguments`
+// operands on the stack. Throws a runtime error for a wrong argument count.
+template <typename OperandStack>
+void applyCallTo(OperandStack& operandStack, const Token& callToken, size_t arguments) {
+    uint32_t id = findFunction(callToken.value);
+    const FunctionInfo& function = functionInfo(id);
+    if (arguments != function.arity || operandStack.size() < arguments) {
+        throw std::runtime_error(argumentCountMessage(id, arguments));
+    }
 
+    double last = operandStack.top(); operandStack.pop();
+    if (function.arity == 1) {
+        operandStack.push(function.unary(last));
+    } else {
+        double first = operandStack.top(); operandStack.pop();
+        operandStack.push(function.binary(first, last));
+    }
+}
+
+// Evaluates a tokenized expression with the given operand stack (numbers)
+// and operator stack (operators, parentheses, calls and commas).
+// Throws runtime errors for syntax or evaluation issues (e.g., mismatched parentheses).
+// Identifiers are read from `environment`, which may be null. A call's
+// FUNCTION token stays on the operator stack like a '(' with the call's
+// commas above it, so the ')' counts the arguments.
+template <typename TokenRange, typename OperandStack, typename OperatorStack>
+double calculateTokens(const TokenRange& tokenized_expression,
+                       OperandStack& operandStack,
+                       OperatorStack& operatorStack,
+                       const Environment* environment) {
     if (tokenized_expression.empty()) {
         throw std::runtime_error("Evaluation Error: Empty expression");
     }
 
+    TokenType previous = TokenType::UNKNOWN;
     for (const auto& token : tokenized_expression) {
         if (token.type == TokenType::NUMBER) {
             // Push numbers directly onto the operand stack.
-            operandStack.push(std::stod(token.value));
+            operandStack.push(tokenNumber(token));
+        } else if (token.type == TokenType::IDENTIFIER) {
+            // Look the variable up by name.
+            if (environment == nullptr) {
+                throw std::runtime_error("Evaluation Error: Unknown variable " + std::string(token.value));
+            }
+            operandStack.push((*environment)[environment->slot(token.value)]);
         } else if (token.type == TokenType::LEFT_PAREN) {
             // Push left parentheses onto the operator stack.
             operatorStack.push(token);
+        } else if (token.type == TokenType::FUNCTION) {
+            // Open a call; it acts as a left parenthesis.
+            if (findFunction(token.value) == NO_FUNCTION) {
+                throw std::runtime_error("Syntax Error: Unknown function " + std::string(token.value));
+            }
+            operatorStack.push(token);
+        } else if (token.type == TokenType::COMMA) {
+            // Finish an argument: apply its operators, then mark it.
+            if (previous == TokenType::FUNCTION || previous == TokenType::COMMA) {
+                throw std::runtime_error("Syntax Error: Empty function argument");
+            }
+            while (!operatorStack.empty() && operatorStack.top().type == TokenType::OPERATOR) {
+                applyOperationTo(operandStack, operatorStack.top());
+                operatorStack.pop();
+            }
+            if (operatorStack.empty() || (operatorStack.top().type != TokenType::FUNCTION &&
+                                          operatorStack.top().type != TokenType::COMMA)) {
+                throw std::runtime_error("Syntax Error: Unexpected ',' outside a function call");
+            }
+            operatorStack.push(token);
         } else if (token.type == TokenType::RIGHT_PAREN) {
-            // Process operators until a matching left parenthesis is found.
-            while (!operatorStack.empty() && operatorStack.top().type != TokenType::LEFT_PAREN) {
-                applyOperation(operandStack, operatorStack.top());
+            if (previous == TokenType::COMMA) {
+                throw std::runtime_error("Syntax Error: Empty function argument");
+            }
+
+            // Process operators (counting a call's commas) until a matching
+            // left parenthesis or call is found.
+            size_t commas = 0;
+            while (!operatorStack.empty() && (operatorStack.top().type == TokenType::OPERATOR ||
+                                              operatorStack.top().type == TokenType::COMMA)) {
+                if (operatorStack.top().type == TokenType::COMMA) {
+                    ++commas;
+                } else {
+                    applyOperationTo(operandStack, operatorStack.top());
+                }
                 operatorStack.pop();
             }
 
             // Ensure a matching left parenthesis exists.
-            if (operatorStack.empty() || operatorStack.top().type != TokenType::LEFT_PAREN) {
+            if (operatorStack.empty()) {
                 throw std::runtime_error("Syntax Error: Mismatched parentheses (missing '(').");
             }
 
-            // Pop the left parenthesis.
-            operatorStack.pop();
+            // Pop the left parenthesis, or make the call.
+            if (operatorStack.top().type == TokenType::FUNCTION) {
+                Token callToken = std::move(operatorStack.top());
+                operatorStack.pop();
+                applyCallTo(operandStack, callToken, previous == TokenType::FUNCTION ? 0 : commas + 1);
+            } else {
+                operatorStack.pop();
+            }
         } else if (token.type == TokenType::OPERATOR) {
             // Process operators based on precedence and associativity.
             while (!operatorStack.empty() &&
                    operatorStack.top().type == TokenType::OPERATOR &&
                    ((operatorStack.top().precedence > token.precedence) ||
                     (operatorStack.top().precedence == token.precedence && token.isLeftAssociative))) {
-                applyOperation(operandStack, operatorStack.top());
+                applyOperationTo(operandStack, operatorStack.top());
                 operatorStack.pop();
             }
 
@@ -79,14 +156,15 @@ double calculate(const std::vector<Token>& tokenized_expression) {
         } else {
             throw std::runtime_error("Syntax Error: Unknown token type encountered.");
         }
+        previous = token.type;
     }
 
     // Process remaining operators in the stack.
     while (!operatorStack.empty()) {
-        if (operatorStack.top().type == TokenType::LEFT_PAREN || operatorStack.top().type == TokenType::RIGHT_PAREN) {
+        if (operatorStack.top().type != TokenType::OPERATOR) {
             throw std::runtime_error("Syntax Error: Mismatched parentheses at end of expression.");
         }
-        applyOperation(operandStack, operatorStack.top());
+        applyOperationTo(operandStack, operatorStack.top());
         operatorStack.pop();
     }
 
@@ -97,3 +175,286 @@ double calculate(const std::vector<Token>& tokenized_expression) {
 
     return operandStack.top();
 }
+
+}  // namespace
+
+// Applies an operator to the top two operands on the stack.
+// Throws a runtime error if there are insufficient operands for an operator
+// or if the operator is invalid.
+void applyOperation(std::stack<double>& operandStack, const Token& operatorToken) {
+    applyOperationTo(operandStack, operatorToken);
+}
+
+// Evaluates a mathematical expression represented as a vector of tokens.
+// Returns the computed result as a double.
+// Throws runtime errors for syntax or evaluation issues (e.g., mismatched parentheses).
+double calculate(const std::vector<Token>& tokenized_expression) {
+    std::stack<double> operandStack;  // Stack for operands (numbers).
+    std::stack<Token> operatorStack; // Stack for operators and parentheses.
+    return calculateTokens(tokenized_expression, operandStack, operatorStack, nullptr);
+}
+
+// Evaluates a vector of tokens whose identifiers are bound in `environment`.
+double calculate(const std::vector<Token>& tokenized_expression, const Environment& environment) {
+    std::stack<double> operandStack;
+    std::stack<Token> operatorStack;
+    return calculateTokens(tokenized_expression, operandStack, operatorStack, &environment);
+}
+
+// Evaluates a vector of tokens with both stacks allocated from `resource`.
+double calculate(const std::pmr::vector<Token>& tokenized_expression, std::pmr::memory_resource* resource) {
+    std::stack<double, std::pmr::deque<double>> operandStack{std::pmr::deque<double>(resource)};
+    std::stack<Token, std::pmr::vector<Token>> operatorStack{std::pmr::vector<Token>(resource)};
+    return calculateTokens(tokenized_expression, operandStack, operatorStack, nullptr);
+}
+
+namespace {
+
+// Fills `result` with an error and returns false, so failures read as
+// `return fail(result, ...)` in the evaluator below.
+bool fail(EvalResult& result, EvalError error, uint32_t offset, char symbol = 0) {
+    result.error = error;
+    result.offset = offset;
+    result.symbol = symbol;
+    return false;
+}
+
+// Applies the operator at token `index` to the top two operands of a
+// vector-backed stack. Returns false and fills `result` on error.
+bool applyOpCode(const TokenBuffer& tokens, uint32_t index,
+                 std::pmr::vector<double>& operands, EvalResult& result) {
+    OpCode op = tokens.opCodes[index];
+    if (operands.size() < 2) {
+        return fail(result, EvalError::INSUFFICIENT_OPERANDS, tokens.offsets[index], opCodeToChar(op));
+    }
+
+    double op2 = operands.back(); operands.pop_back();
+    double& op1 = operands.back();
+
+    switch (op) {
+        case OpCode::ADD:      op1 = op1 + op2; break;
+        case OpCode::SUBTRACT: op1 = op1 - op2; break;
+        case OpCode::MULTIPLY: op1 = op1 * op2; break;
+        case OpCode::DIVIDE:
+            if (op2 == 0) {
+                return fail(result, EvalError::DIVISION_BY_ZERO, tokens.offsets[index], '/');
+            }
+            op1 = op1 / op2;
+            break;
+        case OpCode::POWER:    op1 = power(op1, op2); break;
+        default:
+            return fail(result, EvalError::UNKNOWN_OPERATOR, tokens.offsets[index], opCodeToChar(op));
+    }
+    return true;
+}
+
+// Applies the function of the FUNCTION token at `index` to the top
+// `arguments` operands. Returns false and fills `result` on error.
+bool applyCall(const TokenBuffer& tokens, uint32_t index, size_t arguments,
+               std::pmr::vector<double>& operands, EvalResult& result) {
+    const FunctionInfo& function = functionInfo(tokens.literalIndexes[index]);
+    if (arguments != function.arity || operands.size() < arguments) {
+        return fail(result, EvalError::WRONG_ARGUMENT_COUNT, tokens.offsets[index]);
+    }
+
+    if (function.arity == 1) {
+        operands.back() = function.unary(operands.back());
+    } else {
+        double last = operands.back(); operands.pop_back();
+        operands.back() = function.binary(operands.back(), last);
+    }
+    return true;
+}
+
+// Shunting-yard evaluation over a TokenBuffer. The operator stack holds token
+// indexes (of operators, left parentheses, calls and their commas) so errors
+// can report where in the source they happened. Returns false and fills
+// `result` on error.
+bool evaluateTokenBuffer(const TokenBuffer& tokens,
+                         std::pmr::vector<double>& operandStack,
+                         std::pmr::vector<uint32_t>& operatorStack,
+                         EvalResult& result) {
+    if (tokens.empty()) {
+        return fail(result, EvalError::EMPTY_EXPRESSION, 0);
+    }
+
+    const uint32_t tokenCount = static_cast<uint32_t>(tokens.size());
+    TokenType previous = TokenType::UNKNOWN;
+    for (uint32_t i = 0; i < tokenCount; previous = tokens.kinds[i], ++i) {
+        TokenType type = tokens.kinds[i];
+
+        if (type == TokenType::NUMBER) {
+            operandStack.push_back(tokens.literals[tokens.literalIndexes[i]]);
+        } else if (type == TokenType::IDENTIFIER) {
+            return fail(result, EvalError::UNKNOWN_VARIABLE, tokens.offsets[i]);
+        } else if (type == TokenType::LEFT_PAREN) {
+            operatorStack.push_back(i);
+        } else if (type == TokenType::FUNCTION) {
+            if (tokens.literalIndexes[i] == NO_FUNCTION) {
+                return fail(result, EvalError::UNKNOWN_FUNCTION, tokens.offsets[i]);
+            }
+            operatorStack.push_back(i);
+        } else if (type == TokenType::COMMA) {
+            if (previous == TokenType::FUNCTION || previous == TokenType::COMMA) {
+                return fail(result, EvalError::EMPTY_ARGUMENT, tokens.offsets[i], ',');
+            }
+            while (!operatorStack.empty() && tokens.kinds[operatorStack.back()] == TokenType::OPERATOR) {
+                if (!applyOpCode(tokens, operatorStack.back(), operandStack, result)) return false;
+                operatorStack.pop_back();
+            }
+            if (operatorStack.empty() || (tokens.kinds[operatorStack.back()] != TokenType::FUNCTION &&
+                                          tokens.kinds[operatorStack.back()] != TokenType::COMMA)) {
+                return fail(result, EvalError::UNEXPECTED_COMMA, tokens.offsets[i], ',');
+            }
+            operatorStack.push_back(i);
+        } else if (type == TokenType::RIGHT_PAREN) {
+            if (previous == TokenType::COMMA) {
+                return fail(result, EvalError::EMPTY_ARGUMENT, tokens.offsets[i], ')');
+            }
+
+            size_t commas = 0;
+            while (!operatorStack.empty() && (tokens.kinds[operatorStack.back()] == TokenType::OPERATOR ||
+                                              tokens.kinds[operatorStack.back()] == TokenType::COMMA)) {
+                if (tokens.kinds[operatorStack.back()] == TokenType::COMMA) {
+                    ++commas;
+                } else if (!applyOpCode(tokens, operatorStack.back(), operandStack, result)) {
+                    return false;
+                }
+                operatorStack.pop_back();
+            }
+
+            if (operatorStack.empty()) {
+                return fail(result, EvalError::MISSING_LEFT_PAREN, tokens.offsets[i], ')');
+            }
+
+            uint32_t open = operatorStack.back();
+            operatorStack.pop_back();
+            if (tokens.kinds[open] == TokenType::FUNCTION &&
+                !applyCall(tokens, open, previous == TokenType::FUNCTION ? 0 : commas + 1, operandStack, result)) {
+                return false;
+            }
+        } else if (type == TokenType::OPERATOR) {
+            OpCode op = tokens.opCodes[i];
+            int precedence = opCodePrecedence(op);
+            bool isLeftAssociative = isOpCodeLeftAssociative(op);
+
+            while (!operatorStack.empty() && tokens.kinds[operatorStack.back()] == TokenType::OPERATOR) {
+                int topPrecedence = opCodePrecedence(tokens.opCodes[operatorStack.back()]);
+                if (topPrecedence < precedence || (topPrecedence == precedence && !isLeftAssociative)) {
+                    break;
+                }
+                if (!applyOpCode(tokens, operatorStack.back(), operandStack, result)) return false;
+                operatorStack.pop_back();
+            }
+
+            operatorStack.push_back(i);
+        } else {
+            return fail(result, EvalError::INVALID_CHARACTER, tokens.offsets[i]);
+        }
+    }
+
+    while (!operatorStack.empty()) {
+        uint32_t top = operatorStack.back();
+        if (tokens.kinds[top] != TokenType::OPERATOR) {
+            return fail(result, EvalError::MISSING_RIGHT_PAREN, tokens.offsets[top], '(');
+        }
+        if (!applyOpCode(tokens, top, operandStack, result)) return false;
+        operatorStack.pop_back();
+    }
+
+    if (operandStack.size() != 1) {
+        return fail(result, EvalError::MALFORMED_EXPRESSION, tokens.offsets[tokenCount - 1]);
+    }
+
+    result.value = operandStack.back();
+    return true;
+}
+
+// Runs the evaluator without letting std::bad_alloc escape.
+EvalResult tryEvaluate(const TokenBuffer& tokens,
+                       std::pmr::vector<double>& operandStack,
+                       std::pmr::vector<uint32_t>& operatorStack) noexcept {
+    EvalResult result;
+    try {
+        evaluateTokenBuffer(tokens, operandStack, operatorStack, result);
+    } catch (const std::bad_alloc&) {
+        fail(result, EvalError::OUT_OF_MEMORY, 0);
+    }
+    return result;
+}
+
+// Returns the value of a successful result or throws its message.
+double valueOrThrow(const EvalResult& result) {
+    if (!result.ok()) {
+        throw std::runtime_error(result.message());
+    }
+    return result.value;
+}
+
+}  // namespace
+
+// Evaluates an expression stored in a structure-of-arrays TokenBuffer.
+double calculate(const TokenBuffer& tokens) {
+    std::pmr::vector<double> operandStack;
+    std::pmr::vector<uint32_t> operatorStack;
+    return valueOrThrow(tryEvaluate(tokens, operandStack, operatorStack));
+}
+
+// Creates scratch state whose buffers all allocate from `resource`.
+EvalScratch::EvalScratch(std::pmr::memory_resource* resource)
+    : tokens(resource), operandStack(resource), operatorStack(resource) {}
+
+// Reserves room for expressions of up to `tokenCount` tokens.
+void EvalScratch::reserve(size_t tokenCount) {
+    tokens.reserve(tokenCount);
+    operandStack.reserve(tokenCount);
+    operatorStack.reserve(tokenCount);
+}
+
+// Empties all buffers without releasing their memory.
+void EvalScratch::clear() {
+    tokens.clear();
+    operandStack.clear();
+    operatorStack.clear();
+}
+
+// Evaluates a TokenBuffer with caller-owned stacks.
+double calculate(const TokenBuffer& tokens, EvalScratch& scratch) {
+    return valueOrThrow(tryCalculate(tokens, scratch));
+}
+
+// Tokenizes and evaluates an expression entirely within `scratch`.
+double calculate(std::string_view expression, EvalScratch& scratch) {
+    return valueOrThrow(tryCalculate(expression, scratch));
+}
+
+// Tokenizes and evaluates an expression with all storage taken from `resource`.
+double calculate(std::string_view expression, std::pmr::memory_resource* resource) {
+    EvalScratch scratch(resource);
+    scratch.reserve(expression.size() / 2 + 1);  // Grow each buffer at most a few times.
+    return calculate(expression, scratch);
+}
+
+// Evaluates a TokenBuffer with caller-owned stacks, without throwing.
+EvalResult tryCalculate(const TokenBuffer& tokens, EvalScratch& scratch) noexcept {
+    scratch.operandStack.clear();
+    scratch.operatorStack.clear();
+    return tryEvaluate(tokens, scratch.operandStack, scratch.operatorStack);
+}
+
+// Tokenizes and evaluates an expression within `scratch`, without throwing.
+EvalResult tryCalculate(std::string_view expression, EvalScratch& scratch) noexcept {
+    try {
+        tokenizer(expression, scratch.tokens);
+    } catch (const std::bad_alloc&) {
+        EvalResult result;
+        fail(result, EvalError::OUT_OF_MEMORY, 0);
+        return result;
+    }
+
+    EvalResult result = tryCalculate(scratch.tokens, scratch);
+    if (result.error == EvalError::INVALID_CHARACTER) {
+        result.symbol = expression[result.offset];
+    }
+    return result;
+}
@@ -0,0 +1,125 @@
+#include "columnar.h"
+#include "functions.h"
+#include "operator_kernels.h"
+#include "power.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Maps a postfix operator to its kernel's OpCode, or OpCode::NONE.
+OpCode opCodeFor(StackOp op) {
+    switch (op) {
+        case StackOp::ADD:      return OpCode::ADD;
+        case StackOp::SUBTRACT: return OpCode::SUBTRACT;
+        case StackOp::MULTIPLY: return OpCode::MULTIPLY;
+        case StackOp::DIVIDE:   return OpCode::DIVIDE;
+        default:                return OpCode::NONE;
+    }
+}
+
+// '^' over a block, row by row as `power` computes it: rows with a small
+// integer exponent multiply and only a block with other exponents runs
+// pow's batch implementation.
+void powerBlock(const double* left, const double* right, double* out, size_t count) {
+    int exponent;
+    size_t integers = 0;
+    for (size_t i = 0; i < count; ++i) integers += integerExponent(right[i], exponent);
+    if (integers < count) functionInfo(static_cast<uint32_t>(FunctionId::POW)).binaryBatch(left, right, out, count);
+    if (integers == 0) return;
+    for (size_t i = 0; i < count; ++i) {
+        if (integerExponent(right[i], exponent)) out[i] = integerPower(left[i], exponent);
+    }
+}
+
+// Block storage for the operand stack: two buffers per stack level, so an
+// instruction can always write a buffer that none of its inputs occupies
+// (the array kernels take __restrict pointers).
+class BlockStack {
+public:
+    explicit BlockStack(size_t depth) : storage_(2 * depth * COLUMN_BLOCK_ROWS), entries_(depth) {}
+
+    // The block at stack level `level`: a buffer or a slice of a column.
+    const double*& operator[](size_t level) { return entries_[level]; }
+
+    // A buffer of level `level` other than `input`.
+    double* output(size_t level, const double* input) {
+        double* first = storage_.data() + 2 * level * COLUMN_BLOCK_ROWS;
+        return first == input ? first + COLUMN_BLOCK_ROWS : first;
+    }
+
+private:
+    std::vector<double> storage_;
+    std::vector<const double*> entries_;
+};
+
+}  // namespace
+
+// Runs the program over each block with a stack of block pointers: LOAD
+// points at the column itself, so only constants and results are written.
+void evaluateColumns(const PostfixProgram& program, const double* const* columns, size_t rows, double* out) {
+    if (program.code.size() < 2) {
+        throw std::runtime_error("Evaluation Error: Empty expression");
+    }
+    if (program.variableCount > 0 && columns == nullptr) {
+        throw std::runtime_error("Evaluation Error: No values given for the expression's variables");
+    }
+
+    BlockStack stack(program.maxDepth);
+    for (size_t begin = 0; begin < rows; begin += COLUMN_BLOCK_ROWS) {
+        const size_t count = std::min(COLUMN_BLOCK_ROWS, rows - begin);
+        size_t top = 0;
+
+        for (const StackInstruction* ip = program.code.data(); ip->op != StackOp::HALT; ++ip) {
+            switch (ip->op) {
+                case StackOp::PUSH: {
+                    double* block = stack.output(top, nullptr);
+                    std::fill(block, block + count, program.constants[ip->operand]);
+                    stack[top++] = block;
+                    break;
+                }
+                case StackOp::LOAD:
+                    stack[top++] = columns[ip->operand] + begin;
+                    break;
+                case StackOp::CALL_UNARY: {
+                    const double* argument = stack[top - 1];
+                    double* result = stack.output(top - 1, argument);
+                    functionInfo(ip->operand).unaryBatch(argument, result, count);
+                    stack[top - 1] = result;
+                    break;
+                }
+                case StackOp::POWER:
+                case StackOp::CALL_BINARY: {
+                    const double* right = stack[--top];
+                    const double* left = stack[top - 1];
+                    double* result = stack.output(top - 1, left);
+                    if (ip->op == StackOp::POWER) {
+                        powerBlock(left, right, result, count);
+                    } else {
+                        functionInfo(ip->operand).binaryBatch(left, right, result, count);
+                    }
+                    stack[top - 1] = result;
+                    break;
+                }
+                default: {
+                    const KernelEntry& kernel = OPERATOR_KERNELS[static_cast<size_t>(opCodeFor(ip->op))];
+                    if (kernel.applyToArrays == nullptr) {
+                        throw std::runtime_error("Evaluation Error: Invalid instruction in program.");
+                    }
+                    const double* right = stack[--top];
+                    const double* left = stack[top - 1];
+                    if (kernel.rejectsZeroDivisor && std::find(right, right + count, 0.0) != right + count) {
+                        throw std::runtime_error("Math Error: Division by zero");
+                    }
+                    double* result = stack.output(top - 1, left);
+                    kernel.applyToArrays(left, right, result, count);
+                    stack[top - 1] = result;
+                    break;
+                }
+            }
+        }
+
+        std::copy(stack[0], stack[0] + count, out + begin);
+    }
+}
@@ -0,0 +1,334 @@
+#include "csv.h"
+#include "columnar.h"
+#include "scanner.h"
+#include "trace.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Longest output of std::to_chars for a double.
+const size_t MAX_NUMBER_TEXT = 32;
+
+// Rows below which a chunk is not worth splitting among threads.
+const size_t MIN_ROWS_PER_THREAD = 1024;
+
+// Sets each bit to the XOR of itself and every lower bit, turning a mask of
+// quote toggles into a mask of the bytes from each opening quote up to its
+// closing quote (exclusive).
+uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Calls visit(position) for every newline, and every delimiter too if
+// `fields`, in data[0, length) outside quoted fields, in order, until it
+// returns false. `data` must start at the start of a field, outside quotes.
+//
+// A quote opens a quoted field only as the first byte of a field, or right
+// after a closing quote (a doubled quote inside a quoted field); inside a
+// quoted field any quote closes it. Quotes elsewhere, such as 12" for
+// inches, are ordinary bytes. Quotes are rare, so the toggles are picked
+// from the quote mask one quote at a time, and the quoted bytes then follow
+// from one prefix XOR.
+template <typename Visitor>
+void forEachSeparator(const char* data, size_t length, char delimiter, bool fields, Visitor&& visit) {
+    bool inQuotes = false;
+    uint64_t previousSeparator = 1;  // Bit 0 set if the byte before the block ends a field.
+    size_t lastClose = SIZE_MAX;     // Position of the last closing quote.
+    for (size_t block = 0; block < length; block += SCAN_BLOCK_SIZE) {
+        size_t blockLength = length - block < SCAN_BLOCK_SIZE ? length - block : SCAN_BLOCK_SIZE;
+        CsvMasks masks = classifyCsvBlock(data + block, blockLength, delimiter);
+        const uint64_t separators = masks.newline | masks.delimiter;
+        const uint64_t fieldStarts = separators << 1 | previousSeparator;
+        previousSeparator = separators >> (SCAN_BLOCK_SIZE - 1);
+
+        const uint64_t quotedBefore = inQuotes ? ~uint64_t{0} : 0;
+        uint64_t toggles = 0;
+        for (uint64_t quotes = masks.quote; quotes != 0; quotes &= quotes - 1) {
+            const size_t bit = static_cast<size_t>(__builtin_ctzll(quotes));
+            if (inQuotes) {
+                lastClose = block + bit;
+            } else if (!(fieldStarts >> bit & 1) && lastClose + 1 != block + bit) {
+                continue;  // A stray quote inside an unquoted field.
+            }
+            toggles |= uint64_t{1} << bit;
+            inQuotes = !inQuotes;
+        }
+        const uint64_t quoted = prefixXor(toggles) ^ quotedBefore;
+
+        uint64_t events = (masks.newline | (fields ? masks.delimiter : 0)) & ~quoted;
+        while (events != 0) {
+            if (!visit(block + static_cast<size_t>(__builtin_ctzll(events)))) return;
+            events &= events - 1;
+        }
+    }
+}
+
+// A data row of a chunk: bytes [begin, end), without its line break.
+struct Row {
+    size_t begin;
+    size_t end;
+};
+
+// The rows one worker evaluates and what it produces for them.
+struct CsvPart {
+    const Row* rows = nullptr;
+    size_t rowCount = 0;
+    uint64_t firstRow = 0;  // Data row index of rows[0] in the whole input.
+    std::string output;
+    StreamErrors errors;
+};
+
+// What every worker shares: the program, which field feeds which slot, and
+// a constant column for every slot no field feeds.
+struct CsvPlan {
+    const PostfixProgram* program;
+    const Environment* environment;
+    std::vector<uint32_t> fieldSlots;  // Only slots the program LOADs.
+    std::vector<std::string> fieldNames;
+    size_t fieldsRead = 0;  // One past the last field with a slot.
+    std::vector<std::vector<double>> constantColumns;
+    char delimiter;
+};
+
+// Drops spaces around a field and the quotes of a quoted one.
+void trimField(const char*& first, const char*& last) {
+    while (first != last && *first == ' ') ++first;
+    while (last != first && last[-1] == ' ') --last;
+    if (last - first >= 2 && *first == '"' && last[-1] == '"') {
+        ++first;
+        --last;
+    }
+}
+
+// Parses the fields of `part`'s rows into input columns, evaluates them a
+// block at a time and formats each row with its result appended.
+void evaluatePart(const CsvPlan& plan, const char* data, CsvPart& part) {
+    const PostfixProgram& program = *plan.program;
+    std::vector<std::vector<double>> inputColumns(program.variableCount);
+    std::vector<const double*> columns(program.variableCount);
+    for (uint32_t slot = 0; slot < program.variableCount; ++slot) columns[slot] = plan.constantColumns[slot].data();
+    for (uint32_t slot : plan.fieldSlots) {
+        if (slot == SymbolTable::NO_SLOT) continue;
+        inputColumns[slot].assign(MAP_BLOCK_NUMBERS, 0.0);
+        columns[slot] = inputColumns[slot].data();
+    }
+    std::vector<double> results(MAP_BLOCK_NUMBERS);
+    std::vector<double> row(plan.environment->values(), plan.environment->values() + plan.environment->size());
+
+    size_t textBytes = 0;
+    for (size_t i = 0; i < part.rowCount; ++i) textBytes += part.rows[i].end - part.rows[i].begin;
+    part.output.reserve(textBytes + part.rowCount * (MAX_NUMBER_TEXT / 2));
+
+    for (size_t blockBegin = 0; blockBegin < part.rowCount; blockBegin += MAP_BLOCK_NUMBERS) {
+        const size_t count = std::min(MAP_BLOCK_NUMBERS, part.rowCount - blockBegin);
+        const Row* rows = part.rows + blockBegin;
+        const uint64_t firstRow = part.firstRow + blockBegin;
+
+        for (size_t r = 0; r < count; ++r) {
+            const char* text = data + rows[r].begin;
+            const char* fieldBegin = text;
+            size_t field = 0;
+            auto endField = [&](const char* fieldEnd) {
+                uint32_t slot = field < plan.fieldsRead ? plan.fieldSlots[field] : SymbolTable::NO_SLOT;
+                if (slot != SymbolTable::NO_SLOT) {
+                    const char* first = fieldBegin;
+                    const char* last = fieldEnd;
+                    trimField(first, last);
+                    if (!parseNumber(first, last, inputColumns[slot][r])) {
+                        inputColumns[slot][r] = NAN;
+                        part.errors.record(firstRow + r, "Invalid number '" + std::string(first, last) +
+                                                             "' in column " + plan.fieldNames[field]);
+                    }
+                }
+                ++field;
+            };
+            if (plan.fieldsRead > 0) {
+                forEachSeparator(text, rows[r].end - rows[r].begin, plan.delimiter, true, [&](size_t position) {
+                    endField(text + position);
+                    fieldBegin = text + position + 1;
+                    return field < plan.fieldsRead;
+                });
+                if (field < plan.fieldsRead) endField(data + rows[r].end);
+            }
+            for (; field < plan.fieldsRead; ++field) {
+                uint32_t slot = plan.fieldSlots[field];
+                if (slot == SymbolTable::NO_SLOT) continue;
+                inputColumns[slot][r] = NAN;
+                part.errors.record(firstRow + r, "Missing column " + plan.fieldNames[field]);
+            }
+        }
+
+        try {
+            evaluateColumns(program, columns.data(), count, results.data());
+        } catch (const std::runtime_error&) {
+            for (size_t r = 0; r < count; ++r) {
+                for (uint32_t slot : plan.fieldSlots) {
+                    if (slot != SymbolTable::NO_SLOT) row[slot] = inputColumns[slot][r];
+                }
+                try {
+                    results[r] = evaluate(program, row.data());
+                } catch (const std::runtime_error& e) {
+                    results[r] = NAN;
+                    part.errors.record(firstRow + r, e.what());
+                }
+            }
+        }
+
+        for (size_t r = 0; r < count; ++r) {
+            char number[MAX_NUMBER_TEXT];
+            char* numberEnd = std::to_chars(number, number + MAX_NUMBER_TEXT, results[r]).ptr;
+            part.output.append(data + rows[r].begin, rows[r].end - rows[r].begin);
+            part.output += plan.delimiter;
+            part.output.append(number, numberEnd);
+            part.output += '\n';
+        }
+    }
+}
+
+}  // namespace
+
+// Walks the line once, toggling at quotes that open or close a quoted field
+// by the rules of forEachSeparator.
+std::vector<std::string> splitCsvLine(std::string_view line, char delimiter) {
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (c == '"' && (quoted || i == 0 || line[i - 1] == delimiter)) {
+            if (quoted && i + 1 < line.size() && line[i + 1] == '"') {
+                fields.back() += '"';
+                ++i;
+            } else {
+                quoted = !quoted;
+            }
+        } else if (c == delimiter && !quoted) {
+            fields.emplace_back();
+        } else {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+// Splits the header, then trims each name like a data field.
+std::vector<std::string> csvColumnNames(std::string_view header, char delimiter) {
+    std::vector<std::string> names = splitCsvLine(header, delimiter);
+    for (std::string& name : names) {
+        const char* first = name.data();
+        const char* last = name.data() + name.size();
+        trimField(first, last);
+        name = std::string(first, last);
+    }
+    return names;
+}
+
+// Reads a chunk, splits off its complete rows (the rest waits for the next
+// chunk), evaluates them in parts and writes the parts in order. The rest
+// is shorter than a chunk, so the buffer never exceeds two chunks.
+StreamErrors mapCsv(const PostfixProgram& program, const Environment& environment,
+                    const std::vector<uint32_t>& fieldSlots, std::string_view header, std::istream& in,
+                    std::ostream& out, const CsvOptions& options) {
+    CsvPlan plan;
+    plan.program = &program;
+    plan.environment = &environment;
+    plan.delimiter = options.delimiter;
+    plan.fieldNames = csvColumnNames(header, options.delimiter);
+
+    std::vector<bool> loaded(program.variableCount, false);
+    for (const StackInstruction& instruction : program.code) {
+        if (instruction.op == StackOp::LOAD) loaded[instruction.operand] = true;
+    }
+    for (size_t field = 0; field < fieldSlots.size(); ++field) {
+        uint32_t slot = fieldSlots[field];
+        bool read = slot < program.variableCount && loaded[slot];
+        plan.fieldSlots.push_back(read ? slot : SymbolTable::NO_SLOT);
+        if (read) plan.fieldsRead = field + 1;
+    }
+    plan.fieldSlots.resize(plan.fieldsRead);
+    plan.constantColumns.resize(program.variableCount);
+    for (uint32_t slot = 0; slot < program.variableCount; ++slot) {
+        plan.constantColumns[slot].assign(MAP_BLOCK_NUMBERS, environment[slot]);
+    }
+
+    out << header << options.delimiter << options.resultName << '\n';
+
+    const unsigned threads = std::max(options.threads, 1u);
+    std::vector<char> buffer;
+    std::vector<Row> rows;
+    std::vector<CsvPart> parts;
+    size_t size = 0;
+    bool eof = false;
+    uint64_t rowIndex = 0;
+    StreamErrors errors;
+    while (!eof) {
+        traced("read", [&] {
+            if (buffer.size() < size + options.chunkBytes) buffer.resize(size + options.chunkBytes);
+            in.read(buffer.data() + size, static_cast<std::streamsize>(options.chunkBytes));
+            size += static_cast<size_t>(in.gcount());
+            eof = !in;  // A short read means the end of the input.
+        });
+
+        rows.clear();
+        size_t rowBegin = 0;
+        auto addRow = [&](size_t end) {
+            if (end > rowBegin && buffer[end - 1] == '\r') --end;
+            if (end > rowBegin) rows.push_back({rowBegin, end});
+        };
+        traced("split", [&] {
+            forEachSeparator(buffer.data(), size, options.delimiter, false, [&](size_t position) {
+                addRow(position);
+                rowBegin = position + 1;
+                return true;
+            });
+        });
+        if (eof && rowBegin < size) {
+            addRow(size);
+            rowBegin = size;
+        }
+
+        const size_t partCount = std::max<size_t>(std::min<size_t>(threads, rows.size() / MIN_ROWS_PER_THREAD), 1);
+        parts.assign(partCount, CsvPart());
+        for (size_t i = 0; i < partCount; ++i) {
+            size_t first = rows.size() * i / partCount;
+            parts[i].rows = rows.data() + first;
+            parts[i].rowCount = rows.size() * (i + 1) / partCount - first;
+            parts[i].firstRow = rowIndex + first;
+        }
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < partCount; ++i) {
+            workers.emplace_back([&, i] {
+                traced("evaluate", [&] { evaluatePart(plan, buffer.data(), parts[i]); });
+            });
+        }
+        traced("evaluate", [&] { evaluatePart(plan, buffer.data(), parts[0]); });
+        for (std::thread& worker : workers) worker.join();
+
+        traced("output", [&] {
+            for (const CsvPart& part : parts) {
+                out.write(part.output.data(), static_cast<std::streamsize>(part.output.size()));
+                errors.merge(part.errors);
+            }
+        });
+        rowIndex += rows.size();
+
+        std::memmove(buffer.data(), buffer.data() + rowBegin, size - rowBegin);
+        size -= rowBegin;
+        if (!eof && size >= options.chunkBytes) {
+            throw std::runtime_error("CSV row " + std::to_string(rowIndex + 1) + " is longer than " +
+                                     std::to_string(options.chunkBytes) + " bytes (an unclosed quote?)");
+        }
+    }
+    return errors;
+}
@@ -0,0 +1,124 @@
+#include "environment.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Tries per bucket before giving up; only names whose 64-bit hashes collide
+// outright can exhaust it.
+const uint32_t MAX_DISPLACEMENT = 1u << 20;
+
+// The splitmix64 finalizer: spreads every input bit over the whole word.
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27; x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// FNV-1a over the name, mixed so that both halves of the hash are usable.
+uint64_t hashName(std::string_view name) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001B3ull;
+    }
+    return mix(hash);
+}
+
+// The entry a name lands in under a bucket's displacement.
+size_t entryIndex(uint64_t hash, uint32_t displacement, size_t mask) {
+    return mix(hash + displacement * 0x9E3779B97F4A7C15ull) & mask;
+}
+
+}  // namespace
+
+// Checks the first character, then the rest.
+bool isIdentifier(std::string_view name) {
+    auto isLetter = [](char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; };
+    if (name.empty() || !isLetter(name[0])) return false;
+    return std::all_of(name.begin(), name.end(), [&](char c) { return isLetter(c) || (c >= '0' && c <= '9'); });
+}
+
+// Builds the table by hash and displace: names are grouped into buckets by
+// the high half of their hash (about four per bucket), and the biggest
+// buckets are placed first, each trying displacements until all of its
+// names land in distinct free entries. With the table at most half full
+// this takes a few tries per bucket.
+SymbolTable::SymbolTable(std::vector<std::string> names) : names_(std::move(names)) {
+    std::vector<std::string_view> sorted(names_.begin(), names_.end());
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        if (!isIdentifier(sorted[i])) {
+            throw std::runtime_error("Evaluation Error: Invalid variable name '" + std::string(sorted[i]) + "'");
+        }
+        if (i > 0 && sorted[i] == sorted[i - 1]) {
+            throw std::runtime_error("Evaluation Error: Duplicate variable " + std::string(sorted[i]));
+        }
+    }
+
+    size_t entryCount = 1;
+    while (entryCount < 2 * names_.size()) entryCount <<= 1;
+    const size_t mask = entryCount - 1;
+    entries_.assign(entryCount, NO_SLOT);
+    displacements_.assign(names_.size() / 4 + 1, 0);
+
+    std::vector<uint64_t> hashes(names_.size());
+    std::vector<std::vector<uint32_t>> buckets(displacements_.size());
+    for (uint32_t slot = 0; slot < names_.size(); ++slot) {
+        hashes[slot] = hashName(names_[slot]);
+        buckets[(hashes[slot] >> 32) % buckets.size()].push_back(slot);
+    }
+
+    std::vector<uint32_t> order(buckets.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    std::vector<size_t> positions;
+    for (uint32_t bucket : order) {
+        const std::vector<uint32_t>& slots = buckets[bucket];
+        if (slots.empty()) break;
+
+        uint32_t displacement = 0;
+        for (;; ++displacement) {
+            if (displacement == MAX_DISPLACEMENT) {
+                throw std::runtime_error("Evaluation Error: Could not build the symbol table");
+            }
+            positions.clear();
+            for (uint32_t slot : slots) {
+                size_t position = entryIndex(hashes[slot], displacement, mask);
+                if (entries_[position] != NO_SLOT ||
+                    std::find(positions.begin(), positions.end(), position) != positions.end()) {
+                    break;
+                }
+                positions.push_back(position);
+            }
+            if (positions.size() == slots.size()) break;
+        }
+
+        displacements_[bucket] = displacement;
+        for (size_t i = 0; i < slots.size(); ++i) entries_[positions[i]] = slots[i];
+    }
+}
+
+// One hash, two table reads and one string comparison.
+uint32_t SymbolTable::find(std::string_view name) const {
+    if (names_.empty()) return NO_SLOT;
+    uint64_t hash = hashName(name);
+    uint32_t displacement = displacements_[(hash >> 32) % displacements_.size()];
+    uint32_t slot = entries_[entryIndex(hash, displacement, entries_.size() - 1)];
+    return slot != NO_SLOT && names_[slot] == name ? slot : NO_SLOT;
+}
+
+// Creates an environment with every variable set to zero.
+Environment::Environment(std::vector<std::string> names)
+    : symbols_(std::move(names)), values_(symbols_.size(), 0.0) {}
+
+// Resolves a name or throws.
+uint32_t Environment::slot(std::string_view name) const {
+    uint32_t slot = symbols_.find(name);
+    if (slot == SymbolTable::NO_SLOT) {
+        throw std::runtime_error("Evaluation Error: Unknown variable " + std::string(name));
+    }
+    return slot;
+}
@@ -0,0 +1,62 @@
+#include "eval_result.h"
+
+// Converts an EvalError to its string representation.
+const char* evalErrorToString(EvalError error) {
+    switch (error) {
+        case EvalError::NONE:                  return "NONE";
+        case EvalError::EMPTY_EXPRESSION:      return "EMPTY_EXPRESSION";
+        case EvalError::INVALID_CHARACTER:     return "INVALID_CHARACTER";
+        case EvalError::INSUFFICIENT_OPERANDS: return "INSUFFICIENT_OPERANDS";
+        case EvalError::UNKNOWN_OPERATOR:      return "UNKNOWN_OPERATOR";
+        case EvalError::MISSING_LEFT_PAREN:    return "MISSING_LEFT_PAREN";
+        case EvalError::MISSING_RIGHT_PAREN:   return "MISSING_RIGHT_PAREN";
+        case EvalError::MALFORMED_EXPRESSION:  return "MALFORMED_EXPRESSION";
+        case EvalError::DIVISION_BY_ZERO:      return "DIVISION_BY_ZERO";
+        case EvalError::UNKNOWN_VARIABLE:      return "UNKNOWN_VARIABLE";
+        case EvalError::UNKNOWN_FUNCTION:      return "UNKNOWN_FUNCTION";
+        case EvalError::UNEXPECTED_COMMA:      return "UNEXPECTED_COMMA";
+        case EvalError::EMPTY_ARGUMENT:        return "EMPTY_ARGUMENT";
+        case EvalError::WRONG_ARGUMENT_COUNT:  return "WRONG_ARGUMENT_COUNT";
+        case EvalError::OUT_OF_MEMORY:         return "OUT_OF_MEMORY";
+        default:                               return "INVALID_ERROR";
+    }
+}
+
+// Builds the message used by the throwing API for this error.
+std::string EvalResult::message() const {
+    switch (error) {
+        case EvalError::NONE:
+            return "";
+        case EvalError::EMPTY_EXPRESSION:
+            return "Evaluation Error: Empty expression";
+        case EvalError::INVALID_CHARACTER:
+            if (symbol == 0) return "Syntax Error: Invalid character in expression";
+            return std::string("Syntax Error: Invalid character in expression: ") + symbol;
+        case EvalError::INSUFFICIENT_OPERANDS:
+            return std::string("Syntax Error: Insufficient operands for operator ") + symbol;
+        case EvalError::UNKNOWN_OPERATOR:
+            return std::string("Syntax Error: Unknown operator ") + symbol;
+        case EvalError::MISSING_LEFT_PAREN:
+            return "Syntax Error: Mismatched parentheses (missing '(').";
+        case EvalError::MISSING_RIGHT_PAREN:
+            return "Syntax Error: Mismatched parentheses at end of expression.";
+        case EvalError::MALFORMED_EXPRESSION:
+            return "Evaluation Error: Operand stack malformed at end of calculation.";
+        case EvalError::DIVISION_BY_ZERO:
+            return "Math Error: Division by zero";
+        case EvalError::UNKNOWN_VARIABLE:
+            return "Evaluation Error: Unknown variable";
+        case EvalError::UNKNOWN_FUNCTION:
+            return "Syntax Error: Unknown function";
+        case EvalError::UNEXPECTED_COMMA:
+            return "Syntax Error: Unexpected ',' outside a function call";
+        case EvalError::EMPTY_ARGUMENT:
+            return "Syntax Error: Empty function argument";
+        case EvalError::WRONG_ARGUMENT_COUNT:
+            return "Syntax Error: Wrong number of function arguments";
+        case EvalError::OUT_OF_MEMORY:
+            return "Evaluation Error: Out of memory";
+        default:
+            return "Evaluation Error: Unknown error";
+    }
+}
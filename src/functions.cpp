@@ -0,0 +1,1147 @@
+#include "functions.h"
+#include "environment.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FUNCTIONS_HAS_X86_SIMD 1
+#endif
+
+namespace {
+
+// Scalar implementations. The std:: functions are wrapped because taking
+// their address is not portable.
+double scalarCbrt(double x) { return std::cbrt(x); }
+double scalarExp2(double x) { return std::exp2(x); }
+double scalarLog2(double x) { return std::log2(x); }
+double scalarLog10(double x) { return std::log10(x); }
+double scalarAsin(double x) { return std::asin(x); }
+double scalarAcos(double x) { return std::acos(x); }
+double scalarAtan(double x) { return std::atan(x); }
+double scalarSinh(double x) { return std::sinh(x); }
+double scalarCosh(double x) { return std::cosh(x); }
+double scalarTanh(double x) { return std::tanh(x); }
+double scalarPow(double x, double y) { return std::pow(x, y); }
+double scalarAtan2(double y, double x) { return std::atan2(y, x); }
+double scalarHypot(double x, double y) { return std::hypot(x, y); }
+double scalarFmod(double x, double y) { return std::fmod(x, y); }
+
+// Batches for functions without a vector kernel.
+template <UnaryFunction Function>
+void unaryLoop(const double* in, double* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = Function(in[i]);
+}
+
+template <BinaryFunction Function>
+void binaryLoop(const double* left, const double* right, double* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) out[i] = Function(left[i], right[i]);
+}
+
+#ifdef FUNCTIONS_HAS_X86_SIMD
+
+bool detectAvx2Fma() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+// True if the vector kernels below can run on this CPU.
+bool hasAvx2Fma() {
+    static const bool supported = detectAvx2Fma();
+    return supported;
+}
+
+__attribute__((target("avx2,fma")))
+__m256d absolute(__m256d x) {
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+}
+
+// Horner's rule with FMA over coefficients from the highest degree down.
+template <size_t N>
+__attribute__((target("avx2,fma")))
+__m256d polynomial(__m256d x, const double (&coefficients)[N]) {
+    __m256d result = _mm256_set1_pd(coefficients[0]);
+    for (size_t i = 1; i < N; ++i) {
+        result = _mm256_fmadd_pd(result, x, _mm256_set1_pd(coefficients[i]));
+    }
+    return result;
+}
+
+// Runs `Kernel` over four lanes of `in`, then recomputes the lanes the
+// kernel flagged (bit i of `fallback`) with the scalar implementation.
+template <typename Kernel>
+__attribute__((target("avx2,fma")))
+void unaryBlock(const double* in, double* out) {
+    int fallback = 0;
+    _mm256_storeu_pd(out, Kernel::apply(_mm256_loadu_pd(in), fallback));
+    while (fallback != 0) {
+        int lane = __builtin_ctz(static_cast<unsigned>(fallback));
+        out[lane] = Kernel::scalar(in[lane]);
+        fallback &= fallback - 1;
+    }
+}
+
+// Applies a vector kernel to `count` values, padding the last partial
+// group of four so every element goes through the same code.
+template <typename Kernel>
+__attribute__((target("avx2,fma")))
+void unaryBatchAvx2(const double* in, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) unaryBlock<Kernel>(in + i, out + i);
+    if (i < count) {
+        double padded[4] = {0, 0, 0, 0};
+        double results[4];
+        for (size_t j = i; j < count; ++j) padded[j - i] = in[j];
+        unaryBlock<Kernel>(padded, results);
+        for (size_t j = i; j < count; ++j) out[j] = results[j - i];
+    }
+}
+
+// The two-argument form of unaryBlock.
+template <typename Kernel>
+__attribute__((target("avx2,fma")))
+void binaryBlock(const double* left, const double* right, double* out) {
+    int fallback = 0;
+    _mm256_storeu_pd(out, Kernel::apply(_mm256_loadu_pd(left), _mm256_loadu_pd(right), fallback));
+    while (fallback != 0) {
+        int lane = __builtin_ctz(static_cast<unsigned>(fallback));
+        out[lane] = Kernel::scalar(left[lane], right[lane]);
+        fallback &= fallback - 1;
+    }
+}
+
+template <typename Kernel>
+__attribute__((target("avx2,fma")))
+void binaryBatchAvx2(const double* left, const double* right, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) binaryBlock<Kernel>(left + i, right + i, out + i);
+    if (i < count) {
+        double paddedLeft[4] = {0, 0, 0, 0};
+        double paddedRight[4] = {0, 0, 0, 0};
+        double results[4];
+        for (size_t j = i; j < count; ++j) {
+            paddedLeft[j - i] = left[j];
+            paddedRight[j - i] = right[j];
+        }
+        binaryBlock<Kernel>(paddedLeft, paddedRight, results);
+        for (size_t j = i; j < count; ++j) out[j] = results[j - i];
+    }
+}
+
+#endif  // FUNCTIONS_HAS_X86_SIMD
+
+// Batch entry points: the vector kernel when the CPU has AVX2 and FMA, the
+// scalar implementation otherwise.
+template <typename Kernel>
+void unaryBatch(const double* in, double* out, size_t count) {
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    if (hasAvx2Fma()) {
+        unaryBatchAvx2<Kernel>(in, out, count);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) out[i] = Kernel::scalar(in[i]);
+}
+
+template <typename Kernel>
+void binaryBatch(const double* left, const double* right, double* out, size_t count) {
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    if (hasAvx2Fma()) {
+        binaryBatchAvx2<Kernel>(left, right, out, count);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) out[i] = Kernel::scalar(left[i], right[i]);
+}
+
+// Kernels. Each has the scalar implementation and, on x86, a four-lane
+// `apply`. The exact kernels never fall back.
+
+struct SqrtKernel {
+    static double scalar(double x) { return std::sqrt(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int&) { return _mm256_sqrt_pd(x); }
+#endif
+};
+
+struct AbsKernel {
+    static double scalar(double x) { return std::fabs(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int&) { return absolute(x); }
+#endif
+};
+
+struct FloorKernel {
+    static double scalar(double x) { return std::floor(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int&) { return _mm256_round_pd(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+#endif
+};
+
+struct CeilKernel {
+    static double scalar(double x) { return std::ceil(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int&) { return _mm256_round_pd(x, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC); }
+#endif
+};
+
+struct TruncKernel {
+    static double scalar(double x) { return std::trunc(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int&) { return _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+#endif
+};
+
+// Rounds half away from zero. x - trunc(x) is exact, so comparing it with
+// 0.5 decides the rounding without the errors of floor(x + 0.5); blending
+// (rather than adding zero) keeps the sign of -0.3 -> -0.
+struct RoundKernel {
+    static double scalar(double x) { return std::round(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int&) {
+        const __m256d sign = _mm256_set1_pd(-0.0);
+        __m256d truncated = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        __m256d away = _mm256_cmp_pd(absolute(_mm256_sub_pd(x, truncated)), _mm256_set1_pd(0.5), _CMP_GE_OQ);
+        __m256d step = _mm256_or_pd(_mm256_and_pd(x, sign), _mm256_set1_pd(1.0));
+        return _mm256_blendv_pd(truncated, _mm256_add_pd(truncated, step), away);
+    }
+#endif
+};
+
+// min and max return the other argument when one is NaN.
+struct MinKernel {
+    static double scalar(double a, double b) { return a != a ? b : (b < a ? b : a); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d a, __m256d b, int&) {
+        return _mm256_blendv_pd(_mm256_min_pd(b, a), b, _mm256_cmp_pd(a, a, _CMP_UNORD_Q));
+    }
+#endif
+};
+
+struct MaxKernel {
+    static double scalar(double a, double b) { return a != a ? b : (b > a ? b : a); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d a, __m256d b, int&) {
+        return _mm256_blendv_pd(_mm256_max_pd(b, a), b, _mm256_cmp_pd(a, a, _CMP_UNORD_Q));
+    }
+#endif
+};
+
+// e^x = 2^k * e^r with k = round(x / ln 2) and r = x - k ln 2 in
+// [-ln 2 / 2, ln 2 / 2], ln 2 split in two parts (fdlibm's) so k ln 2 is
+// subtracted almost exactly. e^r is its Taylor series to degree 13, whose
+// truncation error is below 2^-57, and 2^k is built in the exponent field.
+// Lanes with |x| > 708 (where 2^k leaves the normal range), infinities and
+// NaN fall back to std::exp.
+struct ExpKernel {
+    static double scalar(double x) { return std::exp(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        const double LN2_HI = 6.93147180369123816490e-01;
+        const double LN2_LO = 1.90821492927058770002e-10;
+        static const double COEFFICIENTS[] = {
+            1.0 / 6227020800, 1.0 / 479001600, 1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880,
+            1.0 / 40320, 1.0 / 5040, 1.0 / 720, 1.0 / 120, 1.0 / 24, 1.0 / 6, 0.5, 1.0, 1.0,
+        };
+        fallback = _mm256_movemask_pd(_mm256_cmp_pd(absolute(x), _mm256_set1_pd(708.0), _CMP_NLE_UQ));
+
+        __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)),
+                                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_HI), x);
+        r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_LO), r);
+        __m256d p = polynomial(r, COEFFICIENTS);
+
+        __m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+        exponent = _mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52);
+        return _mm256_mul_pd(p, _mm256_castsi256_pd(exponent));
+    }
+#endif
+};
+
+// fdlibm's log: x = 2^e * m with m in [sqrt(2)/2, sqrt(2)), f = m - 1 and
+// log(1 + f) = f - f^2/2 + s (f^2/2 + R(s^2)) with s = f / (2 + f) and R
+// fdlibm's minimax polynomial. Zero, negative, subnormal, infinite and NaN
+// lanes fall back to std::log.
+struct LogKernel {
+    static double scalar(double x) { return std::log(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        const double LN2_HI = 6.93147180369123816490e-01;
+        const double LN2_LO = 1.90821492927058770002e-10;
+        static const double EVEN[] = {1.531383769920937332e-01, 2.222219843214978396e-01, 3.999999999940941908e-01};
+        static const double ODD[] = {1.479819860511658591e-01, 1.818357216161805012e-01,
+                                     2.857142874366239149e-01, 6.666666666666735130e-01};
+        __m256d outside = _mm256_or_pd(_mm256_cmp_pd(x, _mm256_set1_pd(2.2250738585072014e-308), _CMP_NGE_UQ),
+                                       _mm256_cmp_pd(x, _mm256_set1_pd(INFINITY), _CMP_NLT_UQ));
+        fallback = _mm256_movemask_pd(outside);
+
+        // Split off the exponent; reading it back through 2^52 converts it to double.
+        __m256i bits = _mm256_castpd_si256(x);
+        __m256d m = _mm256_castsi256_pd(_mm256_or_si256(
+            _mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFll)), _mm256_set1_epi64x(0x3FF0000000000000ll)));
+        __m256d e = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(0x4330000000000000ll))),
+            _mm256_set1_pd(4503599627370496.0 + 1023));
+        __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(1.4142135623730951), _CMP_GT_OQ);
+        m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+        e = _mm256_add_pd(e, _mm256_and_pd(big, _mm256_set1_pd(1.0)));
+
+        __m256d f = _mm256_sub_pd(m, _mm256_set1_pd(1.0));
+        __m256d s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+        __m256d z = _mm256_mul_pd(s, s);
+        __m256d w = _mm256_mul_pd(z, z);
+        __m256d r = _mm256_add_pd(_mm256_mul_pd(z, polynomial(w, ODD)), _mm256_mul_pd(w, polynomial(w, EVEN)));
+        __m256d hfsq = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), f), f);
+        __m256d tail = _mm256_fmadd_pd(s, _mm256_add_pd(hfsq, r), _mm256_mul_pd(e, _mm256_set1_pd(LN2_LO)));
+        __m256d low = _mm256_sub_pd(_mm256_sub_pd(hfsq, tail), f);
+        return _mm256_fmsub_pd(e, _mm256_set1_pd(LN2_HI), low);
+    }
+#endif
+};
+
+#ifdef FUNCTIONS_HAS_X86_SIMD
+
+// x reduced to y + yy = x - k pi/N with |y| <= pi/(2N), and k.
+struct Reduced {
+    __m256d y;
+    __m256d yy;
+    __m256i k;
+    int fallback;  // Lanes to recompute with the C library.
+};
+
+// Cody-Waite reduction with pi/N split in three (fdlibm's 33 + 33 + 53 bit
+// parts of pi/2, scaled): k * P1 and k * P2 are exact for |k| < 2^20, that
+// is |x| <= 2^20 / N, x - k P1 is exact by Sterbenz's lemma and the
+// remaining subtraction is carried as a double-double. The result is
+// accurate to about 2^-100 absolute, so lanes are only sent to the C
+// library when |x| is beyond that range (or is not finite) or when the
+// reduced argument is so close to zero (below 2^-27 with k != 0) that this
+// would not be enough.
+template <int N>
+__attribute__((target("avx2,fma")))
+Reduced reducePi(__m256d x) {
+    const double SCALE = 2.0 / N;
+    const __m256d P1 = _mm256_set1_pd(1.57079632673412561417e+00 * SCALE);
+    const __m256d P2 = _mm256_set1_pd(6.07710050630396597660e-11 * SCALE);
+    const __m256d P2_TAIL = _mm256_set1_pd(2.02226624879595063154e-21 * SCALE);
+    const __m256d TINY = _mm256_set1_pd(7.450580596923828125e-9);  // 2^-27.
+
+    Reduced reduced;
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(6.36619772367581382433e-01 / SCALE)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(k, P1, x);
+    __m256d w = _mm256_mul_pd(k, P2);
+    __m256d high = _mm256_sub_pd(r, w);
+    __m256d virtualW = _mm256_sub_pd(high, r);  // Two-sum of r and -w.
+    __m256d error = _mm256_sub_pd(_mm256_sub_pd(r, _mm256_sub_pd(high, virtualW)), _mm256_add_pd(w, virtualW));
+    __m256d low = _mm256_fnmadd_pd(k, P2_TAIL, error);
+    reduced.y = _mm256_add_pd(high, low);
+    reduced.yy = _mm256_sub_pd(low, _mm256_sub_pd(reduced.y, high));
+    reduced.k = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+
+    __m256d outside = _mm256_cmp_pd(absolute(x), _mm256_set1_pd(1048576.0 / N), _CMP_NLE_UQ);
+    __m256d cancelled = _mm256_and_pd(_mm256_cmp_pd(k, _mm256_setzero_pd(), _CMP_NEQ_OQ),
+                                      _mm256_cmp_pd(absolute(reduced.y), TINY, _CMP_LT_OQ));
+    reduced.fallback = _mm256_movemask_pd(_mm256_or_pd(outside, cancelled));
+    return reduced;
+}
+
+// fdlibm's __kernel_sin and __kernel_cos on |y| <= pi/4.
+__attribute__((target("avx2,fma")))
+__m256d sinKernel(__m256d y, __m256d yy) {
+    static const double S[] = {
+        1.58969099521155010221e-10, -2.50507602534068634195e-08, 2.75573137070700676789e-06,
+        -1.98412698298579493134e-04, 8.33333333332248946124e-03,
+    };
+    const __m256d S1 = _mm256_set1_pd(-1.66666666666666324348e-01);
+    __m256d z = _mm256_mul_pd(y, y);
+    __m256d v = _mm256_mul_pd(z, y);
+    __m256d r = polynomial(z, S);
+    __m256d inner = _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), yy), _mm256_mul_pd(v, r));
+    return _mm256_sub_pd(y, _mm256_sub_pd(_mm256_sub_pd(_mm256_mul_pd(z, inner), yy), _mm256_mul_pd(v, S1)));
+}
+
+__attribute__((target("avx2,fma")))
+__m256d cosKernel(__m256d y, __m256d yy) {
+    static const double C[] = {
+        -1.13596475577881948265e-11, 2.08757232129817482790e-09, -2.75573143513906633035e-07,
+        2.48015872894767294178e-05, -1.38888888888741095749e-03, 4.16666666666666019037e-02,
+    };
+    const __m256d ONE = _mm256_set1_pd(1.0);
+    __m256d z = _mm256_mul_pd(y, y);
+    __m256d r = _mm256_mul_pd(z, polynomial(z, C));
+    __m256d hz = _mm256_mul_pd(_mm256_set1_pd(0.5), z);
+    __m256d w = _mm256_sub_pd(ONE, hz);
+    __m256d correction = _mm256_sub_pd(_mm256_mul_pd(z, r), _mm256_mul_pd(y, yy));
+    return _mm256_add_pd(w, _mm256_add_pd(_mm256_sub_pd(_mm256_sub_pd(ONE, w), hz), correction));
+}
+
+// All-ones lanes where the quadrant is odd (sine and cosine swap).
+__attribute__((target("avx2,fma")))
+__m256d oddQuadrant(__m256i quadrant) {
+    __m256i one = _mm256_set1_epi64x(1);
+    return _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(quadrant, one), one));
+}
+
+// The sign bit set in lanes where bit 1 of `quadrant` is set.
+__attribute__((target("avx2,fma")))
+__m256d quadrantSign(__m256i quadrant) {
+    return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(quadrant, _mm256_set1_epi64x(2)), 62));
+}
+
+// Lanes with |x| < 2^-27, where sin x and tan x round to x and cos x to 1
+// (also keeping the sign of -0).
+__attribute__((target("avx2,fma")))
+__m256d tinyArgument(__m256d x) {
+    return _mm256_cmp_pd(absolute(x), _mm256_set1_pd(7.450580596923828125e-9), _CMP_LT_OQ);
+}
+
+#endif  // FUNCTIONS_HAS_X86_SIMD
+
+// sin, cos and tan reduce x to y in [-pi/4, pi/4] and quadrant k, then pick
+// the sine or cosine kernel (or their ratio) and sign by quadrant.
+struct SinKernel {
+    static double scalar(double x) { return std::sin(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        Reduced reduced = reducePi<2>(x);
+        fallback = reduced.fallback;
+        __m256d value = _mm256_blendv_pd(sinKernel(reduced.y, reduced.yy), cosKernel(reduced.y, reduced.yy),
+                                         oddQuadrant(reduced.k));
+        value = _mm256_xor_pd(value, quadrantSign(reduced.k));
+        return _mm256_blendv_pd(value, x, tinyArgument(x));
+    }
+#endif
+};
+
+struct CosKernel {
+    static double scalar(double x) { return std::cos(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        Reduced reduced = reducePi<2>(x);
+        fallback = reduced.fallback;
+        __m256d value = _mm256_blendv_pd(cosKernel(reduced.y, reduced.yy), sinKernel(reduced.y, reduced.yy),
+                                         oddQuadrant(reduced.k));
+        value = _mm256_xor_pd(value, quadrantSign(_mm256_add_epi64(reduced.k, _mm256_set1_epi64x(1))));
+        return _mm256_blendv_pd(value, _mm256_set1_pd(1.0), tinyArgument(x));
+    }
+#endif
+};
+
+struct TanKernel {
+    static double scalar(double x) { return std::tan(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        Reduced reduced = reducePi<2>(x);
+        fallback = reduced.fallback;
+        __m256d sine = sinKernel(reduced.y, reduced.yy);
+        __m256d cosine = cosKernel(reduced.y, reduced.yy);
+        __m256d odd = oddQuadrant(reduced.k);
+        __m256d value = _mm256_div_pd(_mm256_blendv_pd(sine, cosine, odd), _mm256_blendv_pd(cosine, sine, odd));
+        value = _mm256_xor_pd(value, _mm256_and_pd(odd, _mm256_set1_pd(-0.0)));
+        return _mm256_blendv_pd(value, x, tinyArgument(x));
+    }
+#endif
+};
+
+// Fast math (MathAccuracy::RELATIVE_1E12 and RELATIVE_1E7). Each kernel
+// reduces its argument with a table so that a short Taylor polynomial
+// suffices; `Precise` selects the degrees (and, for log and pow, the
+// double-double steps) that keep the relative error below 1e-12 rather than
+// 1e-7. Arguments outside a kernel's range fall back to the C library.
+
+uint64_t bitsOf(double x) {
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof bits);
+    return bits;
+}
+
+double fromBits(uint64_t bits) {
+    double x;
+    std::memcpy(&x, &bits, sizeof x);
+    return x;
+}
+
+// Rounds |x| < 2^51 to an integer: adding 1.5 * 2^52 leaves no fraction bits.
+double roundToInteger(double x) {
+    const double SHIFTER = 6755399441055744.0;
+    return (x + SHIFTER) - SHIFTER;
+}
+
+// Horner's rule over coefficients from the highest degree down.
+template <size_t N>
+double polynomial(double x, const double (&coefficients)[N]) {
+    double result = coefficients[0];
+    for (size_t i = 1; i < N; ++i) result = result * x + coefficients[i];
+    return result;
+}
+
+// The rounding error of `product` = a * b, exactly (Dekker's algorithm
+// where there is no FMA instruction).
+double productError(double a, double b, double product) {
+#ifdef __FMA__
+    return std::fma(a, b, -product);
+#else
+    const double SPLIT = 134217729.0;  // 2^27 + 1.
+    double aSplit = SPLIT * a, bSplit = SPLIT * b;
+    double aHigh = aSplit - (aSplit - a), bHigh = bSplit - (bSplit - b);
+    double aLow = a - aHigh, bLow = b - bHigh;
+    return ((aHigh * bHigh - product) + aHigh * bLow + aLow * bHigh) + aLow * bLow;
+#endif
+}
+
+// The rounding error of `sum` = a + b, exactly (Knuth's two-sum).
+double sumError(double a, double b, double sum) {
+    double virtualB = sum - a;
+    return (a - (sum - virtualB)) + (b - virtualB);
+}
+
+const double LN2_HI = 6.93147180369123816490e-01;  // fdlibm's split of ln 2.
+const double LN2_LO = 1.90821492927058770002e-10;
+const double MIN_NORMAL = 2.2250738585072014e-308;
+
+// log splits x = 2^k z with z in [0.701, 1.402): bits of x minus this
+// offset give k in the top 12 bits and the table entry in the next 7.
+// Entry 76 is centered on 1, so near 1 log x is log1p(z - 1) alone.
+const uint64_t LOG_OFFSET = 0x3FE6700000000000ull;
+
+struct FastMathTables {
+    double exp2[64];  // 2^(j/64).
+    struct LogEntry {  // Gathered with a stride of 4.
+        double center;   // c, the middle of the entry's interval.
+        double inverse;  // 1/c, rounded.
+        double logHigh;  // log c as a double-double.
+        double logLow;
+    } log[128];
+    double sin[128];  // sin(k pi/64), exact at multiples of pi/2.
+};
+
+// Computes the tables in long double, so they are as accurate as doubles
+// allow (the low halves of log to about 2^-64 where long double is wider).
+FastMathTables buildFastMathTables() {
+    const long double PI = 3.141592653589793238462643383279502884L;
+    FastMathTables tables;
+    for (int j = 0; j < 64; ++j) tables.exp2[j] = static_cast<double>(std::exp2(j / 64.0L));
+    for (uint64_t i = 0; i < 128; ++i) {
+        double center = fromBits(LOG_OFFSET + (i << 45) + (1ull << 44));
+        long double log = std::log(static_cast<long double>(center));
+        double high = static_cast<double>(log);
+        tables.log[i] = {center, 1 / center, high, static_cast<double>(log - high)};
+    }
+    for (int k = 0; k < 128; ++k) tables.sin[k] = static_cast<double>(std::sin(k * PI / 64));
+    tables.sin[0] = tables.sin[64] = 0;
+    tables.sin[32] = 1;
+    tables.sin[96] = -1;
+    return tables;
+}
+
+const FastMathTables FAST_MATH_TABLES = buildFastMathTables();
+
+// Taylor coefficients, highest degree first. EXP is (e^r - 1) / r for
+// |r| <= ln 2 / 128, LOG is (log1p(r) - r) / r^2 for |r| <= 2^-8, SIN is
+// (sin y - y) / y^3 and COS is (cos y - 1) / y^2 for |y| <= pi/128; each
+// truncation error is well below the level's bound.
+template <bool Precise>
+struct FastMathCoefficients {
+    static constexpr double EXP[] = {1.0 / 24, 1.0 / 6, 0.5, 1.0};
+    static constexpr double LOG[] = {-1.0 / 6, 1.0 / 5, -1.0 / 4, 1.0 / 3, -0.5};
+    static constexpr double SIN[] = {1.0 / 120, -1.0 / 6};
+    static constexpr double COS[] = {-1.0 / 720, 1.0 / 24, -0.5};
+};
+
+template <>
+struct FastMathCoefficients<false> {
+    static constexpr double EXP[] = {0.5, 1.0};
+    static constexpr double LOG[] = {-1.0 / 4, 1.0 / 3, -0.5};
+    static constexpr double SIN[] = {-1.0 / 6};
+    static constexpr double COS[] = {-0.5};
+};
+
+// e^x = 2^(k/64) e^r with k = round(x 64 / ln 2), given k and r: 2^(k/64)
+// is a table entry with k >> 6 added to its exponent field, e^r comes from
+// the polynomial.
+template <bool Precise>
+double fastExpReduced(double k, double r) {
+    int64_t index = static_cast<int64_t>(k);
+    uint64_t entry = static_cast<uint64_t>(index) & 63;
+    double scale = fromBits(bitsOf(FAST_MATH_TABLES.exp2[entry]) + ((static_cast<uint64_t>(index) - entry) << 46));
+    double p = polynomial(r, FastMathCoefficients<Precise>::EXP) * r;
+    return scale + scale * p;
+}
+
+const double LN2_OVER_64_HI = LN2_HI / 64;
+const double LN2_OVER_64_LO = LN2_LO / 64;
+const double SIXTY_FOUR_OVER_LN2 = 92.332482616893656877;
+
+// e^(high + low) for |high| <= 708, with |low| much smaller than ulp(high).
+template <bool Precise>
+double fastExpCore(double high, double low) {
+    double k = roundToInteger(high * SIXTY_FOUR_OVER_LN2);
+    double r = (high - k * LN2_OVER_64_HI) - k * LN2_OVER_64_LO + low;
+    return fastExpReduced<Precise>(k, r);
+}
+
+template <bool Precise>
+double fastExp(double x) {
+    if (!(std::fabs(x) <= 708)) return std::exp(x);
+    return fastExpCore<Precise>(x, 0);
+}
+
+// k = round(64 x) and r = (x - k/64) ln 2, where the subtraction is exact.
+template <bool Precise>
+double fastExp2(double x) {
+    if (!(std::fabs(x) <= 1020)) return std::exp2(x);
+    double k = roundToInteger(x * 64);
+    return fastExpReduced<Precise>(k, (x - k / 64) * 0.69314718055994530942);
+}
+
+// log x = k ln 2 + high + low for positive normal x: with c the table
+// entry's center, log x = k ln 2 + log c + log1p(r) where r = (z - c) / c.
+// z - c is exact, so r is only rounded relative to itself (which is what
+// keeps the result accurate near 1). With `Exact`, the rounding error of
+// high is kept in low, for pow.
+struct LogParts {
+    double k;
+    double high;
+    double low;
+};
+
+template <bool Precise, bool Exact>
+LogParts fastLogParts(double x) {
+    uint64_t bits = bitsOf(x);
+    uint64_t offset = bits - LOG_OFFSET;
+    const FastMathTables::LogEntry& entry = FAST_MATH_TABLES.log[(offset >> 45) & 127];
+    double z = fromBits(bits - (offset & (0xFFFull << 52)));
+    double r = (z - entry.center) * entry.inverse;
+    double tail = r * r * polynomial(r, FastMathCoefficients<Precise>::LOG);
+    double high = entry.logHigh + r;
+    double low = entry.logLow + tail;
+    if (Exact) low += sumError(entry.logHigh, r, high);
+    return {static_cast<double>(static_cast<int64_t>(offset) >> 52), high, low};
+}
+
+// log x as a double-double for pow (a single double when not Precise).
+template <bool Precise>
+double fastLogCore(double x, double& low) {
+    LogParts parts = fastLogParts<Precise, Precise>(x);
+    if (!Precise) {
+        low = 0;
+        return parts.k * 0.69314718055994530942 + (parts.high + parts.low);
+    }
+    double scaled = parts.k * LN2_HI;
+    double sum = scaled + parts.high;
+    double rest = sumError(scaled, parts.high, sum) + parts.k * LN2_LO + parts.low;
+    double high = sum + rest;
+    low = rest - (high - sum);  // Normalized: |low| <= ulp(high) / 2.
+    return high;
+}
+
+// True for the arguments log handles: positive, normal and finite.
+bool inLogDomain(double x) {
+    return x >= MIN_NORMAL && x < INFINITY;
+}
+
+template <bool Precise>
+double fastLog(double x) {
+    if (!inLogDomain(x)) return std::log(x);
+    LogParts parts = fastLogParts<Precise, false>(x);
+    return parts.k * 0.69314718055994530942 + (parts.high + parts.low);
+}
+
+// log2 and log10 scale only the table and polynomial part, so k stays
+// exact (log2 of a power of two is exact).
+template <bool Precise>
+double fastLog2(double x) {
+    if (!inLogDomain(x)) return std::log2(x);
+    LogParts parts = fastLogParts<Precise, false>(x);
+    return parts.k + (parts.high + parts.low) * 1.44269504088896340736;
+}
+
+template <bool Precise>
+double fastLog10(double x) {
+    if (!inLogDomain(x)) return std::log10(x);
+    LogParts parts = fastLogParts<Precise, false>(x);
+    return parts.k * 0.30102999566398119521 + (parts.high + parts.low) * 0.43429448190325182765;
+}
+
+// x^y = e^(y log x), with y log x as a double-double when Precise: an
+// absolute error e in it is a relative error e in the result, and
+// |y log x| reaches 708. Non-positive, subnormal and non-finite x,
+// non-finite y and overflowing or underflowing results take std::pow.
+template <bool Precise>
+double fastPow(double x, double y) {
+    if (!inLogDomain(x) || !(std::fabs(y) < INFINITY)) return std::pow(x, y);
+    double logLow;
+    double log = fastLogCore<Precise>(x, logLow);
+    double high = y * log;
+    if (!(std::fabs(high) <= 708)) return std::pow(x, y);
+    double low = Precise ? productError(y, log, high) + y * logLow : 0;
+    return fastExpCore<Precise>(high, low);
+}
+
+// x = k pi/64 + y + yy like reducePi<64> does on four lanes; false when the C library
+// must handle x.
+bool reduceSixtyFourthPi(double x, double& k, double& y, double& yy) {
+    const double P1 = 1.57079632673412561417e+00 / 32;
+    const double P2 = 6.07710050630396597660e-11 / 32;
+    const double P2_TAIL = 2.02226624879595063154e-21 / 32;
+    if (!(std::fabs(x) <= 16384)) return false;
+    k = roundToInteger(x * (6.36619772367581382433e-01 * 32));
+    double r = x - k * P1;
+    double w = k * P2;
+    double high = r - w;
+    double low = sumError(r, -w, high) - k * P2_TAIL;
+    y = high + low;
+    yy = low - (y - high);
+    return k == 0 || std::fabs(y) >= 7.450580596923828125e-9;
+}
+
+// sin and cos of k pi/64 + y + yy: the table gives a = k pi/64 and
+// sin(a + y) = sin a + (sin a (cos y - 1) + cos a sin y), so the result
+// is exactly sin y where sin a is zero.
+template <bool Precise>
+void fastSinCosReduced(double k, double y, double yy, double& sine, double& cosine) {
+    int64_t index = static_cast<int64_t>(k);
+    double sinA = FAST_MATH_TABLES.sin[index & 127];
+    double cosA = FAST_MATH_TABLES.sin[(index + 32) & 127];
+    double z = y * y;
+    double sinY = y + (yy + y * z * polynomial(z, FastMathCoefficients<Precise>::SIN));
+    double cosYMinusOne = z * polynomial(z, FastMathCoefficients<Precise>::COS);
+    sine = sinA + (sinA * cosYMinusOne + cosA * sinY);
+    cosine = cosA + (cosA * cosYMinusOne - sinA * sinY);
+}
+
+const double TINY_ARGUMENT = 7.450580596923828125e-9;  // 2^-27.
+
+template <bool Precise>
+double fastSin(double x) {
+    double k, y, yy, sine, cosine;
+    if (std::fabs(x) < TINY_ARGUMENT) return x;
+    if (!reduceSixtyFourthPi(x, k, y, yy)) return std::sin(x);
+    fastSinCosReduced<Precise>(k, y, yy, sine, cosine);
+    return sine;
+}
+
+template <bool Precise>
+double fastCos(double x) {
+    double k, y, yy, sine, cosine;
+    if (std::fabs(x) < TINY_ARGUMENT) return 1;
+    if (!reduceSixtyFourthPi(x, k, y, yy)) return std::cos(x);
+    fastSinCosReduced<Precise>(k, y, yy, sine, cosine);
+    return cosine;
+}
+
+template <bool Precise>
+double fastTan(double x) {
+    double k, y, yy, sine, cosine;
+    if (std::fabs(x) < TINY_ARGUMENT) return x;
+    if (!reduceSixtyFourthPi(x, k, y, yy)) return std::tan(x);
+    fastSinCosReduced<Precise>(k, y, yy, sine, cosine);
+    return sine / cosine;
+}
+
+#ifdef FUNCTIONS_HAS_X86_SIMD
+
+// Four-lane versions of the fast-math functions above, differing from the
+// scalar ones only by FMA contractions.
+
+__attribute__((target("avx2,fma")))
+__m256d sumError(__m256d a, __m256d b, __m256d sum) {
+    __m256d virtualB = _mm256_sub_pd(sum, a);
+    return _mm256_add_pd(_mm256_sub_pd(a, _mm256_sub_pd(sum, virtualB)), _mm256_sub_pd(b, virtualB));
+}
+
+// Converts doubles holding integers below 2^31 in magnitude to int64 lanes.
+__attribute__((target("avx2,fma")))
+__m256i toInt64(__m256d x) {
+    return _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(x));
+}
+
+template <bool Precise>
+__attribute__((target("avx2,fma")))
+__m256d fastExpReduced(__m256d k, __m256d r) {
+    __m256i index = toInt64(k);
+    __m256i entry = _mm256_and_si256(index, _mm256_set1_epi64x(63));
+    __m256d table = _mm256_i64gather_pd(FAST_MATH_TABLES.exp2, entry, 8);
+    __m256d scale = _mm256_castsi256_pd(_mm256_add_epi64(
+        _mm256_castpd_si256(table), _mm256_slli_epi64(_mm256_sub_epi64(index, entry), 46)));
+    __m256d p = _mm256_mul_pd(polynomial(r, FastMathCoefficients<Precise>::EXP), r);
+    return _mm256_fmadd_pd(scale, p, scale);
+}
+
+template <bool Precise>
+__attribute__((target("avx2,fma")))
+__m256d fastExpCore(__m256d high, __m256d low) {
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(high, _mm256_set1_pd(SIXTY_FOUR_OVER_LN2)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_OVER_64_HI), high);
+    r = _mm256_add_pd(_mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_OVER_64_LO), r), low);
+    return fastExpReduced<Precise>(k, r);
+}
+
+// Lanes where |x| > limit or x is NaN.
+__attribute__((target("avx2,fma")))
+int beyond(__m256d x, double limit) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(absolute(x), _mm256_set1_pd(limit), _CMP_NLE_UQ));
+}
+
+struct VectorLogParts {
+    __m256d k;
+    __m256d high;
+    __m256d low;
+};
+
+template <bool Precise, bool Exact>
+__attribute__((target("avx2,fma")))
+VectorLogParts fastLogParts(__m256d x) {
+    const double* table = &FAST_MATH_TABLES.log[0].center;
+    __m256i bits = _mm256_castpd_si256(x);
+    __m256i offset = _mm256_sub_epi64(bits, _mm256_set1_epi64x(LOG_OFFSET));
+    __m256i entry = _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(offset, 45), _mm256_set1_epi64x(127)), 2);
+    __m256d center = _mm256_i64gather_pd(table, entry, 8);
+    __m256d inverse = _mm256_i64gather_pd(table + 1, entry, 8);
+    __m256d logHigh = _mm256_i64gather_pd(table + 2, entry, 8);
+    __m256d logLow = _mm256_i64gather_pd(table + 3, entry, 8);
+    __m256d z = _mm256_castsi256_pd(
+        _mm256_sub_epi64(bits, _mm256_and_si256(offset, _mm256_set1_epi64x(0xFFFull << 52))));
+
+    // k = offset >> 52 (arithmetic): shift the high halves, then gather them.
+    __m256i shifted = _mm256_permutevar8x32_epi32(_mm256_srai_epi32(offset, 20), _mm256_setr_epi32(1, 3, 5, 7, 0, 0, 0, 0));
+
+    VectorLogParts parts;
+    parts.k = _mm256_cvtepi32_pd(_mm256_castsi256_si128(shifted));
+    __m256d r = _mm256_mul_pd(_mm256_sub_pd(z, center), inverse);
+    __m256d tail = _mm256_mul_pd(_mm256_mul_pd(r, r), polynomial(r, FastMathCoefficients<Precise>::LOG));
+    parts.high = _mm256_add_pd(logHigh, r);
+    parts.low = _mm256_add_pd(logLow, tail);
+    if (Exact) parts.low = _mm256_add_pd(parts.low, sumError(logHigh, r, parts.high));
+    return parts;
+}
+
+template <bool Precise>
+__attribute__((target("avx2,fma")))
+__m256d fastLogCore(__m256d x, __m256d& low) {
+    VectorLogParts parts = fastLogParts<Precise, Precise>(x);
+    if (!Precise) {
+        low = _mm256_setzero_pd();
+        return _mm256_fmadd_pd(parts.k, _mm256_set1_pd(0.69314718055994530942), _mm256_add_pd(parts.high, parts.low));
+    }
+    __m256d scaled = _mm256_mul_pd(parts.k, _mm256_set1_pd(LN2_HI));
+    __m256d sum = _mm256_add_pd(scaled, parts.high);
+    __m256d rest = _mm256_fmadd_pd(parts.k, _mm256_set1_pd(LN2_LO), _mm256_add_pd(sumError(scaled, parts.high, sum), parts.low));
+    __m256d high = _mm256_add_pd(sum, rest);
+    low = _mm256_sub_pd(rest, _mm256_sub_pd(high, sum));
+    return high;
+}
+
+// Lanes outside the log domain: below the least normal, infinite or NaN.
+__attribute__((target("avx2,fma")))
+int outsideLogDomain(__m256d x) {
+    return _mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(x, _mm256_set1_pd(MIN_NORMAL), _CMP_NGE_UQ),
+                                           _mm256_cmp_pd(x, _mm256_set1_pd(INFINITY), _CMP_NLT_UQ)));
+}
+
+template <bool Precise>
+__attribute__((target("avx2,fma")))
+void fastSinCosReduced(const Reduced& reduced, __m256d& sine, __m256d& cosine) {
+    __m256i mask = _mm256_set1_epi64x(127);
+    __m256d sinA = _mm256_i64gather_pd(FAST_MATH_TABLES.sin, _mm256_and_si256(reduced.k, mask), 8);
+    __m256d cosA = _mm256_i64gather_pd(
+        FAST_MATH_TABLES.sin, _mm256_and_si256(_mm256_add_epi64(reduced.k, _mm256_set1_epi64x(32)), mask), 8);
+    __m256d y = reduced.y;
+    __m256d z = _mm256_mul_pd(y, y);
+    __m256d sinY = _mm256_add_pd(
+        y, _mm256_fmadd_pd(_mm256_mul_pd(y, z), polynomial(z, FastMathCoefficients<Precise>::SIN), reduced.yy));
+    __m256d cosYMinusOne = _mm256_mul_pd(z, polynomial(z, FastMathCoefficients<Precise>::COS));
+    sine = _mm256_add_pd(sinA, _mm256_fmadd_pd(sinA, cosYMinusOne, _mm256_mul_pd(cosA, sinY)));
+    cosine = _mm256_add_pd(cosA, _mm256_fmsub_pd(cosA, cosYMinusOne, _mm256_mul_pd(sinA, sinY)));
+}
+
+#endif  // FUNCTIONS_HAS_X86_SIMD
+
+// Kernels for the fast tables, in the shape of the ones above.
+
+template <bool Precise>
+struct FastExpKernel {
+    static double scalar(double x) { return fastExp<Precise>(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        fallback = beyond(x, 708);
+        return fastExpCore<Precise>(x, _mm256_setzero_pd());
+    }
+#endif
+};
+
+template <bool Precise>
+struct FastExp2Kernel {
+    static double scalar(double x) { return fastExp2<Precise>(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        fallback = beyond(x, 1020);
+        __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(64.0)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d r = _mm256_mul_pd(_mm256_fnmadd_pd(k, _mm256_set1_pd(1.0 / 64), x), _mm256_set1_pd(0.69314718055994530942));
+        return fastExpReduced<Precise>(k, r);
+    }
+#endif
+};
+
+template <bool Precise>
+struct FastLogKernel {
+    static double scalar(double x) { return fastLog<Precise>(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        fallback = outsideLogDomain(x);
+        VectorLogParts parts = fastLogParts<Precise, false>(x);
+        return _mm256_fmadd_pd(parts.k, _mm256_set1_pd(0.69314718055994530942), _mm256_add_pd(parts.high, parts.low));
+    }
+#endif
+};
+
+template <bool Precise>
+struct FastLog2Kernel {
+    static double scalar(double x) { return fastLog2<Precise>(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        fallback = outsideLogDomain(x);
+        VectorLogParts parts = fastLogParts<Precise, false>(x);
+        return _mm256_fmadd_pd(_mm256_add_pd(parts.high, parts.low), _mm256_set1_pd(1.44269504088896340736), parts.k);
+    }
+#endif
+};
+
+template <bool Precise>
+struct FastLog10Kernel {
+    static double scalar(double x) { return fastLog10<Precise>(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        fallback = outsideLogDomain(x);
+        VectorLogParts parts = fastLogParts<Precise, false>(x);
+        return _mm256_fmadd_pd(_mm256_add_pd(parts.high, parts.low), _mm256_set1_pd(0.43429448190325182765),
+                               _mm256_mul_pd(parts.k, _mm256_set1_pd(0.30102999566398119521)));
+    }
+#endif
+};
+
+template <bool Precise>
+struct FastPowKernel {
+    static double scalar(double x, double y) { return fastPow<Precise>(x, y); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, __m256d y, int& fallback) {
+        __m256d logLow;
+        __m256d log = fastLogCore<Precise>(x, logLow);
+        __m256d high = _mm256_mul_pd(y, log);
+        __m256d low = _mm256_setzero_pd();
+        if (Precise) low = _mm256_fmadd_pd(y, logLow, _mm256_fmsub_pd(y, log, high));
+        fallback = outsideLogDomain(x) | beyond(y, DBL_MAX) | beyond(high, 708);
+        return fastExpCore<Precise>(high, low);
+    }
+#endif
+};
+
+template <bool Precise>
+struct FastSinKernel {
+    static double scalar(double x) { return fastSin<Precise>(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        Reduced reduced = reducePi<64>(x);
+        fallback = reduced.fallback;
+        __m256d sine, cosine;
+        fastSinCosReduced<Precise>(reduced, sine, cosine);
+        return _mm256_blendv_pd(sine, x, tinyArgument(x));
+    }
+#endif
+};
+
+template <bool Precise>
+struct FastCosKernel {
+    static double scalar(double x) { return fastCos<Precise>(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        Reduced reduced = reducePi<64>(x);
+        fallback = reduced.fallback;
+        __m256d sine, cosine;
+        fastSinCosReduced<Precise>(reduced, sine, cosine);
+        return _mm256_blendv_pd(cosine, _mm256_set1_pd(1.0), tinyArgument(x));
+    }
+#endif
+};
+
+template <bool Precise>
+struct FastTanKernel {
+    static double scalar(double x) { return fastTan<Precise>(x); }
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    __attribute__((target("avx2,fma")))
+    static __m256d apply(__m256d x, int& fallback) {
+        Reduced reduced = reducePi<64>(x);
+        fallback = reduced.fallback;
+        __m256d sine, cosine;
+        fastSinCosReduced<Precise>(reduced, sine, cosine);
+        return _mm256_blendv_pd(_mm256_div_pd(sine, cosine), x, tinyArgument(x));
+    }
+#endif
+};
+
+// Resolves function names; slots are FunctionIds.
+const SymbolTable& functionSymbols() {
+    static const SymbolTable symbols = [] {
+        std::vector<std::string> names;
+        for (const FunctionInfo& info : FUNCTIONS) names.push_back(info.name);
+        return SymbolTable(std::move(names));
+    }();
+    return symbols;
+}
+
+}  // namespace
+
+// Indexed by FunctionId; the order must match the enum.
+const FunctionInfo FUNCTIONS[FUNCTION_COUNT] = {
+    {"sqrt", 1, SqrtKernel::scalar, nullptr, unaryBatch<SqrtKernel>, nullptr, 0},
+    {"cbrt", 1, scalarCbrt, nullptr, unaryLoop<scalarCbrt>, nullptr, 0},
+    {"exp", 1, ExpKernel::scalar, nullptr, unaryBatch<ExpKernel>, nullptr, 1},
+    {"exp2", 1, scalarExp2, nullptr, unaryLoop<scalarExp2>, nullptr, 0},
+    {"log", 1, LogKernel::scalar, nullptr, unaryBatch<LogKernel>, nullptr, 1},
+    {"log2", 1, scalarLog2, nullptr, unaryLoop<scalarLog2>, nullptr, 0},
+    {"log10", 1, scalarLog10, nullptr, unaryLoop<scalarLog10>, nullptr, 0},
+    {"sin", 1, SinKernel::scalar, nullptr, unaryBatch<SinKernel>, nullptr, 1},
+    {"cos", 1, CosKernel::scalar, nullptr, unaryBatch<CosKernel>, nullptr, 1},
+    {"tan", 1, TanKernel::scalar, nullptr, unaryBatch<TanKernel>, nullptr, 2},
+    {"asin", 1, scalarAsin, nullptr, unaryLoop<scalarAsin>, nullptr, 0},
+    {"acos", 1, scalarAcos, nullptr, unaryLoop<scalarAcos>, nullptr, 0},
+    {"atan", 1, scalarAtan, nullptr, unaryLoop<scalarAtan>, nullptr, 0},
+    {"sinh", 1, scalarSinh, nullptr, unaryLoop<scalarSinh>, nullptr, 0},
+    {"cosh", 1, scalarCosh, nullptr, unaryLoop<scalarCosh>, nullptr, 0},
+    {"tanh", 1, scalarTanh, nullptr, unaryLoop<scalarTanh>, nullptr, 0},
+    {"abs", 1, AbsKernel::scalar, nullptr, unaryBatch<AbsKernel>, nullptr, 0},
+    {"floor", 1, FloorKernel::scalar, nullptr, unaryBatch<FloorKernel>, nullptr, 0},
+    {"ceil", 1, CeilKernel::scalar, nullptr, unaryBatch<CeilKernel>, nullptr, 0},
+    {"trunc", 1, TruncKernel::scalar, nullptr, unaryBatch<TruncKernel>, nullptr, 0},
+    {"round", 1, RoundKernel::scalar, nullptr, unaryBatch<RoundKernel>, nullptr, 0},
+    {"min", 2, nullptr, MinKernel::scalar, nullptr, binaryBatch<MinKernel>, 0},
+    {"max", 2, nullptr, MaxKernel::scalar, nullptr, binaryBatch<MaxKernel>, 0},
+    {"pow", 2, nullptr, scalarPow, nullptr, binaryLoop<scalarPow>, 0},
+    {"atan2", 2, nullptr, scalarAtan2, nullptr, binaryLoop<scalarAtan2>, 0},
+    {"hypot", 2, nullptr, scalarHypot, nullptr, binaryLoop<scalarHypot>, 0},
+    {"fmod", 2, nullptr, scalarFmod, nullptr, binaryLoop<scalarFmod>, 0},
+};
+
+namespace {
+
+// FUNCTIONS with the approximated entries replaced. The batches run the
+// scalar algorithm but with FMA, which rounds less, so the two only share
+// the level's bound: they differ by at most twice it, expressed in ulps.
+template <bool Precise>
+const FunctionInfo* fastFunctionTable() {
+    static const std::array<FunctionInfo, FUNCTION_COUNT> table = [] {
+        const double ulps = 2 * (Precise ? 1e-12 : 1e-7) * 9007199254740992.0;  // 2^53 ulps per unit.
+        std::array<FunctionInfo, FUNCTION_COUNT> entries;
+        std::copy(FUNCTIONS, FUNCTIONS + FUNCTION_COUNT, entries.begin());
+        auto unary = [&](FunctionId id, UnaryFunction scalar, UnaryBatch batch) {
+            FunctionInfo& info = entries[static_cast<size_t>(id)];
+            info.unary = scalar;
+            info.unaryBatch = batch;
+            info.batchUlps = ulps;
+        };
+        unary(FunctionId::EXP, FastExpKernel<Precise>::scalar, unaryBatch<FastExpKernel<Precise>>);
+        unary(FunctionId::EXP2, FastExp2Kernel<Precise>::scalar, unaryBatch<FastExp2Kernel<Precise>>);
+        unary(FunctionId::LOG, FastLogKernel<Precise>::scalar, unaryBatch<FastLogKernel<Precise>>);
+        unary(FunctionId::LOG2, FastLog2Kernel<Precise>::scalar, unaryBatch<FastLog2Kernel<Precise>>);
+        unary(FunctionId::LOG10, FastLog10Kernel<Precise>::scalar, unaryBatch<FastLog10Kernel<Precise>>);
+        unary(FunctionId::SIN, FastSinKernel<Precise>::scalar, unaryBatch<FastSinKernel<Precise>>);
+        unary(FunctionId::COS, FastCosKernel<Precise>::scalar, unaryBatch<FastCosKernel<Precise>>);
+        unary(FunctionId::TAN, FastTanKernel<Precise>::scalar, unaryBatch<FastTanKernel<Precise>>);
+        FunctionInfo& pow = entries[static_cast<size_t>(FunctionId::POW)];
+        pow.binary = FastPowKernel<Precise>::scalar;
+        pow.binaryBatch = binaryBatch<FastPowKernel<Precise>>;
+        pow.batchUlps = ulps;
+        return entries;
+    }();
+    return table.data();
+}
+
+MathAccuracy selectedAccuracy = MathAccuracy::FULL;
+
+}  // namespace
+
+const FunctionInfo* activeFunctionTable = FUNCTIONS;
+
+// The bounds the fast kernels are designed (and benchmarked) against.
+double mathAccuracyBound(MathAccuracy accuracy) {
+    switch (accuracy) {
+        case MathAccuracy::RELATIVE_1E12: return 1e-12;
+        case MathAccuracy::RELATIVE_1E7:  return 1e-7;
+        default:                          return 0;
+    }
+}
+
+// Picks the cheaper fast level when the tolerance allows it.
+MathAccuracy mathAccuracyFor(double tolerance) {
+    if (tolerance >= 1e-7) return MathAccuracy::RELATIVE_1E7;
+    if (tolerance >= 1e-12) return MathAccuracy::RELATIVE_1E12;
+    throw std::runtime_error("Fast math supports relative errors of 1e-12 and above");
+}
+
+// Builds the fast tables on first use.
+const FunctionInfo* functionTable(MathAccuracy accuracy) {
+    switch (accuracy) {
+        case MathAccuracy::RELATIVE_1E12: return fastFunctionTable<true>();
+        case MathAccuracy::RELATIVE_1E7:  return fastFunctionTable<false>();
+        default:                          return FUNCTIONS;
+    }
+}
+
+// Swaps the table pointer that functionInfo reads.
+void setMathAccuracy(MathAccuracy accuracy) {
+    activeFunctionTable = functionTable(accuracy);
+    selectedAccuracy = accuracy;
+}
+
+// The level of activeFunctionTable.
+MathAccuracy mathAccuracy() {
+    return selectedAccuracy;
+}
+
+// One perfect-hash lookup.
+uint32_t findFunction(std::string_view name) {
+    return functionSymbols().find(name);
+}
+
+// Reports which batch implementations `unaryBatch` and `binaryBatch` run.
+const char* functionBatchImplementationName() {
+#ifdef FUNCTIONS_HAS_X86_SIMD
+    if (hasAvx2Fma()) return "avx2";
+#endif
+    return "scalar";
+}
+
+// Builds the arity error message for a call.
+std::string argumentCountMessage(uint32_t id, size_t given) {
+    const FunctionInfo& info = FUNCTIONS[id];
+    return "Syntax Error: " + std::string(info.name) + " expects " + std::to_string(info.arity) +
+           (info.arity == 1 ? " argument, got " : " arguments, got ") + std::to_string(given);
+}
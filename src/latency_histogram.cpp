@@ -0,0 +1,108 @@
+#include "latency_histogram.h"
+#include <ostream>
+#include <unordered_map>
+
+// Copies counts from another histogram.
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other) {
+    if (this != &other) {
+        reset();
+        merge(other);
+    }
+    return *this;
+}
+
+// Adds every count from another histogram.
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        uint64_t count = other.counts_[i].load(std::memory_order_relaxed);
+        if (count) counts_[i].fetch_add(count, std::memory_order_relaxed);
+    }
+    uint64_t otherMax = other.max();
+    if (otherMax > max()) max_.store(otherMax, std::memory_order_relaxed);
+}
+
+// Clears all counts.
+void LatencyHistogram::reset() {
+    for (auto& count : counts_) count.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+// Returns the number of recorded values.
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (const auto& count : counts_) total += count.load(std::memory_order_relaxed);
+    return total;
+}
+
+// Returns the smallest value in a bucket.
+uint64_t LatencyHistogram::bucketLowerBound(size_t index) {
+    uint64_t exponent = index >> SUB_BUCKET_BITS;
+    uint64_t subBucket = index & (SUB_BUCKETS - 1);
+    if (exponent == 0) return subBucket;
+    return (SUB_BUCKETS + subBucket) << (exponent - 1);
+}
+
+// Returns the largest value in a bucket.
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    uint64_t exponent = index >> SUB_BUCKET_BITS;
+    uint64_t width = exponent == 0 ? 1 : uint64_t{1} << (exponent - 1);
+    return bucketLowerBound(index) + (width - 1);
+}
+
+// Walks the buckets until the requested rank is reached.
+uint64_t LatencyHistogram::percentile(double percentile) const {
+    uint64_t total = count();
+    if (total == 0) return 0;
+
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t upper = bucketUpperBound(i);
+            return upper < max() ? upper : max();
+        }
+    }
+    return max();
+}
+
+// Writes the standard percentile summary.
+void LatencyHistogram::printPercentiles(std::ostream& os, const char* unit) const {
+    os << "count=" << count()
+       << " p50=" << percentile(50) << unit
+       << " p90=" << percentile(90) << unit
+       << " p99=" << percentile(99) << unit
+       << " p99.9=" << percentile(99.9) << unit
+       << " max=" << max() << unit;
+}
+
+// Gives the set a process-unique id.
+ThreadLatencyHistograms::ThreadLatencyHistograms() {
+    static std::atomic<uint64_t> nextId{0};
+    id_ = nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Returns the calling thread's histogram in this set.
+LatencyHistogram& ThreadLatencyHistograms::local() {
+    // Cache per (thread, set) so the lock is only taken on first use.
+    thread_local std::unordered_map<uint64_t, LatencyHistogram*> cache;
+    auto it = cache.find(id_);
+    if (it != cache.end()) return *it->second;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    histograms_.push_back(std::make_unique<LatencyHistogram>());
+    LatencyHistogram* histogram = histograms_.back().get();
+    cache.emplace(id_, histogram);
+    return *histogram;
+}
+
+// Sums every thread's histogram.
+LatencyHistogram ThreadLatencyHistograms::merged() const {
+    LatencyHistogram total;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& histogram : histograms_) total.merge(*histogram);
+    return total;
+}
@@ -0,0 +1,331 @@
+#include "npy.h"
+#include "columnar.h"
+#include "trace.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NPY_HAS_MMAP 1
+#endif
+
+namespace {
+
+const char NPY_MAGIC[] = "\x93NUMPY";
+const size_t NPY_MAGIC_BYTES = 6;
+
+// Returns true if the CPU stores the low byte of a word first, as the
+// accepted '<' types do.
+bool hostLittleEndian() {
+    const uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Returns the text of the value of `key` in a Python dict literal: a quoted
+// string without its quotes, a tuple with its parentheses, or a bare word.
+// Returns an empty view if the key is missing.
+std::string_view dictValue(std::string_view dict, std::string_view key) {
+    size_t position = dict.find("'" + std::string(key) + "'");
+    if (position == std::string_view::npos) return {};
+    position = dict.find(':', position + key.size() + 2);
+    if (position == std::string_view::npos) return {};
+    position = dict.find_first_not_of(' ', position + 1);
+    if (position == std::string_view::npos) return {};
+
+    char open = dict[position];
+    size_t end;
+    if (open == '\'' || open == '"') {
+        ++position;
+        end = dict.find(open, position);
+    } else if (open == '(') {
+        end = dict.find(')', position);
+        if (end != std::string_view::npos) ++end;
+    } else {
+        end = dict.find_first_of(",}", position);
+    }
+    if (end == std::string_view::npos) return {};
+    return dict.substr(position, end - position);
+}
+
+// Bytes of one element of `type`.
+size_t elementBytes(NpyType type) {
+    return type == NpyType::FLOAT32 ? 4 : 8;
+}
+
+// Reads a little-endian integer of `bytes` bytes.
+size_t readLittleEndian(const char* data, size_t bytes) {
+    size_t value = 0;
+    for (size_t i = bytes; i-- > 0;) value = value << 8 | static_cast<unsigned char>(data[i]);
+    return value;
+}
+
+// Converts `count` elements of `Stored` at `data` (any alignment) to double.
+template <typename Stored>
+void convertElements(const char* data, size_t count, double* out) {
+    for (size_t i = 0; i < count; ++i) {
+        Stored value;
+        std::memcpy(&value, data + i * sizeof(Stored), sizeof(Stored));
+        out[i] = static_cast<double>(value);
+    }
+}
+
+}  // namespace
+
+// Checks the preamble, then reads the three keys from the dict.
+NpyHeader parseNpyHeader(const char* data, size_t size, const std::string& path) {
+    auto fail = [&](const std::string& reason) {
+        return std::runtime_error("Invalid .npy file " + path + ": " + reason);
+    };
+    if (size < 10 || std::memcmp(data, NPY_MAGIC, NPY_MAGIC_BYTES) != 0) throw fail("missing the NUMPY magic");
+    const int major = static_cast<unsigned char>(data[6]);
+    if (major < 1 || major > 3) throw fail("unsupported version " + std::to_string(major));
+    const size_t lengthBytes = major == 1 ? 2 : 4;
+    if (size < 8 + lengthBytes) throw fail("truncated header");
+    const size_t dictBytes = readLittleEndian(data + 8, lengthBytes);
+    NpyHeader header;
+    header.dataOffset = 8 + lengthBytes + dictBytes;
+    if (header.dataOffset > size) throw fail("truncated header");
+    const std::string_view dict(data + 8 + lengthBytes, dictBytes);
+
+    const std::string_view descr = dictValue(dict, "descr");
+    if (descr.size() != 3 || (descr[0] != '<' && descr[0] != '=')) {
+        throw fail("unsupported dtype '" + std::string(descr) + "' (need little-endian f8, f4 or i8)");
+    }
+    const std::string_view kind = descr.substr(1);
+    if (kind == "f8") {
+        header.type = NpyType::FLOAT64;
+    } else if (kind == "f4") {
+        header.type = NpyType::FLOAT32;
+    } else if (kind == "i8") {
+        header.type = NpyType::INT64;
+    } else {
+        throw fail("unsupported dtype '" + std::string(descr) + "' (need f8, f4 or i8)");
+    }
+    if (!hostLittleEndian()) throw fail("little-endian data on a big-endian host");
+
+    const std::string_view order = dictValue(dict, "fortran_order");
+    if (order != "False" && order != "True") throw fail("missing 'fortran_order'");
+
+    const std::string_view shape = dictValue(dict, "shape");
+    if (shape.size() < 2 || shape.front() != '(' || shape.back() != ')') throw fail("missing 'shape'");
+    header.count = 1;
+    size_t longDimensions = 0;
+    for (size_t position = 1; position + 1 < shape.size();) {
+        if (shape[position] == ' ' || shape[position] == ',') {
+            ++position;
+            continue;
+        }
+        size_t dimension = 0;
+        const size_t digitsBegin = position;
+        while (position + 1 < shape.size() && shape[position] >= '0' && shape[position] <= '9') {
+            dimension = dimension * 10 + static_cast<size_t>(shape[position++] - '0');
+        }
+        if (position == digitsBegin) throw fail("malformed shape " + std::string(shape));
+        if (dimension > 1) ++longDimensions;
+        header.count *= dimension;
+    }
+    if (longDimensions > 1) throw fail("shape " + std::string(shape) + " is not a single column");
+
+    if ((size - header.dataOffset) / elementBytes(header.type) < header.count) throw fail("truncated data");
+    return header;
+}
+
+// Maps the whole file; the header is parsed in place.
+NpyArray::NpyArray(const std::string& path) {
+#ifdef NPY_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 || ::fstat(fd, &status) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Could not open .npy file: " + path);
+    }
+    mapBytes_ = static_cast<size_t>(status.st_size);
+    if (mapBytes_ > 0) map_ = ::mmap(nullptr, mapBytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map_ == MAP_FAILED) map_ = nullptr;
+    if (mapBytes_ > 0 && !map_) throw std::runtime_error("Could not map .npy file: " + path);
+    file_ = static_cast<const char*>(map_);
+    try {
+        header_ = parseNpyHeader(file_, mapBytes_, path);
+    } catch (const std::runtime_error&) {
+        if (map_) ::munmap(map_, mapBytes_);
+        throw;
+    }
+    if (map_) ::madvise(map_, mapBytes_, MADV_SEQUENTIAL);
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Could not open .npy file: " + path);
+    copy_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    file_ = copy_.data();
+    mapBytes_ = copy_.size();
+    header_ = parseNpyHeader(file_, mapBytes_, path);
+#endif
+}
+
+NpyArray::~NpyArray() {
+#ifdef NPY_HAS_MMAP
+    if (map_) ::munmap(map_, mapBytes_);
+    map_ = nullptr;
+#endif
+}
+
+// Direct use needs float64 data at a multiple of 8 bytes, which every
+// writer following the format (data at a multiple of 16 or 64) provides.
+const double* NpyArray::float64() const {
+    const char* data = file_ + header_.dataOffset;
+    if (header_.type != NpyType::FLOAT64 || reinterpret_cast<uintptr_t>(data) % alignof(double) != 0) {
+        return nullptr;
+    }
+    return reinterpret_cast<const double*>(data);
+}
+
+// Converts by element type.
+void NpyArray::read(size_t begin, size_t count, double* out) const {
+    const char* data = file_ + header_.dataOffset + begin * elementBytes(header_.type);
+    switch (header_.type) {
+        case NpyType::FLOAT64: std::memcpy(out, data, count * sizeof(double)); break;
+        case NpyType::FLOAT32: convertElements<float>(data, count, out); break;
+        case NpyType::INT64:   convertElements<int64_t>(data, count, out); break;
+    }
+}
+
+// Pads the dict with spaces and a newline, as numpy does.
+std::string npyFloat64Header(size_t count) {
+    std::string dict = "{'descr': '<f8', 'fortran_order': False, 'shape': (" + std::to_string(count) + ",), }";
+    const size_t preamble = NPY_MAGIC_BYTES + 4;
+    const size_t unpadded = preamble + dict.size() + 1;
+    dict.append((64 - unpadded % 64) % 64, ' ');
+    dict += '\n';
+
+    std::string header(NPY_MAGIC, NPY_MAGIC_BYTES);
+    header += '\x01';
+    header += '\x00';
+    header += static_cast<char>(dict.size() & 0xFF);
+    header += static_cast<char>(dict.size() >> 8);
+    return header + dict;
+}
+
+// Sizes a temporary file next to `path` up front and maps it, so evaluation
+// writes into the page cache directly. The target is only replaced by
+// `finish`, so an input that is also the output stays intact while it is
+// read.
+NpyWriter::NpyWriter(const std::string& path, size_t count) : path_(path) {
+    const std::string header = npyFloat64Header(count);
+    mapBytes_ = header.size() + count * sizeof(double);
+#ifdef NPY_HAS_MMAP
+    tempPath_ = path + ".tmp" + std::to_string(::getpid());
+    int fd = ::open(tempPath_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) throw std::runtime_error("Could not create .npy file: " + tempPath_);
+    if (::ftruncate(fd, static_cast<off_t>(mapBytes_)) == 0) {
+        map_ = ::mmap(nullptr, mapBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map_ == MAP_FAILED) map_ = nullptr;
+    }
+    ::close(fd);
+    if (!map_) {
+        std::remove(tempPath_.c_str());
+        throw std::runtime_error("Could not map .npy file: " + tempPath_);
+    }
+    char* file = static_cast<char*>(map_);
+#else
+    tempPath_ = path + ".tmp";
+    buffer_.resize(mapBytes_);
+    char* file = buffer_.data();
+#endif
+    std::memcpy(file, header.data(), header.size());
+    data_ = reinterpret_cast<double*>(file + header.size());
+}
+
+// A writer that was never finished leaves the target untouched.
+NpyWriter::~NpyWriter() {
+    if (finished_) return;
+#ifdef NPY_HAS_MMAP
+    if (map_) ::munmap(map_, mapBytes_);
+#endif
+    std::remove(tempPath_.c_str());
+}
+
+// Unmaps the temporary file, or writes the buffer to it where there is no
+// mapping, then renames it over the target.
+void NpyWriter::finish() {
+    if (finished_) return;
+    finished_ = true;
+#ifdef NPY_HAS_MMAP
+    ::munmap(map_, mapBytes_);
+    map_ = nullptr;
+#else
+    std::ofstream out(tempPath_, std::ios::binary);
+    out.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    out.close();
+    if (!out) {
+        std::remove(tempPath_.c_str());
+        throw std::runtime_error("Could not write .npy file: " + tempPath_);
+    }
+#endif
+    if (std::rename(tempPath_.c_str(), path_.c_str()) != 0) {
+        std::remove(tempPath_.c_str());
+        throw std::runtime_error("Could not write .npy file: " + path_);
+    }
+}
+
+// Gives each slot a column per block: the array itself when it is float64,
+// converted elements otherwise, and a constant column for variables
+// without an array.
+StreamErrors evaluateNpy(const PostfixProgram& program, const Environment& environment,
+                         const std::vector<const NpyArray*>& arrays, size_t count, double* out) {
+    const size_t slots = program.variableCount;
+    std::vector<std::vector<double>> buffers(slots);
+    std::vector<const double*> columns(slots);
+    for (uint32_t slot = 0; slot < slots; ++slot) {
+        if (!arrays[slot]) {
+            buffers[slot].assign(NPY_BLOCK_ROWS, environment[slot]);
+        } else if (!arrays[slot]->float64()) {
+            buffers[slot].resize(NPY_BLOCK_ROWS);
+        }
+    }
+    std::vector<double> row(environment.values(), environment.values() + environment.size());
+
+    StreamErrors errors;
+    for (size_t begin = 0; begin < count; begin += NPY_BLOCK_ROWS) {
+        const size_t rows = count - begin < NPY_BLOCK_ROWS ? count - begin : NPY_BLOCK_ROWS;
+        traced("read", [&] {
+            for (uint32_t slot = 0; slot < slots; ++slot) {
+                const NpyArray* array = arrays[slot];
+                if (!array) {
+                    columns[slot] = buffers[slot].data();
+                } else if (const double* values = array->float64()) {
+                    columns[slot] = values + begin;
+                } else {
+                    array->read(begin, rows, buffers[slot].data());
+                    columns[slot] = buffers[slot].data();
+                }
+            }
+        });
+
+        traced("evaluate", [&] {
+            try {
+                evaluateColumns(program, columns.data(), rows, out + begin);
+            } catch (const std::runtime_error&) {
+                for (size_t r = 0; r < rows; ++r) {
+                    for (uint32_t slot = 0; slot < slots; ++slot) row[slot] = columns[slot][r];
+                    try {
+                        out[begin + r] = evaluate(program, row.data());
+                    } catch (const std::runtime_error& e) {
+                        out[begin + r] = NAN;
+                        errors.record(begin + r, e.what());
+                    }
+                }
+            }
+        });
+    }
+    return errors;
+}
@@ -0,0 +1,170 @@
+#include "number_stream.h"
+#include "columnar.h"
+#include "trace.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Longest output of std::to_chars for a double plus the newline.
+const size_t MAX_NUMBER_TEXT = 32;
+
+// The whitespace that separates numbers: ' ' and '\t' .. '\r'.
+inline bool isSeparator(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+}  // namespace
+
+// Skips a '+' that from_chars would reject; strtod handles out-of-range
+// values, which from_chars reports as errors.
+bool parseNumber(const char* first, const char* last, double& value) {
+    if (first != last && *first == '+' && last - first > 1 && first[1] != '-') ++first;
+    std::from_chars_result result = std::from_chars(first, last, value);
+    if (result.ptr != last) return false;
+    if (result.ec == std::errc::result_out_of_range) {
+        value = std::strtod(std::string(first, last).c_str(), nullptr);
+        return true;
+    }
+    return result.ec == std::errc();
+}
+
+// Keeps the message of the lowest index only.
+void StreamErrors::record(uint64_t index, const std::string& message) {
+    if (count++ == 0 || index < firstIndex) {
+        firstIndex = index;
+        first = message;
+    }
+}
+
+// Adds the other part's count, keeping the earlier first problem.
+void StreamErrors::merge(const StreamErrors& other) {
+    if (other.count != 0 && (count == 0 || other.firstIndex < firstIndex)) {
+        firstIndex = other.firstIndex;
+        first = other.first;
+    }
+    count += other.count;
+}
+
+NumberReader::NumberReader(std::istream& in, size_t chunkBytes) : in_(in), buffer_(chunkBytes) {}
+
+// Reads until the buffer is full or the input ends.
+bool NumberReader::refill() {
+    if (eof_) return false;
+    if (begin_ > 0) {
+        std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    if (end_ == buffer_.size()) buffer_.resize(2 * buffer_.size());
+
+    in_.read(buffer_.data() + end_, static_cast<std::streamsize>(buffer_.size() - end_));
+    size_t received = static_cast<size_t>(in_.gcount());
+    end_ += received;
+    if (!in_) eof_ = true;  // A short read means the end of the input.
+    return received > 0;
+}
+
+// Finds each field by its trailing separator; a field that reaches the end
+// of the buffer is completed by a refill before it is parsed.
+size_t NumberReader::read(double* out, size_t capacity) {
+    size_t count = 0;
+    while (count < capacity) {
+        while (begin_ < end_ && isSeparator(buffer_[begin_])) ++begin_;
+        if (begin_ == end_) {
+            if (!refill()) break;
+            continue;
+        }
+
+        size_t fieldEnd = begin_;
+        while (fieldEnd < end_ && !isSeparator(buffer_[fieldEnd])) ++fieldEnd;
+        if (fieldEnd == end_ && !eof_) {
+            refill();
+            continue;
+        }
+
+        const char* first = buffer_.data() + begin_;
+        const char* last = buffer_.data() + fieldEnd;
+        if (!parseNumber(first, last, out[count])) {
+            out[count] = NAN;
+            errors_.record(count_, "Invalid number '" + std::string(first, last) + "'");
+        }
+        ++count;
+        ++count_;
+        begin_ = fieldEnd;
+    }
+    return count;
+}
+
+NumberWriter::NumberWriter(std::ostream& out, size_t bufferBytes)
+    : out_(out), buffer_(bufferBytes < MAX_NUMBER_TEXT ? MAX_NUMBER_TEXT : bufferBytes) {}
+
+// Formats straight into the buffer, flushing when one more number might
+// not fit.
+void NumberWriter::write(const double* values, size_t count) {
+    char* data = buffer_.data();
+    const size_t limit = buffer_.size() - MAX_NUMBER_TEXT;
+    for (size_t i = 0; i < count; ++i) {
+        if (size_ > limit) flush();
+        char* end = std::to_chars(data + size_, data + buffer_.size(), values[i]).ptr;
+        *end = '\n';
+        size_ = static_cast<size_t>(end - data) + 1;
+    }
+}
+
+// Hands the buffered text to the stream.
+void NumberWriter::flush() {
+    out_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+    size_ = 0;
+}
+
+// Binds the input to one column and every other variable to a constant
+// column, then evaluates block by block.
+StreamErrors mapBlocks(const PostfixProgram& program, const Environment& environment, uint32_t inputSlot,
+                       NumberReader& reader, const std::function<void(const double*, size_t)>& consume) {
+    std::vector<double> inputs(MAP_BLOCK_NUMBERS), results(MAP_BLOCK_NUMBERS);
+    std::vector<std::vector<double>> constantColumns(program.variableCount);
+    std::vector<const double*> columns(program.variableCount);
+    for (uint32_t slot = 0; slot < program.variableCount; ++slot) {
+        if (slot == inputSlot) {
+            columns[slot] = inputs.data();
+        } else {
+            constantColumns[slot].assign(MAP_BLOCK_NUMBERS, environment[slot]);
+            columns[slot] = constantColumns[slot].data();
+        }
+    }
+    std::vector<double> row(environment.values(), environment.values() + environment.size());
+
+    StreamErrors errors;
+    uint64_t index = 0;
+    while (size_t count = traced("read", [&] { return reader.read(inputs.data(), MAP_BLOCK_NUMBERS); })) {
+        traced("evaluate", [&] {
+            try {
+                evaluateColumns(program, columns.data(), count, results.data());
+            } catch (const std::runtime_error&) {
+                for (size_t i = 0; i < count; ++i) {
+                    row[inputSlot] = inputs[i];
+                    try {
+                        results[i] = evaluate(program, row.data());
+                    } catch (const std::runtime_error& e) {
+                        results[i] = NAN;
+                        errors.record(index + i, e.what());
+                    }
+                }
+            }
+        });
+        traced("output", [&] { consume(results.data(), count); });
+        index += count;
+    }
+    return errors;
+}
+
+// Writes each block as soon as it is evaluated.
+StreamErrors mapNumbers(const PostfixProgram& program, const Environment& environment, uint32_t inputSlot,
+                        NumberReader& reader, NumberWriter& writer) {
+    return mapBlocks(program, environment, inputSlot, reader,
+                     [&](const double* results, size_t count) { writer.write(results, count); });
+}
@@ -0,0 +1,191 @@
+#include "perf_counters.h"
+#include <cerrno>
+#include <cstring>
+#include <ostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t EVENT_COUNT = static_cast<size_t>(PerfEvent::COUNT);
+
+#ifdef __linux__
+
+// Sets the perf_event_attr type and config for an event.
+void eventConfig(PerfEvent event, __u32& type, __u64& config) {
+    const __u64 cacheReadMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    switch (event) {
+        case PerfEvent::CYCLES:
+            type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case PerfEvent::INSTRUCTIONS:
+            type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case PerfEvent::BRANCHES:
+            type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS; break;
+        case PerfEvent::BRANCH_MISSES:
+            type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        case PerfEvent::L1D_MISSES:
+            type = PERF_TYPE_HW_CACHE; config = PERF_COUNT_HW_CACHE_L1D | cacheReadMiss; break;
+        case PerfEvent::LLC_MISSES:
+        default:
+            type = PERF_TYPE_HARDWARE; config = PERF_COUNT_HW_CACHE_MISSES; break;
+    }
+}
+
+int openEvent(PerfEvent event, int groupFd) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    eventConfig(event, attr.type, attr.config);
+    attr.disabled = groupFd < 0 ? 1 : 0;  // The leader starts the whole group.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+#endif  // __linux__
+
+}  // namespace
+
+// Converts a PerfEvent to its display name.
+const char* perfEventName(PerfEvent event) {
+    switch (event) {
+        case PerfEvent::CYCLES:        return "cycles";
+        case PerfEvent::INSTRUCTIONS:  return "instructions";
+        case PerfEvent::BRANCHES:      return "branches";
+        case PerfEvent::BRANCH_MISSES: return "branch-misses";
+        case PerfEvent::L1D_MISSES:    return "L1d-misses";
+        case PerfEvent::LLC_MISSES:    return "LLC-misses";
+        default:                       return "unknown";
+    }
+}
+
+// Scales by enabled over running time; the group shares one schedule, so
+// ratios between events need no scaling.
+uint64_t PerfSample::estimate(PerfEvent event) const {
+    if (!counted()) return 0;
+    const double value = double((*this)[event]);
+    return multiplexed() ? static_cast<uint64_t>(value * double(timeEnabled) / double(timeRunning) + 0.5)
+                         : (*this)[event];
+}
+
+// Instructions per cycle.
+double PerfSample::ipc() const {
+    if (!has(PerfEvent::CYCLES) || !has(PerfEvent::INSTRUCTIONS) || (*this)[PerfEvent::CYCLES] == 0) return 0;
+    return double((*this)[PerfEvent::INSTRUCTIONS]) / (*this)[PerfEvent::CYCLES];
+}
+
+// Branch misses per branch.
+double PerfSample::branchMissRate() const {
+    if (!has(PerfEvent::BRANCHES) || !has(PerfEvent::BRANCH_MISSES) || (*this)[PerfEvent::BRANCHES] == 0) return 0;
+    return double((*this)[PerfEvent::BRANCH_MISSES]) / (*this)[PerfEvent::BRANCHES];
+}
+
+// Accumulates another sample.
+PerfSample& PerfSample::operator+=(const PerfSample& other) {
+    for (size_t i = 0; i < EVENT_COUNT; ++i) {
+        values[i] += other.values[i];
+        present[i] = present[i] || other.present[i];
+    }
+    timeEnabled += other.timeEnabled;
+    timeRunning += other.timeRunning;
+    return *this;
+}
+
+// Computes the counts between two snapshots.
+PerfSample operator-(const PerfSample& end, const PerfSample& start) {
+    PerfSample delta;
+    for (size_t i = 0; i < EVENT_COUNT; ++i) {
+        delta.present[i] = end.present[i] && start.present[i];
+        delta.values[i] = delta.present[i] ? end.values[i] - start.values[i] : 0;
+    }
+    delta.timeEnabled = end.timeEnabled - start.timeEnabled;
+    delta.timeRunning = end.timeRunning - start.timeRunning;
+    return delta;
+}
+
+// Writes counts for the present events plus derived rates.
+std::ostream& operator<<(std::ostream& os, const PerfSample& sample) {
+    bool any = false;
+    for (size_t i = 0; i < EVENT_COUNT; ++i) any = any || sample.present[i];
+    if (!any) return os << "no counters";
+    if (!sample.counted()) return os << "not counted (the counters were never scheduled)";
+
+    bool first = true;
+    for (size_t i = 0; i < EVENT_COUNT; ++i) {
+        if (!sample.present[i]) continue;
+        os << (first ? "" : " ") << perfEventName(static_cast<PerfEvent>(i)) << '='
+           << sample.estimate(static_cast<PerfEvent>(i));
+        first = false;
+    }
+    if (sample.has(PerfEvent::CYCLES) && sample.has(PerfEvent::INSTRUCTIONS)) {
+        os << " IPC=" << sample.ipc();
+    }
+    if (sample.has(PerfEvent::BRANCHES) && sample.has(PerfEvent::BRANCH_MISSES)) {
+        os << " branch-miss-rate=" << sample.branchMissRate() * 100 << '%';
+    }
+    if (sample.multiplexed()) {
+        os << " (scaled; counted " << 100.0 * double(sample.timeRunning) / double(sample.timeEnabled)
+           << "% of the time)";
+    }
+    return os;
+}
+
+// Opens the counter group and starts counting.
+PerfCounters::PerfCounters() {
+    fds_.fill(-1);
+#ifdef __linux__
+    leaderFd_ = openEvent(PerfEvent::CYCLES, -1);
+    if (leaderFd_ < 0) {
+        unavailableReason_ = std::string("perf_event_open failed: ") + std::strerror(errno);
+        return;
+    }
+    fds_[0] = leaderFd_;
+    for (size_t i = 1; i < EVENT_COUNT; ++i) {
+        fds_[i] = openEvent(static_cast<PerfEvent>(i), leaderFd_);  // -1 if unsupported.
+    }
+    ioctl(leaderFd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leaderFd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    unavailableReason_ = "hardware counters need perf_event_open (Linux only)";
+#endif
+}
+
+// Closes every counter in the group.
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds_) {
+        if (fd >= 0) close(fd);
+    }
+#endif
+}
+
+// Reads all counters in the group at once.
+PerfSample PerfCounters::read() const {
+    PerfSample sample;
+#ifdef __linux__
+    if (leaderFd_ < 0) return sample;
+
+    // Group read layout: the number of counters, the enabled and running
+    // times, then each value in the order the events were added to the
+    // group.
+    uint64_t buffer[3 + EVENT_COUNT] = {};
+    if (::read(leaderFd_, buffer, sizeof(buffer)) <= 0) return sample;
+    sample.timeEnabled = buffer[1];
+    sample.timeRunning = buffer[2];
+
+    size_t next = 3;
+    for (size_t i = 0; i < EVENT_COUNT && next < 3 + buffer[0]; ++i) {
+        if (fds_[i] < 0) continue;
+        sample.values[i] = buffer[next++];
+        sample.present[i] = true;
+    }
+#endif
+    return sample;
+}
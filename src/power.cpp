@@ -0,0 +1,26 @@
+#include "power.h"
+
+namespace {
+
+constexpr std::array<AdditionChain, MAX_INTEGER_EXPONENT + 1> buildAdditionChains() {
+    std::array<AdditionChain, MAX_INTEGER_EXPONENT + 1> chains{};
+    for (int n = 1; n <= MAX_INTEGER_EXPONENT; ++n) chains[n] = shortestAdditionChain(n);
+    return chains;
+}
+
+}  // namespace
+
+// A constant expression, so the table is filled in by the compiler.
+const std::array<AdditionChain, MAX_INTEGER_EXPONENT + 1> ADDITION_CHAINS = buildAdditionChains();
+
+bool strictPowerEnabled = false;
+
+// Sets the flag integerExponent reads.
+void setStrictPower(bool strict) {
+    strictPowerEnabled = strict;
+}
+
+// The flag set by setStrictPower.
+bool strictPower() {
+    return strictPowerEnabled;
+}
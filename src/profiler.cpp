@@ -0,0 +1,63 @@
+#include "profiler.h"
+#include <iomanip>
+#include <ostream>
+
+// Converts a Phase to its display name.
+const char* phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::CLI_PARSE: return "cli-parse";
+        case Phase::TOKENIZE:  return "tokenize";
+        case Phase::CALCULATE: return "calculate";
+        case Phase::OUTPUT:    return "output";
+        default:               return "unknown";
+    }
+}
+
+// Adds one measurement to the aggregate and histogram.
+void PhaseStats::record(uint64_t nanoseconds, AllocationStats allocated) {
+    ++samples;
+    totalNanoseconds += nanoseconds;
+    if (nanoseconds < minNanoseconds) minNanoseconds = nanoseconds;
+    if (nanoseconds > maxNanoseconds) maxNanoseconds = nanoseconds;
+    allocations.count += allocated.count;
+    allocations.bytes += allocated.bytes;
+    histogram.record(nanoseconds);
+}
+
+// Records a phase measurement.
+void PhaseProfiler::record(Phase phase, uint64_t start, uint64_t end, AllocationStats allocated) {
+    if (!enabled_) return;
+    phases_[static_cast<size_t>(phase)].record(end - start, allocated);
+}
+
+// Writes the per-phase table and, optionally, the histograms.
+void PhaseProfiler::report(std::ostream& os, bool histograms) const {
+    if (!enabled_) return;
+
+    os << "profile: phase        samples     total_ns   mean_ns    min_ns    max_ns    allocs        bytes\n";
+    for (size_t i = 0; i < phases_.size(); ++i) {
+        const PhaseStats& stats = phases_[i];
+        if (stats.samples == 0) continue;
+        os << "profile: " << std::left << std::setw(10) << phaseName(static_cast<Phase>(i)) << std::right
+           << std::setw(10) << stats.samples
+           << std::setw(13) << stats.totalNanoseconds
+           << std::setw(10) << stats.totalNanoseconds / stats.samples
+           << std::setw(10) << stats.minNanoseconds
+           << std::setw(10) << stats.maxNanoseconds;
+        if (allocationCountingEnabled()) {
+            os << std::setw(10) << stats.allocations.count << std::setw(13) << stats.allocations.bytes << '\n';
+        } else {
+            os << std::setw(10) << '-' << std::setw(13) << '-' << '\n';
+        }
+    }
+
+    if (!histograms) return;
+
+    for (size_t i = 0; i < phases_.size(); ++i) {
+        const PhaseStats& stats = phases_[i];
+        if (stats.samples == 0) continue;
+        os << "profile: " << std::left << std::setw(10) << phaseName(static_cast<Phase>(i)) << std::right;
+        stats.histogram.printPercentiles(os);
+        os << '\n';
+    }
+}
@@ -0,0 +1,615 @@
+#include "program.h"
+#include "functions.h"
+#include "operator_kernels.h"
+#include "power.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+// Threaded dispatch: with the GNU "labels as values" extension each handler
+// ends in its own indirect jump through a table of label addresses, so every
+// instruction costs a single, separately predicted indirect branch. Other
+// compilers fall back to a switch in a loop. The handlers are written once:
+// VM_TARGET is both a case label and (when threaded) a jump target.
+#if defined(__GNUC__)
+#define PROGRAM_THREADED_DISPATCH 1
+#define VM_TARGET(Enum, name) case Enum::name: target_##name:
+#define VM_DISPATCH(ip) goto *TARGETS[static_cast<uint8_t>((ip)->op)]
+#else
+#define VM_TARGET(Enum, name) case Enum::name:
+#define VM_DISPATCH(ip) continue
+#endif
+
+namespace {
+
+const size_t INLINE_SLOTS = 64;
+
+// Maps a tree operator to its postfix instruction.
+StackOp stackOpFor(OpCode op) {
+    switch (op) {
+        case OpCode::ADD:      return StackOp::ADD;
+        case OpCode::SUBTRACT: return StackOp::SUBTRACT;
+        case OpCode::MULTIPLY: return StackOp::MULTIPLY;
+        case OpCode::DIVIDE:   return StackOp::DIVIDE;
+        case OpCode::POWER:    return StackOp::POWER;
+        default:
+            throw std::runtime_error(std::string("Syntax Error: Unknown operator ") + opCodeToChar(op));
+    }
+}
+
+// Maps a postfix operator or call to its register instruction.
+RegisterOp registerOpFor(StackOp op) {
+    switch (op) {
+        case StackOp::ADD:      return RegisterOp::ADD;
+        case StackOp::SUBTRACT: return RegisterOp::SUBTRACT;
+        case StackOp::MULTIPLY: return RegisterOp::MULTIPLY;
+        case StackOp::DIVIDE:   return RegisterOp::DIVIDE;
+        case StackOp::POWER:    return RegisterOp::POWER;
+        case StackOp::CALL_UNARY:  return RegisterOp::CALL_UNARY;
+        case StackOp::CALL_BINARY: return RegisterOp::CALL_BINARY;
+        default:
+            throw std::runtime_error("Evaluation Error: Invalid instruction in program.");
+    }
+}
+
+[[noreturn]] void throwDivisionByZero() {
+    throw std::runtime_error("Math Error: Division by zero");
+}
+
+// Rejects running a program that reads variables without their values.
+void checkVariables(size_t variableCount, const double* variables) {
+    if (variableCount > 0 && variables == nullptr) {
+        throw std::runtime_error("Evaluation Error: No values given for the expression's variables");
+    }
+}
+
+// Instruction pairs that have a fusion rule in `fusePair`.
+const std::pair<StackOp, StackOp> FUSION_RULES[] = {
+    {StackOp::PUSH, StackOp::ADD},
+    {StackOp::PUSH, StackOp::SUBTRACT},
+    {StackOp::PUSH, StackOp::MULTIPLY},
+    {StackOp::PUSH, StackOp::DIVIDE},
+    {StackOp::PUSH, StackOp::POWER},
+    {StackOp::MULTIPLY, StackOp::ADD},
+    {StackOp::MULTIPLY, StackOp::ADD_CONST},
+};
+
+bool hasFusionRule(StackOp first, StackOp second) {
+    for (const auto& rule : FUSION_RULES) {
+        if (rule.first == first && rule.second == second) return true;
+    }
+    return false;
+}
+
+// Replaces `first` followed by `second` with one superinstruction if a rule
+// applies. Returns false (leaving `fused` untouched) otherwise.
+bool fusePair(const StackInstruction& first, const StackInstruction& second,
+              const std::vector<double>& constants, StackInstruction& fused) {
+    if (first.op == StackOp::PUSH) {
+        double constant = constants[first.operand];
+        switch (second.op) {
+            case StackOp::ADD:      fused = {StackOp::ADD_CONST, first.operand}; return true;
+            case StackOp::SUBTRACT: fused = {StackOp::SUBTRACT_CONST, first.operand}; return true;
+            case StackOp::MULTIPLY: fused = {StackOp::MULTIPLY_CONST, first.operand}; return true;
+            case StackOp::DIVIDE:
+                if (constant == 0) return false;  // Must still throw at run time.
+                fused = {StackOp::DIVIDE_CONST, first.operand};
+                return true;
+            case StackOp::POWER: {
+                int exponent;
+                if (!integerExponent(constant, exponent)) {
+                    fused = {StackOp::POWER_CONST, first.operand};
+                } else if (exponent == 2) {
+                    fused = {StackOp::SQUARE, 0};
+                } else if (exponent == 3) {
+                    fused = {StackOp::CUBE, 0};
+                } else {
+                    fused = {StackOp::POWER_CHAIN, first.operand};
+                }
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+    if (first.op == StackOp::MULTIPLY && second.op == StackOp::ADD) {
+        fused = {StackOp::MULTIPLY_ADD, 0};
+        return true;
+    }
+    if (first.op == StackOp::MULTIPLY && second.op == StackOp::ADD_CONST) {
+        fused = {StackOp::MULTIPLY_ADD_CONST, second.operand};
+        return true;
+    }
+    return false;
+}
+
+// A value of the expression DAG: either a preloaded slot (a variable or a
+// constant) or the result of one instruction.
+struct DagValue {
+    bool constant;      // Preloaded, never freed.
+    uint32_t slot;      // Preloaded slot, or register once allocated.
+    RegisterOp op;      // Operation (computed values only).
+    uint8_t function;   // FunctionId (calls only).
+    uint32_t left;      // Operand value ids (computed values only);
+    uint32_t right;     // `right` repeats `left` for one-argument calls.
+    size_t lastUse;     // Index of the last instruction reading the value.
+};
+
+}  // namespace
+
+// Returns the mnemonic of an instruction.
+const char* stackOpName(StackOp op) {
+    switch (op) {
+        case StackOp::PUSH:               return "PUSH";
+        case StackOp::LOAD:               return "LOAD";
+        case StackOp::ADD:                return "ADD";
+        case StackOp::SUBTRACT:           return "SUBTRACT";
+        case StackOp::MULTIPLY:           return "MULTIPLY";
+        case StackOp::DIVIDE:             return "DIVIDE";
+        case StackOp::POWER:              return "POWER";
+        case StackOp::CALL_UNARY:         return "CALL_UNARY";
+        case StackOp::CALL_BINARY:        return "CALL_BINARY";
+        case StackOp::HALT:               return "HALT";
+        case StackOp::ADD_CONST:          return "ADD_CONST";
+        case StackOp::SUBTRACT_CONST:     return "SUBTRACT_CONST";
+        case StackOp::MULTIPLY_CONST:     return "MULTIPLY_CONST";
+        case StackOp::DIVIDE_CONST:       return "DIVIDE_CONST";
+        case StackOp::POWER_CONST:        return "POWER_CONST";
+        case StackOp::SQUARE:             return "SQUARE";
+        case StackOp::CUBE:               return "CUBE";
+        case StackOp::POWER_CHAIN:        return "POWER_CHAIN";
+        case StackOp::MULTIPLY_ADD:       return "MULTIPLY_ADD";
+        case StackOp::MULTIPLY_ADD_CONST: return "MULTIPLY_ADD_CONST";
+        default:                          return "?";
+    }
+}
+
+// Emits one instruction per post-order node.
+PostfixProgram compilePostfix(const ExprTree& tree) {
+    PostfixProgram program;
+    program.code.reserve(tree.nodeCount + 1);
+    for (size_t i = 0; i < tree.nodeCount; ++i) {
+        const ExprNode& node = tree.nodes[i];
+        if (node.kind == NodeKind::NUMBER) {
+            program.code.push_back({StackOp::PUSH, static_cast<uint32_t>(program.constants.size())});
+            program.constants.push_back(node.value);
+        } else if (node.kind == NodeKind::VARIABLE) {
+            program.code.push_back({StackOp::LOAD, node.slot});
+        } else if (node.kind == NodeKind::CALL) {
+            StackOp op = functionInfo(node.slot).arity == 1 ? StackOp::CALL_UNARY : StackOp::CALL_BINARY;
+            program.code.push_back({op, node.slot});
+        } else {
+            program.code.push_back({stackOpFor(node.op), 0});
+        }
+    }
+    program.code.push_back({StackOp::HALT, 0});
+    program.maxDepth = tree.maxDepth;
+    program.variableCount = tree.variableCount;
+    return program;
+}
+
+// Parses the tokens into a temporary arena and compiles the tree.
+PostfixProgram compilePostfix(const std::vector<Token>& tokens, const SymbolTable* symbols) {
+    Arena arena;
+    return compilePostfix(parseExpressionTree(tokens, arena, symbols));
+}
+
+// Runs a postfix program with threaded dispatch over a stack that lives on
+// the C++ stack unless the program is unusually deep.
+double evaluate(const PostfixProgram& program, const double* variables) {
+    if (program.code.size() < 2) {
+        throw std::runtime_error("Evaluation Error: Empty expression");
+    }
+    checkVariables(program.variableCount, variables);
+
+    double inlineStack[INLINE_SLOTS] = {};
+    std::vector<double> deepStack;
+    double* stack = inlineStack;
+    if (program.maxDepth > INLINE_SLOTS) {
+        deepStack.resize(program.maxDepth);
+        stack = deepStack.data();
+    }
+
+#ifdef PROGRAM_THREADED_DISPATCH
+    static const void* const TARGETS[] = {  // In StackOp order.
+        &&target_PUSH, &&target_LOAD, &&target_ADD, &&target_SUBTRACT, &&target_MULTIPLY,
+        &&target_DIVIDE, &&target_POWER, &&target_CALL_UNARY, &&target_CALL_BINARY,
+        &&target_HALT, &&target_ADD_CONST,
+        &&target_SUBTRACT_CONST, &&target_MULTIPLY_CONST, &&target_DIVIDE_CONST,
+        &&target_POWER_CONST, &&target_SQUARE, &&target_CUBE, &&target_POWER_CHAIN,
+        &&target_MULTIPLY_ADD, &&target_MULTIPLY_ADD_CONST,
+    };
+    static_assert(sizeof(TARGETS) / sizeof(TARGETS[0]) == STACK_OP_COUNT, "one target per StackOp");
+#endif
+
+    const double* constants = program.constants.data();
+    const StackInstruction* ip = program.code.data();
+    double* top = stack;  // One past the topmost operand.
+
+#ifdef PROGRAM_THREADED_DISPATCH
+    VM_DISPATCH(ip);
+#endif
+    for (;;) {
+        switch (ip->op) {
+            VM_TARGET(StackOp, PUSH)
+                *top++ = constants[ip->operand];
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, LOAD)
+                *top++ = variables[ip->operand];
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, ADD)
+                --top;
+                top[-1] = OperatorKernel<OpCode::ADD>::apply(top[-1], top[0]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, SUBTRACT)
+                --top;
+                top[-1] = OperatorKernel<OpCode::SUBTRACT>::apply(top[-1], top[0]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, MULTIPLY)
+                --top;
+                top[-1] = OperatorKernel<OpCode::MULTIPLY>::apply(top[-1], top[0]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, DIVIDE)
+                --top;
+                if (top[0] == 0) throwDivisionByZero();
+                top[-1] = OperatorKernel<OpCode::DIVIDE>::apply(top[-1], top[0]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, POWER)
+                --top;
+                top[-1] = OperatorKernel<OpCode::POWER>::apply(top[-1], top[0]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, CALL_UNARY)
+                top[-1] = functionInfo(ip->operand).unary(top[-1]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, CALL_BINARY)
+                --top;
+                top[-1] = functionInfo(ip->operand).binary(top[-1], top[0]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, HALT)
+                return stack[0];
+            VM_TARGET(StackOp, ADD_CONST)
+                top[-1] = OperatorKernel<OpCode::ADD>::apply(top[-1], constants[ip->operand]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, SUBTRACT_CONST)
+                top[-1] = OperatorKernel<OpCode::SUBTRACT>::apply(top[-1], constants[ip->operand]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, MULTIPLY_CONST)
+                top[-1] = OperatorKernel<OpCode::MULTIPLY>::apply(top[-1], constants[ip->operand]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, DIVIDE_CONST)
+                top[-1] = OperatorKernel<OpCode::DIVIDE>::apply(top[-1], constants[ip->operand]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, POWER_CONST)
+                top[-1] = OperatorKernel<OpCode::POWER>::apply(top[-1], constants[ip->operand]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, SQUARE)
+                top[-1] = top[-1] * top[-1];
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, CUBE)
+                top[-1] = top[-1] * top[-1] * top[-1];
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, POWER_CHAIN)
+                top[-1] = chainPower(top[-1], static_cast<int>(constants[ip->operand]));
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, MULTIPLY_ADD)
+                top -= 2;
+                top[-1] = OperatorKernel<OpCode::ADD>::apply(
+                    top[-1], OperatorKernel<OpCode::MULTIPLY>::apply(top[0], top[1]));
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(StackOp, MULTIPLY_ADD_CONST)
+                --top;
+                top[-1] = OperatorKernel<OpCode::ADD>::apply(
+                    OperatorKernel<OpCode::MULTIPLY>::apply(top[-1], top[0]), constants[ip->operand]);
+                ++ip;
+                VM_DISPATCH(ip);
+            default:
+                throw std::runtime_error("Evaluation Error: Invalid instruction in program.");
+        }
+    }
+}
+
+// Counts each instruction together with the one after it.
+void OpcodePairCounts::record(const PostfixProgram& program) {
+    for (size_t i = 1; i < program.code.size(); ++i) {
+        ++counts[static_cast<size_t>(program.code[i - 1].op)][static_cast<size_t>(program.code[i].op)];
+        ++total;
+    }
+}
+
+// Prints the most frequent pairs, most frequent first.
+void OpcodePairCounts::print(std::ostream& os, size_t limit) const {
+    std::vector<std::pair<uint64_t, std::pair<size_t, size_t>>> pairs;
+    for (size_t first = 0; first < STACK_OP_COUNT; ++first) {
+        for (size_t second = 0; second < STACK_OP_COUNT; ++second) {
+            if (counts[first][second]) pairs.push_back({counts[first][second], {first, second}});
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    if (pairs.size() > limit) pairs.resize(limit);
+
+    for (const auto& pair : pairs) {
+        std::string name = std::string(stackOpName(static_cast<StackOp>(pair.second.first))) + "," +
+                           stackOpName(static_cast<StackOp>(pair.second.second));
+        os << std::left << std::setw(32) << name << std::right << std::setw(12) << pair.first
+           << std::fixed << std::setprecision(1) << std::setw(7) << 100.0 * pair.first / total << "%"
+           << std::defaultfloat << '\n';
+    }
+}
+
+// Enables every pair in FUSION_RULES.
+FusionPlan FusionPlan::all() {
+    FusionPlan plan;
+    for (const auto& rule : FUSION_RULES) {
+        plan.enabled[static_cast<size_t>(rule.first)][static_cast<size_t>(rule.second)] = true;
+    }
+    return plan;
+}
+
+// Prints the enabled pairs.
+void FusionPlan::print(std::ostream& os) const {
+    for (size_t first = 0; first < STACK_OP_COUNT; ++first) {
+        for (size_t second = 0; second < STACK_OP_COUNT; ++second) {
+            if (enabled[first][second]) {
+                os << stackOpName(static_cast<StackOp>(first)) << ','
+                   << stackOpName(static_cast<StackOp>(second)) << '\n';
+            }
+        }
+    }
+}
+
+// Greedy superinstruction selection over pair counts.
+FusionPlan planFusions(const std::vector<PostfixProgram>& workload, double minShare) {
+    FusionPlan plan;
+    for (;;) {
+        OpcodePairCounts pairs;
+        for (const PostfixProgram& program : workload) pairs.record(fuseInstructions(program, plan));
+
+        uint64_t bestCount = 0;
+        size_t bestFirst = 0, bestSecond = 0;
+        for (size_t first = 0; first < STACK_OP_COUNT; ++first) {
+            for (size_t second = 0; second < STACK_OP_COUNT; ++second) {
+                if (plan.enabled[first][second] || pairs.counts[first][second] <= bestCount) continue;
+                if (!hasFusionRule(static_cast<StackOp>(first), static_cast<StackOp>(second))) continue;
+                bestCount = pairs.counts[first][second];
+                bestFirst = first;
+                bestSecond = second;
+            }
+        }
+
+        if (bestCount == 0 || bestCount < minShare * pairs.total) return plan;
+        plan.enabled[bestFirst][bestSecond] = true;
+    }
+}
+
+// Appends instructions one by one, fusing each with the previous output
+// instruction while a rule applies; fused instructions can fuse again.
+PostfixProgram fuseInstructions(const PostfixProgram& program, const FusionPlan& plan) {
+    PostfixProgram fused;
+    fused.constants = program.constants;
+    fused.maxDepth = program.maxDepth;
+    fused.variableCount = program.variableCount;
+    fused.code.reserve(program.code.size());
+
+    for (const StackInstruction& instruction : program.code) {
+        StackInstruction next = instruction;
+        while (!fused.code.empty()) {
+            const StackInstruction& previous = fused.code.back();
+            StackInstruction combined;
+            if (!plan.enabled[static_cast<size_t>(previous.op)][static_cast<size_t>(next.op)] ||
+                !fusePair(previous, next, program.constants, combined)) {
+                break;
+            }
+            fused.code.pop_back();
+            next = combined;
+        }
+        fused.code.push_back(next);
+    }
+    return fused;
+}
+
+// Builds the DAG by simulating the postfix stack with value ids, then walks
+// its instructions in order, releasing each operand's register at its last
+// use before picking the destination, so an instruction may overwrite one
+// of its own operands.
+RegisterProgram compileRegisters(const PostfixProgram& program) {
+    RegisterProgram compiled;
+    std::vector<DagValue> values;
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> instructions;  // Value ids of computed values, in order.
+    std::map<uint64_t, uint32_t> constantIds;
+    std::map<uint32_t, uint32_t> variableIds;  // By variable slot.
+    const uint32_t firstConstant = static_cast<uint32_t>(program.variableCount);
+    compiled.variableCount = program.variableCount;
+    std::map<std::tuple<RegisterOp, uint32_t, uint32_t, uint32_t>, uint32_t> computedIds;
+
+    // Returns the value id of `op` applied to two values, adding an
+    // instruction unless the same one was added before.
+    auto compute = [&](RegisterOp op, uint32_t function, uint32_t left, uint32_t right) {
+        auto key = std::make_tuple(op, function, left, right);
+        auto found = computedIds.find(key);
+        if (found == computedIds.end()) {
+            size_t index = instructions.size();
+            values[left].lastUse = index;
+            values[right].lastUse = index;
+            found = computedIds.emplace(key, static_cast<uint32_t>(values.size())).first;
+            instructions.push_back(found->second);
+            values.push_back({false, 0, op, static_cast<uint8_t>(function), left, right, 0});
+        }
+        return found->second;
+    };
+
+    for (const StackInstruction& instruction : program.code) {
+        if (instruction.op == StackOp::HALT) break;
+        if (instruction.op == StackOp::PUSH) {
+            double constant = program.constants.at(instruction.operand);
+            uint64_t bits;
+            std::memcpy(&bits, &constant, sizeof(bits));
+            auto found = constantIds.find(bits);
+            if (found == constantIds.end()) {
+                uint32_t slot = firstConstant + static_cast<uint32_t>(compiled.constants.size());
+                compiled.constants.push_back(constant);
+                found = constantIds.emplace(bits, static_cast<uint32_t>(values.size())).first;
+                values.push_back({true, slot, RegisterOp::HALT, 0, 0, 0, 0});
+            }
+            stack.push_back(found->second);
+            continue;
+        }
+        if (instruction.op == StackOp::LOAD) {
+            auto found = variableIds.find(instruction.operand);
+            if (found == variableIds.end()) {
+                found = variableIds.emplace(instruction.operand, static_cast<uint32_t>(values.size())).first;
+                values.push_back({true, instruction.operand, RegisterOp::HALT, 0, 0, 0, 0});
+            }
+            stack.push_back(found->second);
+            continue;
+        }
+
+        RegisterOp op = registerOpFor(instruction.op);
+        size_t arity = op == RegisterOp::CALL_UNARY ? 1 : 2;
+        if (stack.size() < arity) {
+            throw std::runtime_error("Evaluation Error: Invalid instruction in program.");
+        }
+        uint32_t right = stack.back(); stack.pop_back();
+        uint32_t left = right;
+        if (arity == 2) {
+            left = stack.back(); stack.pop_back();
+        }
+        int exponent;
+        if (op == RegisterOp::POWER && values[right].constant && values[right].slot >= firstConstant &&
+            integerExponent(compiled.constants[values[right].slot - firstConstant], exponent) && exponent > 0) {
+            const AdditionChain& chain = additionChain(exponent);
+            uint32_t chainValues[MAX_CHAIN_LENGTH + 1] = {left};
+            for (size_t i = 0; i < chain.length; ++i) {
+                chainValues[i + 1] = compute(RegisterOp::MULTIPLY, 0, chainValues[i], chainValues[chain.factors[i]]);
+            }
+            stack.push_back(chainValues[chain.length]);
+            continue;
+        }
+        bool isCall = op == RegisterOp::CALL_UNARY || op == RegisterOp::CALL_BINARY;
+        stack.push_back(compute(op, isCall ? instruction.operand : 0, left, right));
+    }
+
+    if (stack.size() != 1) {
+        throw std::runtime_error("Evaluation Error: Empty expression");
+    }
+    uint32_t resultId = stack.back();
+    values[resultId].lastUse = instructions.size();  // Live until HALT.
+
+    const uint32_t firstTemporary = firstConstant + static_cast<uint32_t>(compiled.constants.size());
+    uint32_t temporaries = 0;
+    std::vector<uint32_t> freeRegisters;
+    compiled.code.reserve(instructions.size() + 1);
+
+    for (size_t index = 0; index < instructions.size(); ++index) {
+        DagValue& value = values[instructions[index]];
+        const DagValue& left = values[value.left];
+        const DagValue& right = values[value.right];
+
+        if (!left.constant && left.lastUse == index) freeRegisters.push_back(left.slot);
+        if (!right.constant && right.lastUse == index && value.right != value.left) {
+            freeRegisters.push_back(right.slot);
+        }
+
+        if (freeRegisters.empty()) {
+            value.slot = firstTemporary + temporaries++;
+        } else {
+            value.slot = freeRegisters.back();
+            freeRegisters.pop_back();
+        }
+        compiled.code.push_back({value.op, value.function, value.slot, left.slot, right.slot});
+    }
+
+    compiled.code.push_back({RegisterOp::HALT, 0, 0, 0, 0});
+    compiled.registerCount = firstTemporary + temporaries;
+    compiled.result = values[resultId].slot;
+    return compiled;
+}
+
+// Runs a register program with threaded dispatch. Variables and constants
+// are copied into the low slots of the register file first.
+double evaluate(const RegisterProgram& program, const double* variables) {
+    if (program.code.empty() || program.registerCount == 0) {
+        throw std::runtime_error("Evaluation Error: Empty expression");
+    }
+    checkVariables(program.variableCount, variables);
+
+    double inlineRegisters[INLINE_SLOTS];
+    std::vector<double> manyRegisters;
+    double* registers = inlineRegisters;
+    if (program.registerCount > INLINE_SLOTS) {
+        manyRegisters.resize(program.registerCount);
+        registers = manyRegisters.data();
+    }
+    if (program.variableCount > 0) std::copy(variables, variables + program.variableCount, registers);
+    std::copy(program.constants.begin(), program.constants.end(), registers + program.variableCount);
+
+#ifdef PROGRAM_THREADED_DISPATCH
+    static const void* const TARGETS[] = {  // In RegisterOp order.
+        &&target_ADD, &&target_SUBTRACT, &&target_MULTIPLY,
+        &&target_DIVIDE, &&target_POWER, &&target_CALL_UNARY, &&target_CALL_BINARY, &&target_HALT,
+    };
+#endif
+
+    const RegisterInstruction* ip = program.code.data();
+
+#ifdef PROGRAM_THREADED_DISPATCH
+    VM_DISPATCH(ip);
+#endif
+    for (;;) {
+        switch (ip->op) {
+            VM_TARGET(RegisterOp, ADD)
+                registers[ip->dest] = OperatorKernel<OpCode::ADD>::apply(registers[ip->left], registers[ip->right]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(RegisterOp, SUBTRACT)
+                registers[ip->dest] = OperatorKernel<OpCode::SUBTRACT>::apply(registers[ip->left], registers[ip->right]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(RegisterOp, MULTIPLY)
+                registers[ip->dest] = OperatorKernel<OpCode::MULTIPLY>::apply(registers[ip->left], registers[ip->right]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(RegisterOp, DIVIDE)
+                if (registers[ip->right] == 0) throwDivisionByZero();
+                registers[ip->dest] = OperatorKernel<OpCode::DIVIDE>::apply(registers[ip->left], registers[ip->right]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(RegisterOp, POWER)
+                registers[ip->dest] = OperatorKernel<OpCode::POWER>::apply(registers[ip->left], registers[ip->right]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(RegisterOp, CALL_UNARY)
+                registers[ip->dest] = functionInfo(ip->function).unary(registers[ip->left]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(RegisterOp, CALL_BINARY)
+                registers[ip->dest] = functionInfo(ip->function).binary(registers[ip->left], registers[ip->right]);
+                ++ip;
+                VM_DISPATCH(ip);
+            VM_TARGET(RegisterOp, HALT)
+                return registers[program.result];
+        }
+    }
+}
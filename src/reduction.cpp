@@ -0,0 +1,133 @@
+#include "reduction.h"
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// The smaller of two values, or NaN if either is NaN.
+inline double minimum(double a, double b) {
+    return b < a || b != b ? b : a;
+}
+
+// The larger of two values, or NaN if either is NaN.
+inline double maximum(double a, double b) {
+    return b > a || b != b ? b : a;
+}
+
+}  // namespace
+
+// Compares against the names in Aggregate order.
+bool findAggregate(std::string_view name, Aggregate& aggregate) {
+    const std::string_view NAMES[] = {"sum", "min", "max", "mean", "var"};
+    for (size_t i = 0; i < sizeof NAMES / sizeof NAMES[0]; ++i) {
+        if (name == NAMES[i]) {
+            aggregate = static_cast<Aggregate>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Summarizes the block in lanes and merges the summary.
+void RunningStats::add(const double* values, size_t count) {
+    if (count == 0) return;
+    double sums[REDUCTION_LANES] = {};
+    double mins[REDUCTION_LANES], maxs[REDUCTION_LANES];
+    for (size_t lane = 0; lane < REDUCTION_LANES; ++lane) {
+        mins[lane] = INFINITY;
+        maxs[lane] = -INFINITY;
+    }
+    const size_t lanesEnd = count - count % REDUCTION_LANES;
+    for (size_t i = 0; i < lanesEnd; i += REDUCTION_LANES) {
+        for (size_t lane = 0; lane < REDUCTION_LANES; ++lane) {
+            sums[lane] += values[i + lane];
+            mins[lane] = minimum(mins[lane], values[i + lane]);
+            maxs[lane] = maximum(maxs[lane], values[i + lane]);
+        }
+    }
+    for (size_t i = lanesEnd; i < count; ++i) {
+        sums[0] += values[i];
+        mins[0] = minimum(mins[0], values[i]);
+        maxs[0] = maximum(maxs[0], values[i]);
+    }
+
+    RunningStats block;
+    block.count = count;
+    for (size_t lane = 0; lane < REDUCTION_LANES; ++lane) {
+        block.sum += sums[lane];
+        block.min = minimum(block.min, mins[lane]);
+        block.max = maximum(block.max, maxs[lane]);
+    }
+    block.mean = block.sum / static_cast<double>(count);
+
+    double squares[REDUCTION_LANES] = {};
+    for (size_t i = 0; i < lanesEnd; i += REDUCTION_LANES) {
+        for (size_t lane = 0; lane < REDUCTION_LANES; ++lane) {
+            const double deviation = values[i + lane] - block.mean;
+            squares[lane] += deviation * deviation;
+        }
+    }
+    for (size_t i = lanesEnd; i < count; ++i) {
+        const double deviation = values[i] - block.mean;
+        squares[0] += deviation * deviation;
+    }
+    for (size_t lane = 0; lane < REDUCTION_LANES; ++lane) block.m2 += squares[lane];
+
+    merge(block);
+}
+
+// Chan et al.: the combined mean moves toward the other mean in proportion
+// to its share of the count, and the squared deviations gain the spread
+// between the two means.
+void RunningStats::merge(const RunningStats& other) {
+    if (other.count == 0) return;
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    const double n = static_cast<double>(count);
+    const double otherN = static_cast<double>(other.count);
+    const double total = n + otherN;
+    const double delta = other.mean - mean;
+    mean += delta * (otherN / total);
+    m2 += other.m2 + delta * delta * (n * otherN / total);
+    count += other.count;
+    sum += other.sum;
+    min = minimum(min, other.min);
+    max = maximum(max, other.max);
+}
+
+// Reads the aggregate from the summary.
+double RunningStats::value(Aggregate aggregate) const {
+    if (aggregate == Aggregate::SUM) return sum;
+    if (count == 0) return NAN;
+    switch (aggregate) {
+        case Aggregate::MIN:  return min;
+        case Aggregate::MAX:  return max;
+        case Aggregate::MEAN: return mean;
+        case Aggregate::VAR:  return m2 / static_cast<double>(count);
+        default:              return sum;
+    }
+}
+
+Fold::Fold(const PostfixProgram& program, const Environment& environment, double initial)
+    : program_(fuseInstructions(program, FusionPlan::all())),
+      row_(environment.values(), environment.values() + environment.size()),
+      accSlot_(environment.slot("acc")),
+      xSlot_(environment.slot("x")) {
+    row_[accSlot_] = initial;
+}
+
+// Each step depends on the previous accumulator, so numbers are evaluated
+// one at a time.
+void Fold::add(const double* values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        row_[xSlot_] = values[i];
+        try {
+            row_[accSlot_] = evaluate(program_, row_.data());
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error("At number " + std::to_string(count_ + i + 1) + ": " + e.what());
+        }
+    }
+    count_ += count;
+}
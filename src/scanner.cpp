@@ -0,0 +1,326 @@
+#include "scanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCANNER_HAS_X86_SIMD 1
+#endif
+
+namespace {
+
+// Class bits shared by the scalar and SIMD classifiers. Each byte is looked
+// up by its high and low nibble and the two results are ANDed, so every
+// character that shares a nibble with another class needs its own bit.
+const uint8_t CLASS_CONTROL_SPACE = 0x01;  // '\t' .. '\r'.
+const uint8_t CLASS_SPACE = 0x02;          // ' '.
+const uint8_t CLASS_DIGIT = 0x04;          // '0' .. '9'.
+const uint8_t CLASS_DOT = 0x08;            // '.'.
+const uint8_t CLASS_ARITH = 0x10;          // '*', '+', '-', '/'.
+const uint8_t CLASS_CARET = 0x20;          // '^'.
+const uint8_t CLASS_LEFT_PAREN = 0x40;     // '('.
+const uint8_t CLASS_RIGHT_PAREN = 0x80;    // ')'.
+
+const uint8_t CLASS_WHITESPACE = CLASS_CONTROL_SPACE | CLASS_SPACE;
+const uint8_t CLASS_NUMERIC = CLASS_DIGIT | CLASS_DOT;
+const uint8_t CLASS_OPERATOR = CLASS_ARITH | CLASS_CARET;
+
+// Classes indexed by the high nibble of a byte. Bytes >= 0x80 map to 0.
+alignas(16) const uint8_t HIGH_NIBBLE_CLASSES[16] = {
+    CLASS_CONTROL_SPACE,                                                     // 0x0_
+    0,                                                                       // 0x1_
+    CLASS_SPACE | CLASS_DOT | CLASS_ARITH | CLASS_LEFT_PAREN | CLASS_RIGHT_PAREN,  // 0x2_
+    CLASS_DIGIT,                                                             // 0x3_
+    0,                                                                       // 0x4_
+    CLASS_CARET,                                                             // 0x5_
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+// Classes indexed by the low nibble of a byte.
+alignas(16) const uint8_t LOW_NIBBLE_CLASSES[16] = {
+    CLASS_SPACE | CLASS_DIGIT,                            // ' ', '0'
+    CLASS_DIGIT, CLASS_DIGIT, CLASS_DIGIT, CLASS_DIGIT,   // '1' .. '4'
+    CLASS_DIGIT, CLASS_DIGIT, CLASS_DIGIT,                // '5' .. '7'
+    CLASS_DIGIT | CLASS_LEFT_PAREN,                       // '8', '('
+    CLASS_DIGIT | CLASS_CONTROL_SPACE | CLASS_RIGHT_PAREN,  // '9', '\t', ')'
+    CLASS_CONTROL_SPACE | CLASS_ARITH,                    // '\n', '*'
+    CLASS_CONTROL_SPACE | CLASS_ARITH,                    // '\v', '+'
+    CLASS_CONTROL_SPACE,                                  // '\f'
+    CLASS_CONTROL_SPACE | CLASS_ARITH,                    // '\r', '-'
+    CLASS_DOT | CLASS_CARET,                              // '.', '^'
+    CLASS_ARITH,                                          // '/'
+};
+
+// Builds the block masks from per-class movemask results. `valid` has one
+// bit set for each byte that is part of the input.
+CharClassMasks buildMasks(uint64_t whitespace, uint64_t numeric, uint64_t digit, uint64_t letter,
+                          uint64_t op, uint64_t leftParen, uint64_t rightParen, uint64_t comma, uint64_t valid) {
+    CharClassMasks masks;
+    masks.numeric = numeric & valid;
+    masks.digit = digit & valid;
+    masks.letter = letter & valid;
+    masks.op = op & valid;
+    masks.leftParen = leftParen & valid;
+    masks.rightParen = rightParen & valid;
+    masks.comma = comma & valid;
+    masks.whitespace = whitespace | ~valid;
+    masks.invalid = ~(masks.whitespace | masks.numeric | masks.letter | masks.op |
+                      masks.leftParen | masks.rightParen | masks.comma);
+    return masks;
+}
+
+uint64_t validMask(size_t length) {
+    return length >= SCAN_BLOCK_SIZE ? ~uint64_t{0} : (uint64_t{1} << length) - 1;
+}
+
+// Letters and ',' are not in the nibble tables (every class bit is taken),
+// so they are found with direct comparisons. For letters, a range check:
+// setting bit 5 folds upper case onto lower.
+bool isLetterByte(uint8_t byte) {
+    return static_cast<uint8_t>((byte | 0x20) - 'a') < 26 || byte == '_';
+}
+
+CharClassMasks classifyBlockScalar(const char* data, size_t length) {
+    uint64_t whitespace = 0, numeric = 0, digit = 0, letter = 0, op = 0, leftParen = 0, rightParen = 0, comma = 0;
+
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t byte = static_cast<uint8_t>(data[i]);
+        uint8_t cls = HIGH_NIBBLE_CLASSES[byte >> 4] & LOW_NIBBLE_CLASSES[byte & 0x0F];
+        uint64_t bit = uint64_t{1} << i;
+        if (cls & CLASS_WHITESPACE) whitespace |= bit;
+        if (cls & CLASS_NUMERIC) numeric |= bit;
+        if (cls & CLASS_DIGIT) digit |= bit;
+        if (isLetterByte(byte)) letter |= bit;
+        if (cls & CLASS_OPERATOR) op |= bit;
+        if (cls & CLASS_LEFT_PAREN) leftParen |= bit;
+        if (cls & CLASS_RIGHT_PAREN) rightParen |= bit;
+        if (byte == ',') comma |= bit;
+    }
+
+    return buildMasks(whitespace, numeric, digit, letter, op, leftParen, rightParen, comma, validMask(length));
+}
+
+CsvMasks classifyCsvBlockScalar(const char* data, size_t length, char delimiter) {
+    CsvMasks masks = {0, 0, 0};
+    for (size_t i = 0; i < length; ++i) {
+        uint64_t bit = uint64_t{1} << i;
+        if (data[i] == delimiter) masks.delimiter |= bit;
+        if (data[i] == '\n') masks.newline |= bit;
+        if (data[i] == '"') masks.quote |= bit;
+    }
+    return masks;
+}
+
+#ifdef SCANNER_HAS_X86_SIMD
+
+// Copies a short tail into a zero-padded buffer so the SIMD loads never read
+// past the end of the input. Zero bytes classify as invalid and are masked
+// off by `validMask`.
+const char* padBlock(const char* data, size_t length, char (&buffer)[SCAN_BLOCK_SIZE]) {
+    if (length >= SCAN_BLOCK_SIZE) return data;
+    for (size_t i = 0; i < SCAN_BLOCK_SIZE; ++i) {
+        buffer[i] = i < length ? data[i] : 0;
+    }
+    return buffer;
+}
+
+__attribute__((target("sse4.2")))
+uint64_t classMask16(__m128i cls, uint8_t bits) {
+    __m128i selected = _mm_and_si128(cls, _mm_set1_epi8(static_cast<char>(bits)));
+    __m128i none = _mm_cmpeq_epi8(selected, _mm_setzero_si128());
+    return static_cast<uint16_t>(~_mm_movemask_epi8(none));
+}
+
+// Letter mask of 16 bytes, by the same range check as `isLetterByte`.
+__attribute__((target("sse4.2")))
+uint64_t letterMask16(__m128i bytes) {
+    __m128i offset = _mm_sub_epi8(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i alpha = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(25)), offset);
+    __m128i underscore = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_'));
+    return static_cast<uint16_t>(_mm_movemask_epi8(_mm_or_si128(alpha, underscore)));
+}
+
+__attribute__((target("sse4.2")))
+CharClassMasks classifyBlockSse42(const char* data, size_t length) {
+    char buffer[SCAN_BLOCK_SIZE];
+    const char* block = padBlock(data, length, buffer);
+    const __m128i highTable = _mm_load_si128(reinterpret_cast<const __m128i*>(HIGH_NIBBLE_CLASSES));
+    const __m128i lowTable = _mm_load_si128(reinterpret_cast<const __m128i*>(LOW_NIBBLE_CLASSES));
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+    uint64_t whitespace = 0, numeric = 0, digit = 0, letter = 0, op = 0, leftParen = 0, rightParen = 0, comma = 0;
+
+    for (int lane = 0; lane < 4; ++lane) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + lane * 16));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbleMask);
+        __m128i low = _mm_and_si128(bytes, nibbleMask);
+        __m128i cls = _mm_and_si128(_mm_shuffle_epi8(highTable, high), _mm_shuffle_epi8(lowTable, low));
+        int shift = lane * 16;
+        whitespace |= classMask16(cls, CLASS_WHITESPACE) << shift;
+        numeric |= classMask16(cls, CLASS_NUMERIC) << shift;
+        digit |= classMask16(cls, CLASS_DIGIT) << shift;
+        letter |= letterMask16(bytes) << shift;
+        op |= classMask16(cls, CLASS_OPERATOR) << shift;
+        leftParen |= classMask16(cls, CLASS_LEFT_PAREN) << shift;
+        rightParen |= classMask16(cls, CLASS_RIGHT_PAREN) << shift;
+        comma |= static_cast<uint64_t>(static_cast<uint16_t>(
+                     _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(','))))) << shift;
+    }
+
+    return buildMasks(whitespace, numeric, digit, letter, op, leftParen, rightParen, comma, validMask(length));
+}
+
+// Bytes of 16 equal to `byte`.
+__attribute__((target("sse4.2")))
+uint64_t byteMask16(__m128i bytes, char byte) {
+    return static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(byte))));
+}
+
+__attribute__((target("sse4.2")))
+CsvMasks classifyCsvBlockSse42(const char* data, size_t length, char delimiter) {
+    char buffer[SCAN_BLOCK_SIZE];
+    const char* block = padBlock(data, length, buffer);
+    CsvMasks masks = {0, 0, 0};
+    for (int lane = 0; lane < 4; ++lane) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + lane * 16));
+        int shift = lane * 16;
+        masks.delimiter |= byteMask16(bytes, delimiter) << shift;
+        masks.newline |= byteMask16(bytes, '\n') << shift;
+        masks.quote |= byteMask16(bytes, '"') << shift;
+    }
+    const uint64_t valid = validMask(length);
+    return {masks.delimiter & valid, masks.newline & valid, masks.quote & valid};
+}
+
+__attribute__((target("avx2")))
+uint64_t classMask32(__m256i cls, uint8_t bits) {
+    __m256i selected = _mm256_and_si256(cls, _mm256_set1_epi8(static_cast<char>(bits)));
+    __m256i none = _mm256_cmpeq_epi8(selected, _mm256_setzero_si256());
+    return static_cast<uint32_t>(~_mm256_movemask_epi8(none));
+}
+
+// Letter mask of 32 bytes, by the same range check as `isLetterByte`.
+__attribute__((target("avx2")))
+uint64_t letterMask32(__m256i bytes) {
+    __m256i offset = _mm256_sub_epi8(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(25)), offset);
+    __m256i underscore = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_'));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(alpha, underscore)));
+}
+
+__attribute__((target("avx2")))
+CharClassMasks classifyBlockAvx2(const char* data, size_t length) {
+    char buffer[SCAN_BLOCK_SIZE];
+    const char* block = padBlock(data, length, buffer);
+    const __m256i highTable = _mm256_broadcastsi128_si256(
+        _mm_load_si128(reinterpret_cast<const __m128i*>(HIGH_NIBBLE_CLASSES)));
+    const __m256i lowTable = _mm256_broadcastsi128_si256(
+        _mm_load_si128(reinterpret_cast<const __m128i*>(LOW_NIBBLE_CLASSES)));
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+    uint64_t whitespace = 0, numeric = 0, digit = 0, letter = 0, op = 0, leftParen = 0, rightParen = 0, comma = 0;
+
+    for (int lane = 0; lane < 2; ++lane) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + lane * 32));
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibbleMask);
+        __m256i low = _mm256_and_si256(bytes, nibbleMask);
+        __m256i cls = _mm256_and_si256(_mm256_shuffle_epi8(highTable, high),
+                                       _mm256_shuffle_epi8(lowTable, low));
+        int shift = lane * 32;
+        whitespace |= classMask32(cls, CLASS_WHITESPACE) << shift;
+        numeric |= classMask32(cls, CLASS_NUMERIC) << shift;
+        digit |= classMask32(cls, CLASS_DIGIT) << shift;
+        letter |= letterMask32(bytes) << shift;
+        op |= classMask32(cls, CLASS_OPERATOR) << shift;
+        leftParen |= classMask32(cls, CLASS_LEFT_PAREN) << shift;
+        rightParen |= classMask32(cls, CLASS_RIGHT_PAREN) << shift;
+        comma |= static_cast<uint64_t>(static_cast<uint32_t>(
+                     _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(','))))) << shift;
+    }
+
+    return buildMasks(whitespace, numeric, digit, letter, op, leftParen, rightParen, comma, validMask(length));
+}
+
+// Bytes of 32 equal to `byte`.
+__attribute__((target("avx2")))
+uint64_t byteMask32(__m256i bytes, char byte) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(byte))));
+}
+
+__attribute__((target("avx2")))
+CsvMasks classifyCsvBlockAvx2(const char* data, size_t length, char delimiter) {
+    char buffer[SCAN_BLOCK_SIZE];
+    const char* block = padBlock(data, length, buffer);
+    CsvMasks masks = {0, 0, 0};
+    for (int lane = 0; lane < 2; ++lane) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + lane * 32));
+        int shift = lane * 32;
+        masks.delimiter |= byteMask32(bytes, delimiter) << shift;
+        masks.newline |= byteMask32(bytes, '\n') << shift;
+        masks.quote |= byteMask32(bytes, '"') << shift;
+    }
+    const uint64_t valid = validMask(length);
+    return {masks.delimiter & valid, masks.newline & valid, masks.quote & valid};
+}
+
+#endif  // SCANNER_HAS_X86_SIMD
+
+using ClassifyFunction = CharClassMasks (*)(const char*, size_t);
+using ClassifyCsvFunction = CsvMasks (*)(const char*, size_t, char);
+
+CharClassMasks resolveAndClassify(const char* data, size_t length);
+CsvMasks resolveAndClassifyCsv(const char* data, size_t length, char delimiter);
+
+// Start out pointing at the resolvers so the first call picks an
+// implementation. Constant-initialized, so they are safe to use from other
+// translation units' static initializers.
+ClassifyFunction classifyImpl = resolveAndClassify;
+ClassifyCsvFunction classifyCsvImpl = resolveAndClassifyCsv;
+const char* classifierName = "scalar";
+
+// Points `classifyImpl` and `classifyCsvImpl` at the widest classifiers the
+// running CPU supports.
+void selectClassifier() {
+#ifdef SCANNER_HAS_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        classifyImpl = classifyBlockAvx2;
+        classifyCsvImpl = classifyCsvBlockAvx2;
+        classifierName = "avx2";
+        return;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        classifyImpl = classifyBlockSse42;
+        classifyCsvImpl = classifyCsvBlockSse42;
+        classifierName = "sse4.2";
+        return;
+    }
+#endif
+    classifyImpl = classifyBlockScalar;
+    classifyCsvImpl = classifyCsvBlockScalar;
+    classifierName = "scalar";
+}
+
+CharClassMasks resolveAndClassify(const char* data, size_t length) {
+    selectClassifier();
+    return classifyImpl(data, length);
+}
+
+CsvMasks resolveAndClassifyCsv(const char* data, size_t length, char delimiter) {
+    selectClassifier();
+    return classifyCsvImpl(data, length, delimiter);
+}
+
+}  // namespace
+
+// Classifies a block with the implementation selected for this CPU.
+CharClassMasks classifyBlock(const char* data, size_t length) {
+    return classifyImpl(data, length);
+}
+
+// Classifies delimited text with the implementation selected for this CPU.
+CsvMasks classifyCsvBlock(const char* data, size_t length, char delimiter) {
+    return classifyCsvImpl(data, length, delimiter);
+}
+
+// Returns the name of the classifier selected for this CPU.
+const char* scannerImplementationName() {
+    if (classifyImpl == resolveAndClassify) selectClassifier();
+    return classifierName;
+}
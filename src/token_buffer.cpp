@@ -0,0 +1,113 @@
+#include "token_buffer.h"
+#include "functions.h"
+#include "scanner.h"
+#include <charconv>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// Parses a run of digits and '.' the way the Token-based evaluator does:
+// a leading '.' reads as "0." and anything after a second '.' is ignored.
+double parseNumber(std::string_view text) {
+#if defined(__cpp_lib_to_chars)
+    double value = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec == std::errc()) {
+        return value;
+    }
+    if (result.ec == std::errc::invalid_argument) {
+        return 0;  // Only dots, e.g. "." which reads as "0.".
+    }
+#endif
+    // Out-of-range values (or no from_chars support): let strtod saturate.
+    std::string number_str(text);
+    return std::strtod(number_str.c_str(), nullptr);
+}
+
+// Appends the token boundaries reported by `scanExpression` to a TokenBuffer.
+struct BufferCollector {
+    std::string_view expression;
+    TokenBuffer& tokens;
+
+    void push(TokenType kind, OpCode op, size_t pos, uint32_t literalIndex) {
+        tokens.kinds.push_back(kind);
+        tokens.opCodes.push_back(op);
+        tokens.offsets.push_back(static_cast<uint32_t>(pos));
+        tokens.literalIndexes.push_back(literalIndex);
+    }
+
+    void number(size_t begin, size_t end) {
+        uint32_t literalIndex = static_cast<uint32_t>(tokens.literals.size());
+        tokens.literals.push_back(parseNumber(expression.substr(begin, end - begin)));
+        push(TokenType::NUMBER, OpCode::NONE, begin, literalIndex);
+    }
+
+    void identifier(size_t begin, size_t end) {
+        push(TokenType::IDENTIFIER, OpCode::NONE, begin, static_cast<uint32_t>(end - begin));
+    }
+
+    void op(size_t pos) {
+        push(TokenType::OPERATOR, opCodeFromChar(expression[pos]), pos, 0);
+    }
+
+    void leftParen(size_t pos) {
+        // A name followed by '(' is a function call, resolved here.
+        if (!tokens.kinds.empty() && tokens.kinds.back() == TokenType::IDENTIFIER) {
+            std::string_view name = expression.substr(tokens.offsets.back(), tokens.literalIndexes.back());
+            tokens.kinds.back() = TokenType::FUNCTION;
+            tokens.literalIndexes.back() = findFunction(name);
+            return;
+        }
+        push(TokenType::LEFT_PAREN, OpCode::NONE, pos, 0);
+    }
+
+    void rightParen(size_t pos) {
+        push(TokenType::RIGHT_PAREN, OpCode::NONE, pos, 0);
+    }
+
+    void comma(size_t pos) {
+        push(TokenType::COMMA, OpCode::NONE, pos, 0);
+    }
+
+    void invalid(size_t pos) {
+        push(TokenType::UNKNOWN, OpCode::NONE, pos, 0);
+    }
+};
+
+template <typename T>
+size_t vectorBytes(const std::pmr::vector<T>& values) {
+    return values.capacity() * sizeof(T);
+}
+
+}  // namespace
+
+// Removes all tokens but keeps the allocated capacity.
+void TokenBuffer::clear() {
+    kinds.clear();
+    opCodes.clear();
+    offsets.clear();
+    literalIndexes.clear();
+    literals.clear();
+}
+
+// Reserves room for the given number of tokens.
+void TokenBuffer::reserve(size_t tokens) {
+    kinds.reserve(tokens);
+    opCodes.reserve(tokens);
+    offsets.reserve(tokens);
+    literalIndexes.reserve(tokens);
+    literals.reserve(tokens);
+}
+
+// Returns the number of heap bytes currently reserved by the buffer.
+size_t TokenBuffer::capacityBytes() const {
+    return vectorBytes(kinds) + vectorBytes(opCodes) + vectorBytes(offsets) +
+           vectorBytes(literalIndexes) + vectorBytes(literals);
+}
+
+// Tokenizes an expression into the structure-of-arrays buffer.
+void tokenizer(std::string_view expression, TokenBuffer& tokens) {
+    tokens.clear();
+    scanExpression(expression, BufferCollector{expression, tokens});
+}
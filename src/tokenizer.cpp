@@ -1,5 +1,8 @@
 #include "tokenizer.h"
-#include <cctype> 
+#include "scanner.h"
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
 
 // Converts a TokenType enum to its string representation.
 std::string tokenTypeToString(TokenType type) {
@@ -8,6 +11,9 @@ std::string tokenTypeToString(TokenType type) {
         case TokenType::OPERATOR:     return "OPERATOR";
         case TokenType::LEFT_PAREN:   return "LEFT_PAREN";
         case TokenType::RIGHT_PAREN:  return "RIGHT_PAREN";
+        case TokenType::IDENTIFIER:   return "IDENTIFIER";
+        case TokenType::FUNCTION:     return "FUNCTION";
+        case TokenType::COMMA:        return "COMMA";
         case TokenType::UNKNOWN:      return "UNKNOWN";
         default:                      return "INVALID_TYPE";
     }
@@ -24,79 +30,95 @@ std::ostream& operator<<(std::ostream& os, const Token& token) {
     return os;
 }
 
-// Returns the precedence of an operator. Higher values indicate higher precedence.
-int getPrecedence(char op) {
-    if (op == '+' || op == '-') return PREC_ADD_SUB; // Addition and subtraction
-    if (op == '*' || op == '/') return PREC_MUL_DIV; // Multiplication and division
-    if (op == '^') return PREC_POWER;               // Exponentiation
-    return 0; // Non-operator characters have no precedence.
+// Parses with strtod, as std::stod does, reading the token's own buffer.
+double tokenNumber(const Token& token) {
+    const char* text = token.value.c_str();
+    char* end;
+    const int savedErrno = errno;
+    errno = 0;
+    double value = std::strtod(text, &end);
+    if (end == text) throw std::invalid_argument("stod");
+    if (errno == ERANGE) throw std::out_of_range("stod");
+    errno = savedErrno;
+    return value;
 }
 
-// Checks if a character is a recognized operator.
-bool isOperatorChar(char c) {
-    return c == '+' || c == '-' || c == '*' || c == '/' || c == '^';
-}
+namespace {
+
+// Collects the token boundaries reported by `scanExpression` into Token objects.
+template <typename TokenVector>
+struct TokenCollector {
+    std::string_view expression;
+    TokenVector& tokens;
 
-// Determines if a binary operator is left-associative.
-bool isBinaryOperatorLeftAssociative(char op) {
-    if (op == '+' || op == '-' || op == '*' || op == '/') {
-        return true; // Standard arithmetic operators are left-associative.
+    // Tokens are emplaced so a std::pmr::vector allocates their strings.
+    void number(size_t begin, size_t end) {
+        if (expression[begin] == '.') {
+            // Prepend '0' if the number starts with a decimal point.
+            Token& token = tokens.emplace_back(std::string_view("0"), TokenType::NUMBER);
+            token.value.append(expression.data() + begin, end - begin);
+            return;
+        }
+        tokens.emplace_back(expression.substr(begin, end - begin), TokenType::NUMBER);
     }
-    if (op == '^') {
-        return false; // Exponentiation is right-associative.
+
+    void identifier(size_t begin, size_t end) {
+        tokens.emplace_back(expression.substr(begin, end - begin), TokenType::IDENTIFIER);
     }
-    return true; // Default to left-associative for unknown operators.
-}
+
+    void op(size_t pos) {
+        char char_token = expression[pos];
+        tokens.emplace_back(
+            char_token,
+            TokenType::OPERATOR,
+            getPrecedence(char_token),
+            isBinaryOperatorLeftAssociative(char_token)
+        );
+    }
+
+    void leftParen(size_t pos) {
+        // A name followed by '(' is a function call: one FUNCTION token.
+        if (!tokens.empty() && tokens.back().type == TokenType::IDENTIFIER) {
+            tokens.back().type = TokenType::FUNCTION;
+            return;
+        }
+        tokens.emplace_back(expression[pos], TokenType::LEFT_PAREN);
+    }
+
+    void rightParen(size_t pos) {
+        tokens.emplace_back(expression[pos], TokenType::RIGHT_PAREN);
+    }
+
+    void comma(size_t pos) {
+        tokens.emplace_back(expression[pos], TokenType::COMMA);
+    }
+
+    void invalid(size_t pos) {
+        // Report invalid characters.
+        std::cerr << "Invalid character in expression: " << expression[pos] << std::endl;
+    }
+};
+
+}  // namespace
 
 // Tokenizes a mathematical expression into a vector of Token objects.
+// Characters are classified a block at a time by `scanExpression`, so runs
+// of whitespace cost nothing beyond the block classification.
 std::vector<Token> tokenizer(const std::string_view expression) {
     std::vector<Token> tokens;
+    tokenizer(expression, tokens);
+    return tokens;
+}
 
-    for (size_t i = 0; i < expression.length(); ++i) {
-        char char_token = expression[i];
-
-        if (isspace(char_token)) {
-            // Skip whitespace.
-            continue;
-        } else if (isOperatorChar(char_token)) {
-            // Handle operators.
-            tokens.push_back(
-                Token(
-                    char_token, 
-                    TokenType::OPERATOR, 
-                    getPrecedence(char_token), 
-                    isBinaryOperatorLeftAssociative(char_token)
-                )
-            );
-        } else if (char_token == '(') {
-            // Handle left parenthesis.
-            tokens.push_back(Token(char_token, TokenType::LEFT_PAREN));
-        } else if (char_token == ')') {
-            // Handle right parenthesis.
-            tokens.push_back(Token(char_token, TokenType::RIGHT_PAREN));
-        } else if (isdigit(char_token) || char_token == '.') {
-            // Handle numeric values, including floating-point numbers.
-            std::string number_str;
-
-            if (char_token == '.') {
-                // Prepend '0' if the number starts with a decimal point.
-                number_str += '0';
-            }
-
-            // Accumulate digits and decimal points.
-            while (i < expression.length() && 
-                   (isdigit(expression[i]) || expression[i] == '.')) {
-                number_str += expression[i];
-                i++;
-            }
-            i--; // Adjust index after overshooting in the loop.
-
-            tokens.push_back(Token(number_str, TokenType::NUMBER));
-        } else {
-            // Report invalid characters.
-            std::cerr << "Invalid character in expression: " << char_token << std::endl;
-        }
-    }
+// Tokenizes an expression into a reusable vector of Token objects.
+void tokenizer(const std::string_view expression, std::vector<Token>& tokens) {
+    tokens.clear();
+    scanExpression(expression, TokenCollector<std::vector<Token>>{expression, tokens});
+}
 
+// Tokenizes an expression into a vector allocated from a memory resource.
+std::pmr::vector<Token> tokenizer(const std::string_view expression, std::pmr::memory_resource* resource) {
+    std::pmr::vector<Token> tokens(resource);
+    scanExpression(expression, TokenCollector<std::pmr::vector<Token>>{expression, tokens});
     return tokens;
 }
@@ -0,0 +1,131 @@
+#include "trace.h"
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> traceEnabledFlag{false};
+
+namespace {
+
+// A fixed-size ring of events written by one thread.
+struct TraceRing {
+    uint32_t threadId;
+    uint64_t written = 0;  // Total events ever recorded; the ring keeps the last CAPACITY.
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[TRACE_RING_CAPACITY]};
+};
+
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<TraceRing>>& rings() {
+    static std::vector<std::unique_ptr<TraceRing>> allRings;
+    return allRings;
+}
+
+// Rings of threads that have exited, ready for the next new thread.
+std::vector<TraceRing*>& freeRings() {
+    static std::vector<TraceRing*> free;
+    return free;
+}
+
+uint64_t traceStartNanoseconds = 0;
+
+// Holds a thread's ring and hands it back when the thread exits.
+struct RingOwner {
+    TraceRing* ring = nullptr;
+
+    ~RingOwner() {
+        if (!ring) return;
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        freeRings().push_back(ring);
+    }
+};
+
+// Returns the calling thread's ring, registering it on first use. A new
+// thread takes over the ring of one that has exited, if any, so workers
+// started for each chunk of a stream share a few rings (and trace lanes)
+// instead of allocating one each.
+TraceRing& localRing() {
+    thread_local RingOwner owner;
+    if (!owner.ring) {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        if (!freeRings().empty()) {
+            owner.ring = freeRings().back();
+            freeRings().pop_back();
+        } else {
+            rings().push_back(std::make_unique<TraceRing>());
+            owner.ring = rings().back().get();
+            owner.ring->threadId = static_cast<uint32_t>(rings().size());
+        }
+    }
+    return *owner.ring;
+}
+
+// Writes a span duration or timestamp in microseconds, as the format expects.
+void writeMicroseconds(std::ostream& os, uint64_t nanoseconds) {
+    os << nanoseconds / 1000 << '.';
+    uint64_t fraction = nanoseconds % 1000;
+    os << char('0' + fraction / 100) << char('0' + fraction / 10 % 10) << char('0' + fraction % 10);
+}
+
+// Writes a JSON string literal, escaping quotes, backslashes and controls.
+void writeJsonString(std::ostream& os, const char* text) {
+    os << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            os << '\\' << *c;
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            os << ' ';
+        } else {
+            os << *c;
+        }
+    }
+    os << '"';
+}
+
+}  // namespace
+
+// Turns tracing on and fixes the trace's time origin.
+void enableTracing() {
+    traceStartNanoseconds = nowNanoseconds();
+    traceEnabledFlag.store(true, std::memory_order_relaxed);
+}
+
+// Appends a span to the calling thread's ring, overwriting the oldest event
+// once the ring is full.
+void recordTraceEvent(const char* name, uint64_t startNanoseconds, uint64_t endNanoseconds) {
+    TraceRing& ring = localRing();
+    ring.events[ring.written % TRACE_RING_CAPACITY] = TraceEvent{name, startNanoseconds, endNanoseconds};
+    ++ring.written;
+}
+
+// Writes all rings as a trace-event JSON object.
+bool writeChromeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) return false;
+
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& ring : rings()) {
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->threadId
+            << ",\"args\":{\"name\":\"thread " << ring->threadId << "\"}}";
+        first = false;
+
+        uint64_t count = ring->written < TRACE_RING_CAPACITY ? ring->written : TRACE_RING_CAPACITY;
+        for (uint64_t i = ring->written - count; i < ring->written; ++i) {
+            const TraceEvent& event = ring->events[i % TRACE_RING_CAPACITY];
+            uint64_t start = event.startNanoseconds > traceStartNanoseconds
+                ? event.startNanoseconds - traceStartNanoseconds : 0;
+            out << ",\n{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->threadId << ",\"ts\":";
+            writeMicroseconds(out, start);
+            out << ",\"dur\":";
+            writeMicroseconds(out, event.endNanoseconds - event.startNanoseconds);
+            out << '}';
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
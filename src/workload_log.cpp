@@ -0,0 +1,152 @@
+#include "workload_log.h"
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+const char MAGIC[8] = {'C', 'A', 'L', 'C', 'L', 'O', 'G', '1'};
+
+// Variable names longer than this are rejected as corruption when reading.
+const uint64_t MAX_NAME_LENGTH = 4096;
+
+void writeVarint(std::ostream& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.put(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.put(static_cast<char>(value));
+}
+
+// Reads a varint. Returns false on a clean end of file before the first byte.
+bool readVarint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == std::char_traits<char>::eof()) {
+            if (shift == 0) return false;
+            throw std::runtime_error("Workload log truncated inside a varint");
+        }
+        value |= uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    throw std::runtime_error("Workload log contains an overlong varint");
+}
+
+void writeDouble(std::ostream& out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    char bytes[8];
+    for (int i = 0; i < 8; ++i) bytes[i] = static_cast<char>(bits >> (8 * i));
+    out.write(bytes, sizeof(bytes));
+}
+
+double readDouble(std::istream& in) {
+    unsigned char bytes[8];
+    if (!in.read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+        throw std::runtime_error("Workload log truncated inside a result");
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; ++i) bits |= uint64_t(bytes[i]) << (8 * i);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+}  // namespace
+
+// Creates the log file and writes the magic and settings.
+WorkloadWriter::WorkloadWriter(const std::string& path, const WorkloadSettings& settings)
+    : out_(path, std::ios::binary | std::ios::trunc) {
+    if (!out_) {
+        throw std::runtime_error("Could not create workload log: " + path);
+    }
+    out_.write(MAGIC, sizeof(MAGIC));
+    writeVarint(out_, settings.variables.size());
+    for (const auto& [name, value] : settings.variables) {
+        writeVarint(out_, name.size());
+        out_.write(name.data(), static_cast<std::streamsize>(name.size()));
+        writeDouble(out_, value);
+    }
+    out_.put(static_cast<char>(settings.accuracy));
+    out_.put(settings.strictPower ? 1 : 0);
+}
+
+// Appends one record.
+void WorkloadWriter::append(uint64_t timestampNanoseconds, std::string_view expression, bool ok, double value) {
+    uint64_t delta = timestampNanoseconds >= lastTimestamp_ ? timestampNanoseconds - lastTimestamp_ : 0;
+    lastTimestamp_ += delta;
+    writeVarint(out_, delta);
+    writeVarint(out_, expression.size());
+    out_.write(expression.data(), static_cast<std::streamsize>(expression.size()));
+    out_.put(ok ? 1 : 0);
+    if (ok) writeDouble(out_, value);
+}
+
+// Opens the log, validates the magic and reads the settings.
+WorkloadReader::WorkloadReader(const std::string& path) : in_(path, std::ios::binary) {
+    if (!in_) {
+        throw std::runtime_error("Could not open workload log: " + path);
+    }
+    in_.seekg(0, std::ios::end);
+    fileSize_ = static_cast<uint64_t>(in_.tellg());
+    in_.seekg(0, std::ios::beg);
+    char magic[sizeof(MAGIC)];
+    if (!in_.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a workload log: " + path);
+    }
+
+    uint64_t count;
+    if (!readVarint(in_, count)) {
+        throw std::runtime_error("Workload log truncated inside its settings");
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t length;
+        if (!readVarint(in_, length) || length > MAX_NAME_LENGTH) {
+            throw std::runtime_error("Workload log has a corrupt variable name length");
+        }
+        std::string name(static_cast<size_t>(length), '\0');
+        if (!in_.read(&name[0], static_cast<std::streamsize>(length))) {
+            throw std::runtime_error("Workload log truncated inside a variable name");
+        }
+        settings_.variables.emplace_back(std::move(name), readDouble(in_));
+    }
+    int accuracy = in_.get();
+    if (accuracy < 0 || accuracy > static_cast<int>(MathAccuracy::RELATIVE_1E7)) {
+        throw std::runtime_error("Workload log has a corrupt accuracy level");
+    }
+    settings_.accuracy = static_cast<MathAccuracy>(accuracy);
+    int strict = in_.get();
+    if (strict != 0 && strict != 1) {
+        throw std::runtime_error("Workload log has a corrupt strict power flag");
+    }
+    settings_.strictPower = strict == 1;
+}
+
+// Reads the next record.
+bool WorkloadReader::next(WorkloadRecord& record) {
+    uint64_t delta;
+    if (!readVarint(in_, delta)) return false;
+
+    uint64_t length;
+    // A length beyond the end of the file is corruption; checking it first
+    // keeps a corrupt varint from allocating gigabytes.
+    if (!readVarint(in_, length) || length > fileSize_ - static_cast<uint64_t>(in_.tellg())) {
+        throw std::runtime_error("Workload log has a corrupt expression length");
+    }
+    record.expression.resize(static_cast<size_t>(length));
+    if (!in_.read(&record.expression[0], static_cast<std::streamsize>(length))) {
+        throw std::runtime_error("Workload log truncated inside an expression");
+    }
+
+    int status = in_.get();
+    if (status != 0 && status != 1) {
+        throw std::runtime_error("Workload log has a corrupt status byte");
+    }
+
+    lastTimestamp_ += delta;
+    record.timestampNanoseconds = lastTimestamp_;
+    record.ok = status == 1;
+    record.value = record.ok ? readDouble(in_) : 0;
+    return true;
+}
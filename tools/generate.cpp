@@ -0,0 +1,242 @@
+#include "CLI11.h"
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Settings controlling the shape of the generated expressions.
+struct GeneratorOptions {
+    uint64_t seed = 1;                  // Seed; equal seeds give identical output.
+    uint64_t count = 1000;              // Expressions to emit (0 for no limit).
+    uint64_t bytes = 0;                 // Stop after about this many bytes (0 for no limit).
+    size_t minOperands = 1;             // Fewest numbers per expression.
+    size_t maxOperands = 16;            // Most numbers per expression.
+    int maxDepth = 4;                   // Deepest parenthesis nesting.
+    double parenProbability = 0.25;     // Chance of opening a group at each term.
+    std::vector<double> operatorWeights{4, 4, 2, 2, 1};  // Relative weights of + - * / ^.
+    std::string literals = "mixed";     // "integer", "decimal" or "mixed".
+    uint64_t minLiteral = 1;            // Smallest literal value.
+    uint64_t maxLiteral = 100;          // Largest literal value (integer part).
+    int decimals = 2;                   // Digits after the point for decimal literals.
+    double malformed = 0;               // Fraction of deliberately malformed expressions.
+    bool compact = false;               // Omit the spaces around operators.
+};
+
+// splitmix64: a small, fast generator whose output is specified exactly, so
+// a seed produces the same expressions with every compiler and library
+// (unlike the std:: distributions).
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Returns a value in [low, high].
+    uint64_t between(uint64_t low, uint64_t high) {
+        uint64_t span = high - low + 1;
+        return span == 0 ? next() : low + next() % span;
+    }
+
+    // Returns a value in [0, 1).
+    double uniform() {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+    // Returns true with probability `p`.
+    bool chance(double p) {
+        return uniform() < p;
+    }
+
+private:
+    uint64_t state_;
+};
+
+const char OPERATORS[] = {'+', '-', '*', '/', '^'};
+
+// Ways of breaking an otherwise valid expression. Each keeps to the
+// characters the tokenizer accepts.
+enum class Malformation {
+    MISSING_RIGHT_PAREN,  // "(1 + 2"
+    EXTRA_RIGHT_PAREN,    // "1 + 2)"
+    TRAILING_OPERATOR,    // "1 + 2 *"
+    DOUBLED_OPERATOR,     // "1 + * 2"
+    EMPTY_PARENS,         // "1 + ()"
+    COUNT,
+};
+
+// Builds expressions one at a time into a reusable string.
+class ExpressionGenerator {
+public:
+    explicit ExpressionGenerator(const GeneratorOptions& options)
+        : options_(options), random_(options.seed),
+          decimalChance_(options.literals == "decimal" ? 1.0 : options.literals == "mixed" ? 0.5 : 0.0) {
+        double total = 0;
+        for (double weight : options_.operatorWeights) {
+            total += weight;
+            cumulativeWeights_.push_back(total);
+        }
+        totalWeight_ = total;
+    }
+
+    // Appends one expression (without a newline) to `out`.
+    void generate(std::string& out) {
+        size_t operands = random_.between(options_.minOperands, options_.maxOperands);
+        if (options_.malformed > 0 && random_.chance(options_.malformed)) {
+            generateMalformed(out, operands);
+        } else {
+            expression(out, operands, 0);
+        }
+    }
+
+private:
+    // Appends `operands` terms joined by operators. Runs of two or more terms
+    // are wrapped in parentheses while `depth` is below the limit.
+    void expression(std::string& out, size_t operands, int depth) {
+        while (operands > 0) {
+            if (operands > 1 && depth < options_.maxDepth && random_.chance(options_.parenProbability)) {
+                size_t grouped = random_.between(2, operands);
+                out += '(';
+                expression(out, grouped, depth + 1);
+                out += ')';
+                operands -= grouped;
+            } else {
+                literal(out);
+                --operands;
+            }
+            if (operands > 0) binaryOperator(out);
+        }
+    }
+
+    void literal(std::string& out) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits),
+                                    random_.between(options_.minLiteral, options_.maxLiteral));
+        out.append(digits, result.ptr);
+        if (options_.decimals > 0 && random_.chance(decimalChance_)) {
+            out += '.';
+            for (int i = 0; i < options_.decimals; ++i) {
+                out += static_cast<char>('0' + random_.between(0, 9));
+            }
+        }
+    }
+
+    char pickOperator() {
+        double target = random_.uniform() * totalWeight_;
+        for (size_t i = 0; i < cumulativeWeights_.size(); ++i) {
+            if (target < cumulativeWeights_[i]) return OPERATORS[i];
+        }
+        return OPERATORS[cumulativeWeights_.size() - 1];
+    }
+
+    void binaryOperator(std::string& out) {
+        if (!options_.compact) out += ' ';
+        out += pickOperator();
+        if (!options_.compact) out += ' ';
+    }
+
+    void generateMalformed(std::string& out, size_t operands) {
+        auto kind = static_cast<Malformation>(random_.between(0, static_cast<uint64_t>(Malformation::COUNT) - 1));
+        switch (kind) {
+            case Malformation::MISSING_RIGHT_PAREN:
+                out += '(';
+                expression(out, operands, 1);
+                break;
+            case Malformation::EXTRA_RIGHT_PAREN:
+                expression(out, operands, 0);
+                out += ')';
+                break;
+            case Malformation::TRAILING_OPERATOR:
+                expression(out, operands, 0);
+                binaryOperator(out);
+                break;
+            case Malformation::DOUBLED_OPERATOR:
+                literal(out);
+                binaryOperator(out);
+                binaryOperator(out);
+                expression(out, operands, 0);
+                break;
+            default:
+                expression(out, operands, 0);
+                binaryOperator(out);
+                out += "()";
+                break;
+        }
+    }
+
+    const GeneratorOptions& options_;
+    Random random_;
+    double decimalChance_;
+    std::vector<double> cumulativeWeights_;
+    double totalWeight_ = 0;
+};
+
+}  // namespace
+
+// Writes random expressions, one per line, for `calculator --batch` and the
+// benchmarks. Output is buffered in large chunks so it can stream gigabytes.
+int main(int argc, char** argv) {
+    CLI::App app{"Generate random calculator expressions"};
+
+    GeneratorOptions options;
+    app.add_option("-s,--seed", options.seed, "Random seed; the same seed gives the same output");
+    app.add_option("-n,--count", options.count, "Number of expressions (0 for no limit)");
+    app.add_option("--bytes", options.bytes, "Stop once about this many bytes were written (0 for no limit)");
+    app.add_option("--min-operands", options.minOperands, "Fewest numbers per expression")
+        ->check(CLI::PositiveNumber);
+    app.add_option("--max-operands", options.maxOperands, "Most numbers per expression")
+        ->check(CLI::PositiveNumber);
+    app.add_option("--max-depth", options.maxDepth, "Deepest parenthesis nesting")->check(CLI::NonNegativeNumber);
+    app.add_option("--paren-probability", options.parenProbability, "Chance of opening a group at each term")
+        ->check(CLI::Range(0.0, 1.0));
+    app.add_option("--operator-weights", options.operatorWeights, "Relative weights of + - * / ^, e.g. 4,4,2,2,1")
+        ->expected(5)
+        ->delimiter(',')
+        ->check(CLI::NonNegativeNumber);
+    app.add_option("--literals", options.literals, "Literal style")
+        ->check(CLI::IsMember({"integer", "decimal", "mixed"}));
+    app.add_option("--min-literal", options.minLiteral, "Smallest literal value");
+    app.add_option("--max-literal", options.maxLiteral, "Largest literal value (integer part)");
+    app.add_option("--decimals", options.decimals, "Digits after the decimal point")->check(CLI::Range(0, 17));
+    app.add_option("--malformed", options.malformed, "Fraction of deliberately malformed expressions")
+        ->check(CLI::Range(0.0, 1.0));
+    app.add_flag("--compact", options.compact, "Omit the spaces around operators");
+    CLI11_PARSE(app, argc, argv);
+
+    if (options.minOperands > options.maxOperands || options.minLiteral > options.maxLiteral) {
+        std::fprintf(stderr, "Each minimum must not exceed its maximum\n");
+        return 1;
+    }
+    double totalWeight = 0;
+    for (double weight : options.operatorWeights) totalWeight += weight;
+    if (totalWeight <= 0) {
+        std::fprintf(stderr, "At least one operator weight must be positive\n");
+        return 1;
+    }
+
+    const size_t CHUNK_SIZE = 1 << 20;
+    ExpressionGenerator generator(options);
+    std::string chunk;
+    chunk.reserve(CHUNK_SIZE + 4096);
+    uint64_t written = 0;
+
+    for (uint64_t i = 0; options.count == 0 || i < options.count; ++i) {
+        if (options.bytes && written + chunk.size() >= options.bytes) break;
+        generator.generate(chunk);
+        chunk += '\n';
+        if (chunk.size() >= CHUNK_SIZE) {
+            if (std::fwrite(chunk.data(), 1, chunk.size(), stdout) != chunk.size()) return 1;
+            written += chunk.size();
+            chunk.clear();
+        }
+    }
+    if (std::fwrite(chunk.data(), 1, chunk.size(), stdout) != chunk.size()) return 1;
+    return std::fflush(stdout) == 0 ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+#include "CLI11.h"
+#include "calculator.h"
+#include "environment.h"
+#include "functions.h"
+#include "latency_histogram.h"
+#include "power.h"
+#include "profiler.h"
+#include "program.h"
+#include "tokenizer.h"
+#include "workload_log.h"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Compares two results bit for bit, so NaN matches NaN and -0 differs from 0.
+bool sameValue(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// Builds the variables a log was captured with.
+Environment captureEnvironment(const WorkloadSettings& settings) {
+    std::vector<std::string> names;
+    for (const auto& variable : settings.variables) names.push_back(variable.first);
+    Environment environment(names);
+    for (uint32_t slot = 0; slot < environment.size(); ++slot) environment[slot] = settings.variables[slot].second;
+    return environment;
+}
+
+// Evaluates one expression the way the calculator CLI does. Returns false
+// if evaluation threw; `value` is set only on success.
+bool replayExpression(const std::string& expression, const Environment& environment, double& value) {
+    try {
+        value = calculate(tokenizer(expression), environment);
+        return true;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+// Prints a recorded result and a replayed one for a mismatch report, with
+// enough digits to tell apart any two doubles that differ.
+void printResult(std::ostream& os, bool ok, double value) {
+    if (ok) {
+        std::streamsize precision = os.precision(std::numeric_limits<double>::max_digits10);
+        os << value;
+        os.precision(precision);
+    } else {
+        os << "error";
+    }
+}
+
+// Compiles the successfully evaluated `expressions`, then prints their
+// instruction-pair profile and the superinstructions it selects.
+void printOpcodeProfile(std::ostream& os, const std::vector<std::string>& expressions,
+                        const Environment& environment) {
+    std::vector<PostfixProgram> programs;
+    for (const auto& expression : expressions) {
+        programs.push_back(compilePostfix(tokenizer(expression), &environment.symbols()));
+    }
+    OpcodePairCounts pairs;
+    for (const auto& program : programs) pairs.record(program);
+    FusionPlan plan = planFusions(programs);
+    size_t before = 0, after = 0;
+    for (const auto& program : programs) {
+        before += program.code.size();
+        after += fuseInstructions(program, plan).code.size();
+    }
+
+    os << "opcode pairs over " << programs.size() << " program(s):\n";
+    pairs.print(os, 16);
+    os << "fused pairs:\n";
+    plan.print(os);
+    os << "instructions: " << before << " -> " << after << '\n';
+}
+
+}  // namespace
+
+// Replays a workload log captured with `calculator --capture`, checking
+// every result against the recorded one and reporting latency percentiles.
+int main(int argc, char** argv) {
+    CLI::App app{"Replay a captured calculator workload"};
+
+    std::string path;
+    bool flat = false;
+    size_t maxMismatches = 10;
+    bool opcodePairs = false;
+    app.add_option("log", path, "Workload log written by calculator --capture")->required();
+    app.add_flag("--flat", flat, "Evaluate as fast as possible instead of at the recorded pace");
+    app.add_option("--show-mismatches", maxMismatches, "Print at most this many mismatching records");
+    app.add_flag("--opcode-pairs", opcodePairs,
+                 "Also report instruction-pair counts of the compiled workload and the superinstructions they select");
+    CLI11_PARSE(app, argc, argv);
+
+    LatencyHistogram histogram;
+    size_t records = 0;
+    size_t mismatches = 0;
+    std::vector<std::string> evaluated;
+    Environment environment;
+    uint64_t start = nowNanoseconds();
+
+    try {
+        WorkloadReader reader(path);
+        environment = captureEnvironment(reader.settings());
+        setMathAccuracy(reader.settings().accuracy);
+        setStrictPower(reader.settings().strictPower);
+        WorkloadRecord record;
+        while (reader.next(record)) {
+            if (!flat) {
+                uint64_t due = start + record.timestampNanoseconds;
+                uint64_t now = nowNanoseconds();
+                if (due > now) std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+            }
+
+            double value = 0;
+            uint64_t before = nowNanoseconds();
+            bool ok = replayExpression(record.expression, environment, value);
+            histogram.record(nowNanoseconds() - before);
+            ++records;
+
+            if (opcodePairs && ok) evaluated.push_back(record.expression);
+
+            if (ok != record.ok || (ok && !sameValue(value, record.value))) {
+                if (mismatches < maxMismatches) {
+                    std::cerr << "mismatch: " << record.expression << ": recorded ";
+                    printResult(std::cerr, record.ok, record.value);
+                    std::cerr << ", replayed ";
+                    printResult(std::cerr, ok, value);
+                    std::cerr << '\n';
+                }
+                ++mismatches;
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    double seconds = (nowNanoseconds() - start) / 1e9;
+    std::cout << "replayed " << records << " expression(s) in " << seconds << " s ("
+              << (seconds > 0 ? records / seconds : 0) << " expr/s, "
+              << (flat ? "flat out" : "recorded pace") << ")\n"
+              << "latency: ";
+    histogram.printPercentiles(std::cout);
+    std::cout << "\nmismatches: " << mismatches << std::endl;
+    if (opcodePairs) printOpcodeProfile(std::cout, evaluated, environment);
+
+    return mismatches == 0 ? 0 : 1;
+}